@@ -0,0 +1,263 @@
+// Offline mesh compiler: turns a generated shape or a Wavefront OBJ model into
+// the binary layout of MeshFile, which Mesh uploads without touching a vertex.
+//
+//   MeshCompiler <output.mesh> cube
+//   MeshCompiler <output.mesh> plane|sphere|cylinder|icosphere|cubesphere <size>
+//   MeshCompiler <output.mesh> <model.obj>
+//
+// The size is at least 2 for plane and sphere, 3 for cylinder, 1 for cubesphere
+// and may be 0 for icosphere, which then is the bare icosahedron.
+//
+// The shape goes through MeshOptimizer (vertex cache, then overdraw order), then
+// MeshFile::write() computes its tangents and quantizes it.
+#include "../OpenGLSample/MeshFile.h"
+#include "../OpenGLSample/MeshOptimizer.h"
+#include "../OpenGLSample/ShapeData.h"
+#include "../OpenGLSample/ShapeGenerator.h"
+#include "../OpenGLSample/Vertex.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+	struct Generator
+	{
+		const char* name;
+		ShapeData (*make)(uint size);
+		int minSize;    // smallest size it accepts, or -1 when it takes none
+	};
+
+	ShapeData makeCube(uint) { return ShapeGenerator::makeCube(); }
+	ShapeData makePlane(uint size) { return ShapeGenerator::makePlane(size); }
+	ShapeData makeSphere(uint size) { return ShapeGenerator::makeSphere(size); }
+	ShapeData makeCylinder(uint size) { return ShapeGenerator::makeCylinder(size); }
+	ShapeData makeIcosphere(uint size) { return ShapeGenerator::makeIcosphere(size); }
+	ShapeData makeCubeSphere(uint size) { return ShapeGenerator::makeCubeSphere(size); }
+
+	const Generator GENERATORS[] =
+	{
+		{ "cube", makeCube, -1 },
+		{ "plane", makePlane, 2 },
+		{ "sphere", makeSphere, 2 },
+		{ "cylinder", makeCylinder, 3 },
+		{ "icosphere", makeIcosphere, 0 },   // 0 is the icosahedron itself
+		{ "cubesphere", makeCubeSphere, 1 },
+	};
+
+	// an OBJ index: 1-based, or negative to count back from the latest element
+	bool resolveIndex(const std::string& token, size_t count, int& index)
+	{
+		if (token.empty())
+		{
+			index = -1;
+			return true;
+		}
+		int value = std::atoi(token.c_str());
+		index = value > 0 ? value - 1 : (int)count + value;
+		return value != 0 && index >= 0 && index < (int)count;
+	}
+
+	// Positions, texture coordinates, normals and faces ("v", "vt", "vn", "f") of
+	// a Wavefront OBJ file; polygons are split into fans and everything else is
+	// ignored. Each distinct position/texture/normal combination becomes one
+	// vertex. Vertices given without a normal get the area-weighted normal of the
+	// faces around them.
+	bool readObj(const char* path, ShapeData& shape)
+	{
+		std::ifstream in(path);
+		if (!in)
+		{
+			std::cout << "ERROR::MESHCOMPILER::OPEN_FAILED: " << path << std::endl;
+			return false;
+		}
+
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> texCoords;
+		std::vector<glm::vec3> normals;
+		std::vector<Vertex> vertices;
+		std::vector<bool> computedNormal;
+		std::vector<GLuint> indices;
+		std::map<std::tuple<int, int, int>, GLuint> lookup;
+
+		std::string text;
+		int lineNumber = 0;
+		while (std::getline(in, text))
+		{
+			lineNumber++;
+			std::istringstream line(text);
+			std::string keyword;
+			line >> keyword;
+			if (keyword == "v")
+			{
+				glm::vec3 position;
+				line >> position.x >> position.y >> position.z;
+				positions.push_back(position);
+			}
+			else if (keyword == "vt")
+			{
+				glm::vec2 texCoord;
+				line >> texCoord.x >> texCoord.y;
+				texCoords.push_back(texCoord);
+			}
+			else if (keyword == "vn")
+			{
+				glm::vec3 normal;
+				line >> normal.x >> normal.y >> normal.z;
+				normals.push_back(normal);
+			}
+			else if (keyword == "f")
+			{
+				std::vector<GLuint> corners;
+				std::string corner;
+				while (line >> corner)
+				{
+					// "p", "p/t", "p//n" or "p/t/n"
+					std::string parts[3];
+					size_t start = 0;
+					for (int k = 0; k < 3; k++)
+					{
+						size_t slash = corner.find('/', start);
+						parts[k] = corner.substr(start, slash == std::string::npos ? std::string::npos : slash - start);
+						if (slash == std::string::npos)
+							break;
+						start = slash + 1;
+					}
+					int p, t, n;
+					if (!resolveIndex(parts[0], positions.size(), p) || p < 0
+						|| !resolveIndex(parts[1], texCoords.size(), t) || !resolveIndex(parts[2], normals.size(), n))
+					{
+						std::cout << "ERROR::MESHCOMPILER::INVALID_FACE: " << path << " line " << lineNumber << std::endl;
+						return false;
+					}
+
+					auto key = std::make_tuple(p, t, n);
+					auto found = lookup.find(key);
+					if (found == lookup.end())
+					{
+						Vertex vertex;
+						vertex.position = positions[p];
+						vertex.color = glm::vec3(1.0f);
+						vertex.normal = n >= 0 ? normals[n] : glm::vec3(0.0f);
+						vertex.texCoord = t >= 0 ? texCoords[t] : glm::vec2(0.0f);
+						found = lookup.emplace(key, (GLuint)vertices.size()).first;
+						vertices.push_back(vertex);
+						computedNormal.push_back(n < 0);
+					}
+					corners.push_back(found->second);
+				}
+				for (size_t k = 1; k + 1 < corners.size(); k++)
+				{
+					indices.push_back(corners[0]);
+					indices.push_back(corners[k]);
+					indices.push_back(corners[k + 1]);
+				}
+			}
+		}
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			glm::vec3 a = vertices[indices[i]].position;
+			// twice the area in length, so larger faces count for more
+			glm::vec3 normal = glm::cross(vertices[indices[i + 1]].position - a, vertices[indices[i + 2]].position - a);
+			for (int k = 0; k < 3; k++)
+			{
+				if (computedNormal[indices[i + k]])
+					vertices[indices[i + k]].normal += normal;
+			}
+		}
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			float length = glm::length(vertices[i].normal);
+			vertices[i].normal = length > 0.0f ? vertices[i].normal * (1.0f / length) : glm::vec3(0.0f, 1.0f, 0.0f);
+		}
+
+		if (indices.empty())
+		{
+			std::cout << "ERROR::MESHCOMPILER::NO_FACES: " << path << std::endl;
+			return false;
+		}
+		shape.numVertices = (GLuint)vertices.size();
+		shape.vertices = new Vertex[shape.numVertices];
+		std::copy(vertices.begin(), vertices.end(), shape.vertices);
+		shape.numIndices = (GLuint)indices.size();
+		shape.indices = new GLuint[shape.numIndices];
+		std::copy(indices.begin(), indices.end(), shape.indices);
+		return true;
+	}
+
+	void printUsage()
+	{
+		std::cout << "usage: MeshCompiler <output.mesh> <generator> [size]\n"
+			"       MeshCompiler <output.mesh> <model.obj>\n"
+			"generators:";
+		for (const Generator& generator : GENERATORS)
+			std::cout << ' ' << generator.name;
+		std::cout << std::endl;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		printUsage();
+		return 1;
+	}
+	const char* output = argv[1];
+	std::string input = argv[2];
+
+	ShapeData shape;
+	const Generator* generator = nullptr;
+	for (const Generator& candidate : GENERATORS)
+	{
+		if (input == candidate.name)
+			generator = &candidate;
+	}
+	if (generator != nullptr)
+	{
+		long size = 0;
+		if (generator->minSize >= 0)
+		{
+			char* end = nullptr;
+			size = argc > 3 ? std::strtol(argv[3], &end, 10) : -1;
+			if (argc <= 3 || *argv[3] == '\0' || *end != '\0' || size < generator->minSize)
+			{
+				printUsage();
+				return 1;
+			}
+		}
+		shape = generator->make((uint)size);
+	}
+	else if (!readObj(input.c_str(), shape))
+		return 1;
+
+	VertexCacheStats before = MeshOptimizer::analyze(shape);
+	MeshOptimizer::optimize(shape);
+	VertexCacheStats after = MeshOptimizer::analyze(shape);
+
+	bool written = MeshFile::write(output, shape);
+	size_t floatBytes = shape.numVertices * sizeof(Vertex) + shape.numIndices * sizeof(GLuint);
+	shape.cleanup();
+	if (!written)
+		return 1;
+
+	// read it back the way the renderer will, which also validates it
+	MeshFile file;
+	if (!file.open(output))
+		return 1;
+	size_t fileBytes = file.vertexCount() * sizeof(CompactMeshVertex) + file.indexBytes();
+	std::printf("%s: %u vertices, %u triangles, %s indices\n", output, file.vertexCount(), file.indexCount() / 3,
+		file.indexType() == GL_UNSIGNED_SHORT ? "16-bit" : "32-bit");
+	std::printf("  ACMR %.3f -> %.3f, %.1f KB of vertices and indices (%.1f KB as generated)\n",
+		before.acmr, after.acmr, fileBytes / 1024.0, floatBytes / 1024.0);
+	return 0;
+}
@@ -0,0 +1,1226 @@
+#include "Benchmark.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "Bvh.h"
+#include "FrustumCuller.h"
+#include "GeometryBuffer.h"
+#include "InstanceBatch.h"
+#include "LightBuffer.h"
+#include "Lod.h"
+#include "LooseOctree.h"
+#include "MeshCache.h"
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Meshlet.h"
+#include "NormalMatrix.h"
+#include "RenderStats.h"
+#include "Scene.h"
+#include "SceneFile.h"
+#include "ShapeGenerator.h"
+#include "ThreadPool.h"
+#include "VertexFormat.h"
+#include "shader.h"
+
+namespace
+{
+	const int WARMUP_FRAMES = 3;
+	const int TIMED_FRAMES = 20;
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double millisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	struct DrawTiming
+	{
+		double gpuMs;    // GL_TIME_ELAPSED, per frame
+		double wallMs;   // submit to glFinish, per frame
+	};
+
+	DrawTiming timeDraws(Shader& shader, const InstanceBatch& batch)
+	{
+		shader.use();
+		GLuint query = 0;
+		glGenQueries(1, &query);
+		DrawTiming timing = { 0.0, 0.0 };
+		for (int frame = 0; frame < WARMUP_FRAMES + TIMED_FRAMES; frame++)
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glFinish();
+			Clock::time_point start = Clock::now();
+			glBeginQuery(GL_TIME_ELAPSED, query);
+			batch.drawMulti(GL_TRIANGLES);
+			glEndQuery(GL_TIME_ELAPSED);
+			glFinish();
+			double wall = millisecondsSince(start);
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+			if (frame < WARMUP_FRAMES)
+				continue;
+			timing.gpuMs += elapsed / 1.0e6;
+			timing.wallMs += wall;
+		}
+		glDeleteQueries(1, &query);
+		timing.gpuMs /= TIMED_FRAMES;
+		timing.wallMs /= TIMED_FRAMES;
+		return timing;
+	}
+
+	// closest point of triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5)
+	glm::vec3 closestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+	{
+		glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+		float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f)
+			return a;
+		glm::vec3 bp = p - b;
+		float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+		if (d3 >= 0.0f && d4 <= d3)
+			return b;
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+			return a + ab * (d1 / (d1 - d3));
+		glm::vec3 cp = p - c;
+		float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+		if (d6 >= 0.0f && d5 <= d6)
+			return c;
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+			return a + ac * (d2 / (d2 - d6));
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+			return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+		float denominator = 1.0f / (va + vb + vc);
+		return a + ab * (vb * denominator) + ac * (vc * denominator);
+	}
+
+	struct SphereError
+	{
+		float maxError;             // deepest point of any triangle below the unit sphere
+		unsigned int degenerate;    // triangles of no area
+		float smallestAngle;        // degrees, over the other triangles; 60 is ideal
+	};
+
+	SphereError measureSphere(const ShapeData& shape)
+	{
+		SphereError result = { 0.0f, 0, 60.0f };
+		for (GLuint t = 0; t + 2 < shape.numIndices; t += 3)
+		{
+			const glm::vec3& a = shape.vertices[shape.indices[t]].position;
+			const glm::vec3& b = shape.vertices[shape.indices[t + 1]].position;
+			const glm::vec3& c = shape.vertices[shape.indices[t + 2]].position;
+			if (glm::length(glm::cross(b - a, c - a)) < 1e-10f)
+			{
+				result.degenerate++;
+				continue;
+			}
+			glm::vec3 closest = closestPointOnTriangle(glm::vec3(0.0f), a, b, c);
+			result.maxError = std::max(result.maxError, 1.0f - glm::length(closest));
+			const glm::vec3 corners[3] = { a, b, c };
+			for (int k = 0; k < 3; k++)
+			{
+				glm::vec3 e1 = glm::normalize(corners[(k + 1) % 3] - corners[k]);
+				glm::vec3 e2 = glm::normalize(corners[(k + 2) % 3] - corners[k]);
+				float angle = std::atan2(glm::length(glm::cross(e1, e2)), glm::dot(e1, e2));
+				result.smallestAngle = std::min(result.smallestAngle, glm::degrees(angle));
+			}
+		}
+		return result;
+	}
+
+	// edges of the shape's triangles, with vertices at one position taken as one,
+	// that only one triangle uses in one direction: cracks and open borders
+	size_t countOpenEdges(const ShapeData& shape, const std::vector<GLuint>& indices)
+	{
+		std::map<std::vector<float>, GLuint> welded;
+		std::vector<GLuint> remap(shape.numVertices);
+		for (GLuint v = 0; v < shape.numVertices; v++)
+		{
+			const glm::vec3& p = shape.vertices[v].position;
+			// to the nearest 1e-5, so edges that should meet but come out of
+			// different arithmetic are still joined
+			glm::vec3 rounded(std::round(p.x * 1e5f), std::round(p.y * 1e5f), std::round(p.z * 1e5f));
+			remap[v] = welded.emplace(std::vector<float>{ rounded.x, rounded.y, rounded.z }, v).first->second;
+		}
+		std::set<std::pair<GLuint, GLuint>> edges;
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			GLuint a = remap[indices[i]], b = remap[indices[i - i % 3 + (i + 1) % 3]];
+			if (a != b)
+				edges.insert(std::make_pair(a, b));
+		}
+		size_t open = 0;
+		for (const std::pair<GLuint, GLuint>& edge : edges)
+			open += edges.count(std::make_pair(edge.second, edge.first)) == 0 ? 1 : 0;
+		return open;
+	}
+
+	void setFrameUniforms(Shader& shader, const glm::mat4& view, const glm::mat4& projection)
+	{
+		shader.use();
+		shader.setMat4("view", view);
+		shader.setMat4("projection", projection);
+		shader.setVec3("viewPos", glm::vec3(0.0f, 0.0f, 12.0f));
+		shader.setFloat("material.shininess", 32.0f);
+	}
+}
+
+void benchmarkNormalMatrices()
+{
+	std::cout << "normal matrix benchmark on " << glGetString(GL_RENDERER) << std::endl;
+
+	// GPU: a dense sphere drawn a few times with rotated, non-uniformly scaled
+	// transforms. The viewport is tiny so almost all of the time is vertex work.
+	// ---------------------------------------------------------------------------
+	const unsigned int TESSELATION = 255; // the most a 16-bit index buffer can hold
+	const int GRID = 4;
+
+	GeometryBuffer geometry;
+	ShapeData sphere = ShapeGenerator::makeSphere(TESSELATION);
+	MeshDraw sphereMesh = geometry.add(sphere);
+	geometry.upload();
+	GLuint numVertices = sphere.numVertices;
+	sphere.cleanup();
+
+	InstanceBatch spheres;
+	for (int x = 0; x < GRID; x++)
+	{
+		for (int y = 0; y < GRID; y++)
+		{
+			glm::mat4 model = glm::mat4(1.0f);
+			model = glm::translate(model, glm::vec3(x * 2.5f - 3.75f, y * 2.5f - 3.75f, 0.0f));
+			model = glm::rotate(model, glm::radians(20.0f * (x * GRID + y)), glm::vec3(0.3f, 1.0f, 0.2f));
+			model = glm::scale(model, glm::vec3(1.0f, 0.6f + 0.1f * x, 0.8f));
+			spheres.add(sphereMesh, model);
+		}
+	}
+	spheres.upload();
+
+	Shader inverseShader("shaderfiles/6.multiple_lights_instanced.vs", "shaderfiles/6.multiple_lights.fs");
+	Shader normalShader("shaderfiles/6.multiple_lights_instanced_normal.vs", "shaderfiles/6.multiple_lights.fs");
+
+	LightBuffer lights;
+	lights.create();
+	lights.bindTo(inverseShader);
+	lights.bindTo(normalShader);
+	DirLight dirLight = {};
+	dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+	dirLight.diffuse = glm::vec3(0.8f);
+	lights.setDirLight(dirLight);
+	lights.flush();
+
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 12.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+	setFrameUniforms(inverseShader, view, projection);
+	setFrameUniforms(normalShader, view, projection);
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glViewport(0, 0, 16, 16);
+	glBindVertexArray(geometry.vao());
+
+	DrawTiming inverseTiming = timeDraws(inverseShader, spheres);
+	DrawTiming normalTiming = timeDraws(normalShader, spheres);
+
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	std::cout << "  " << GRID * GRID << " spheres x " << numVertices << " vertices, " << TIMED_FRAMES << " frames each" << std::endl;
+	std::cout << "  inverse() per vertex:  gpu " << inverseTiming.gpuMs << " ms, wall " << inverseTiming.wallMs << " ms" << std::endl;
+	std::cout << "  CPU normal matrix:     gpu " << normalTiming.gpuMs << " ms, wall " << normalTiming.wallMs << " ms" << std::endl;
+
+	spheres.cleanup();
+	geometry.cleanup();
+	lights.cleanup();
+	glDeleteProgram(inverseShader.ID);
+	glDeleteProgram(normalShader.ID);
+
+	// CPU: the batched kernel against glm's inverse/transpose, best of a few runs
+	// ---------------------------------------------------------------------------
+	const size_t COUNT = 100000;
+	const int RUNS = 5;
+	std::vector<glm::mat4> models(COUNT);
+	for (size_t i = 0; i < COUNT; i++)
+	{
+		glm::mat4 model = glm::mat4(1.0f);
+		model = glm::translate(model, glm::vec3((float)i, 1.0f, 2.0f));
+		model = glm::rotate(model, 0.001f * i, glm::vec3(1.0f, 0.5f, 0.25f));
+		models[i] = glm::scale(model, glm::vec3(1.0f + (i % 7), 0.5f, 2.0f));
+	}
+	std::vector<glm::mat3> batched(COUNT), reference(COUNT);
+
+	double batchedMs = 1e30, referenceMs = 1e30;
+	for (int run = 0; run < RUNS; run++)
+	{
+		Clock::time_point start = Clock::now();
+		computeNormalMatrices(models.data(), batched.data(), COUNT);
+		batchedMs = std::min(batchedMs, millisecondsSince(start));
+
+		start = Clock::now();
+		for (size_t i = 0; i < COUNT; i++)
+			reference[i] = glm::transpose(glm::inverse(glm::mat3(models[i])));
+		referenceMs = std::min(referenceMs, millisecondsSince(start));
+	}
+	float maxError = 0.0f;
+	for (size_t i = 0; i < COUNT; i++)
+		for (int col = 0; col < 3; col++)
+			for (int row = 0; row < 3; row++)
+				maxError = std::max(maxError, std::fabs(batched[i][col][row] - reference[i][col][row]));
+
+	std::cout << "  " << COUNT << " normal matrices on the CPU: batched " << batchedMs << " ms, glm " << referenceMs
+		<< " ms (max difference " << maxError << ")" << std::endl;
+}
+
+void benchmarkSceneFile()
+{
+	const uint32_t COUNT = 1000000;
+	const int RUNS = 5;
+	const char* path = "scenefiles/benchmark.scn";
+
+	// a grid of cubes, a million lattice cells of one group
+	Aabb cubeBounds = { glm::vec3(-0.5f), glm::vec3(0.5f) };
+	SceneFileWriter writer;
+	uint16_t material = writer.addMaterial("wood", "wood.jpg");
+	uint16_t mesh = writer.addMesh("cube", cubeBounds);
+	writer.addGroup("grid", glm::scale(glm::mat4(1.0f), glm::vec3(0.1f)));
+	for (uint32_t i = 0; i < COUNT; i++)
+		writer.addObject(mesh, material, glm::vec3((float)(i % 100), (float)(i / 100 % 100), (float)(i / 10000)), glm::mat4(1.0f), SCENE_OBJECT_CELL);
+	Clock::time_point start = Clock::now();
+	if (!writer.write(path))
+		return;
+	double writeMs = millisecondsSince(start);
+
+	double openMs = 1e30, touchMs = 1e30;
+	glm::vec3 sceneMin(0.0f), sceneMax(0.0f);
+	for (int run = 0; run < RUNS; run++)
+	{
+		SceneFile file;
+		start = Clock::now();
+		if (!file.open(path))
+			return;
+		openMs = std::min(openMs, millisecondsSince(start));
+
+		// the first pass over the data also pages the file in
+		start = Clock::now();
+		sceneMin = file.bounds()[0].min;
+		sceneMax = file.bounds()[0].max;
+		for (uint32_t i = 1; i < file.objectCount(); i++)
+		{
+			sceneMin = glm::min(sceneMin, file.bounds()[i].min);
+			sceneMax = glm::max(sceneMax, file.bounds()[i].max);
+		}
+		touchMs = std::min(touchMs, millisecondsSince(start));
+	}
+	std::remove(path);
+
+	std::cout << "scene file with " << COUNT << " objects: write " << writeMs << " ms, open " << openMs
+		<< " ms, pass over all bounds " << touchMs << " ms (scene " << sceneMin.x << " " << sceneMin.y << " " << sceneMin.z
+		<< " to " << sceneMax.x << " " << sceneMax.y << " " << sceneMax.z << ")" << std::endl;
+}
+
+void benchmarkFrustumCulling()
+{
+	const size_t COUNT = 1000000;
+	const int RUNS = 20;
+
+	// boxes scattered through a 200 unit cube around a camera looking down -z
+	std::vector<Aabb> boxes(COUNT);
+	unsigned int seed = 1;
+	for (Aabb& box : boxes)
+	{
+		glm::vec3 center;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			center[axis] = (seed >> 8) / float(1 << 24) * 200.0f - 100.0f;
+		}
+		box.min = center - glm::vec3(0.5f);
+		box.max = center + glm::vec3(0.5f);
+	}
+	FrustumCuller culler;
+	culler.setBounds(boxes.data(), boxes.size());
+
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+	Frustum frustum = Frustum::fromViewProjection(projection * view);
+
+	std::vector<uint32_t> reference;
+	culler.cull(frustum, reference, FrustumCuller::SCALAR);
+	std::cout << "frustum culling " << COUNT << " boxes: " << reference.size() << " visible" << std::endl;
+
+	std::vector<FrustumCuller::Path> paths = { FrustumCuller::SCALAR };
+	if (FrustumCuller::bestPath() != FrustumCuller::SCALAR)
+		paths.push_back(FrustumCuller::SSE);
+	if (FrustumCuller::bestPath() == FrustumCuller::AVX2)
+		paths.push_back(FrustumCuller::AVX2);
+	std::vector<uint32_t> visible;
+	for (FrustumCuller::Path path : paths)
+	{
+		double bestMs = 1e30;
+		for (int run = 0; run < RUNS; run++)
+		{
+			Clock::time_point start = Clock::now();
+			culler.cull(frustum, visible, path);
+			bestMs = std::min(bestMs, millisecondsSince(start));
+		}
+		std::cout << "  " << FrustumCuller::pathName(path) << ": " << bestMs << " ms"
+			<< (visible == reference ? "" : " (DIFFERENT RESULT)") << std::endl;
+	}
+}
+
+void benchmarkBvh()
+{
+	const size_t CLUSTERS = 15625;
+	const size_t PER_CLUSTER = 64;
+	const size_t COUNT = CLUSTERS * PER_CLUSTER;
+	const int RUNS = 20;
+	const int RAYS = 1000;
+
+	// clusters of small boxes, like the posts and spheres of a railing, spread
+	// through a 200 unit cube
+	unsigned int seed = 1;
+	auto random = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) / float(1 << 24);
+	};
+	std::vector<Aabb> boxes(COUNT);
+	for (size_t cluster = 0; cluster < CLUSTERS; cluster++)
+	{
+		glm::vec3 center(random() * 200.0f - 100.0f, random() * 200.0f - 100.0f, random() * 200.0f - 100.0f);
+		for (size_t i = 0; i < PER_CLUSTER; i++)
+		{
+			glm::vec3 offset(random() * 4.0f - 2.0f, random() * 4.0f - 2.0f, random() * 4.0f - 2.0f);
+			boxes[cluster * PER_CLUSTER + i].min = center + offset - glm::vec3(0.1f);
+			boxes[cluster * PER_CLUSTER + i].max = center + offset + glm::vec3(0.1f);
+		}
+	}
+
+	Bvh bvh;
+	Clock::time_point start = Clock::now();
+	bvh.build(boxes.data(), boxes.size());
+	std::cout << "BVH over " << COUNT << " boxes: " << bvh.nodeCount() << " nodes, built in " << millisecondsSince(start) << " ms" << std::endl;
+
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+	Frustum frustum = Frustum::fromViewProjection(projection * view);
+
+	// exact reference, one box at a time
+	std::vector<uint32_t> reference;
+	for (uint32_t i = 0; i < COUNT; i++)
+		if (frustum.intersects(boxes[i]))
+			reference.push_back(i);
+
+	std::vector<uint32_t> visible;
+	double bvhMs = 1e30;
+	for (int run = 0; run < RUNS; run++)
+	{
+		start = Clock::now();
+		bvh.cull(frustum, visible);
+		bvhMs = std::min(bvhMs, millisecondsSince(start));
+	}
+	std::cout << "  frustum: " << visible.size() << " visible, BVH " << bvhMs << " ms"
+		<< (visible == reference ? "" : " (DIFFERENT RESULT)");
+	FrustumCuller culler;
+	culler.setBounds(boxes.data(), boxes.size());
+	double flatMs = 1e30;
+	for (int run = 0; run < RUNS; run++)
+	{
+		start = Clock::now();
+		culler.cull(frustum, visible);
+		flatMs = std::min(flatMs, millisecondsSince(start));
+	}
+	std::cout << ", flat " << FrustumCuller::pathName(FrustumCuller::bestPath()) << " " << flatMs << " ms" << std::endl;
+
+	// one box in a hundred moves a little, then the whole tree is refit
+	start = Clock::now();
+	for (size_t i = 0; i < COUNT; i += 100)
+	{
+		boxes[i].min += glm::vec3(0.5f);
+		boxes[i].max += glm::vec3(0.5f);
+		bvh.setBounds((uint32_t)i, boxes[i]);
+	}
+	bvh.refit();
+	std::cout << "  refit after moving " << COUNT / 100 << " boxes: " << millisecondsSince(start) << " ms";
+	reference.clear();
+	for (uint32_t i = 0; i < COUNT; i++)
+		if (frustum.intersects(boxes[i]))
+			reference.push_back(i);
+	bvh.cull(frustum, visible);
+	std::cout << (visible == reference ? "" : " (DIFFERENT RESULT)") << std::endl;
+
+	// rays from the center in random directions, against a scan of every box
+	std::vector<glm::vec3> directions(RAYS);
+	for (glm::vec3& direction : directions)
+		direction = glm::normalize(glm::vec3(random() - 0.5f, random() - 0.5f, random() - 0.5f));
+	std::vector<uint32_t> hits(RAYS, UINT32_MAX);
+	start = Clock::now();
+	for (int ray = 0; ray < RAYS; ray++)
+	{
+		uint32_t object;
+		float distance;
+		if (bvh.raycast(glm::vec3(0.0f), directions[ray], 1000.0f, object, distance))
+			hits[ray] = object;
+	}
+	double rayMs = millisecondsSince(start);
+	int mismatches = 0;
+	start = Clock::now();
+	for (int ray = 0; ray < RAYS; ray++)
+	{
+		// nearest slab hit by brute force
+		glm::vec3 inverse = 1.0f / directions[ray];
+		float best = 1000.0f;
+		uint32_t nearest = UINT32_MAX;
+		for (uint32_t i = 0; i < COUNT; i++)
+		{
+			glm::vec3 t0 = boxes[i].min * inverse;
+			glm::vec3 t1 = boxes[i].max * inverse;
+			glm::vec3 near = glm::min(t0, t1);
+			glm::vec3 far = glm::max(t0, t1);
+			float tNear = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+			float tFar = std::min(std::min(far.x, far.y), std::min(far.z, best));
+			if (tNear <= tFar && (nearest == UINT32_MAX || tNear < best))
+			{
+				best = tNear;
+				nearest = i;
+			}
+		}
+		mismatches += nearest != hits[ray];
+	}
+	std::cout << "  " << RAYS << " rays: BVH " << rayMs << " ms, linear scan " << millisecondsSince(start) << " ms";
+	if (mismatches > 0)
+		std::cout << " (" << mismatches << " DIFFERENT RESULTS)";
+	std::cout << std::endl;
+}
+
+void benchmarkLooseOctree()
+{
+	const size_t COUNT = 100000;
+	const int FRAMES = 20;
+
+	// small boxes drifting through a 200 unit cube, every one moving each frame
+	unsigned int seed = 7;
+	auto random = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) / float(1 << 24);
+	};
+	std::vector<Aabb> boxes(COUNT);
+	std::vector<glm::vec3> velocities(COUNT);
+	for (size_t i = 0; i < COUNT; i++)
+	{
+		glm::vec3 center(random() * 200.0f - 100.0f, random() * 200.0f - 100.0f, random() * 200.0f - 100.0f);
+		float half = 0.05f + random() * 0.5f;
+		boxes[i].min = center - glm::vec3(half);
+		boxes[i].max = center + glm::vec3(half);
+		velocities[i] = glm::vec3(random() - 0.5f, random() - 0.5f, random() - 0.5f) * 0.2f;
+	}
+	Aabb range = { glm::vec3(-101.0f), glm::vec3(101.0f) };
+
+	LooseOctree octree;
+	Clock::time_point start = Clock::now();
+	octree.create(range, COUNT);
+	for (uint32_t i = 0; i < COUNT; i++)
+		octree.insert(i, boxes[i]);
+	std::cout << "loose octree over " << COUNT << " moving boxes: " << octree.nodeCount() << " cells, filled in "
+		<< millisecondsSince(start) << " ms" << std::endl;
+	Bvh bvh;
+	bvh.build(boxes.data(), boxes.size());
+
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+	Frustum frustum = Frustum::fromViewProjection(projection * view);
+
+	double octreeMoveMs = 0.0, octreeCullMs = 0.0, refitMs = 0.0, bvhCullMs = 0.0;
+	unsigned int relinks = renderStats().octreeRelinks;
+	bool same = true;
+	std::vector<uint32_t> visible, reference;
+	for (int frame = 0; frame < FRAMES; frame++)
+	{
+		for (size_t i = 0; i < COUNT; i++)
+		{
+			boxes[i].min += velocities[i];
+			boxes[i].max += velocities[i];
+		}
+
+		start = Clock::now();
+		for (uint32_t i = 0; i < COUNT; i++)
+			octree.move(i, boxes[i]);
+		octreeMoveMs += millisecondsSince(start);
+		start = Clock::now();
+		visible.clear();
+		octree.cull(frustum, visible);
+		std::sort(visible.begin(), visible.end());
+		octreeCullMs += millisecondsSince(start);
+
+		start = Clock::now();
+		for (uint32_t i = 0; i < COUNT; i++)
+			bvh.setBounds(i, boxes[i]);
+		bvh.refit();
+		refitMs += millisecondsSince(start);
+		start = Clock::now();
+		bvh.cull(frustum, reference);
+		bvhCullMs += millisecondsSince(start);
+		same = same && visible == reference;
+	}
+	relinks = renderStats().octreeRelinks - relinks;
+	std::cout << "  per frame: octree moves " << octreeMoveMs / FRAMES << " ms (" << relinks / FRAMES << " changed cell), cull "
+		<< octreeCullMs / FRAMES << " ms; BVH refit " << refitMs / FRAMES << " ms, cull " << bvhCullMs / FRAMES << " ms"
+		<< (same ? "" : " (DIFFERENT RESULT)") << std::endl;
+
+	// a few movers among many still objects: the octree pays per mover, a refit
+	// for the whole tree
+	start = Clock::now();
+	for (uint32_t i = 0; i < COUNT; i += 100)
+	{
+		boxes[i].min += velocities[i];
+		boxes[i].max += velocities[i];
+		octree.move(i, boxes[i]);
+	}
+	double fewMovesMs = millisecondsSince(start);
+	start = Clock::now();
+	for (uint32_t i = 0; i < COUNT; i += 100)
+		bvh.setBounds(i, boxes[i]);
+	bvh.refit();
+	std::cout << "  moving " << COUNT / 100 << " of them: octree " << fewMovesMs << " ms, BVH refit " << millisecondsSince(start) << " ms" << std::endl;
+}
+
+void benchmarkMeshOptimizer()
+{
+	struct Generator { const char* name; ShapeData (*make)(uint); uint sizes[3]; };
+	const Generator generators[] = {
+		{ "plane", ShapeGenerator::makePlane, { 10, 50, 100 } },
+		{ "sphere", ShapeGenerator::makeSphere, { 20, 50, 100 } },
+		{ "cylinder", ShapeGenerator::makeCylinder, { 10, 50, 200 } },
+	};
+	auto print = [](const VertexCacheStats& stats) {
+		std::printf("ACMR %.3f ATVR %.3f", stats.acmr, stats.atvr);
+	};
+
+	std::cout << "vertex cache, simulated FIFO of " << MeshOptimizer::CACHE_SIZE << " entries:" << std::endl;
+	for (const Generator& generator : generators)
+	{
+		for (uint size : generator.sizes)
+		{
+			ShapeData shape = generator.make(size);
+			std::printf("  %-8s %4u, %6u triangles: ", generator.name, size, shape.numIndices / 3);
+			print(MeshOptimizer::analyze(shape));
+			Clock::time_point start = Clock::now();
+			MeshOptimizer::optimizeVertexCache(shape);
+			double cacheMs = millisecondsSince(start);
+			std::printf(" -> cache order ");
+			print(MeshOptimizer::analyze(shape));
+			start = Clock::now();
+			MeshOptimizer::optimizeOverdraw(shape);
+			double overdrawMs = millisecondsSince(start);
+			std::printf(" -> overdraw order ");
+			print(MeshOptimizer::analyze(shape));
+			std::printf(" (%.2f + %.2f ms)\n", cacheMs, overdrawMs);
+			shape.cleanup();
+		}
+	}
+	ShapeData cube = ShapeGenerator::makeCube();
+	std::printf("  cube: ");
+	print(MeshOptimizer::analyze(cube));
+	MeshOptimizer::optimize(cube);
+	std::printf(" -> ");
+	print(MeshOptimizer::analyze(cube));
+	std::printf("\n");
+	cube.cleanup();
+}
+
+void benchmarkVertexFormats()
+{
+	struct Generator { const char* name; ShapeData (*make)(uint); uint sizes[3]; };
+	const Generator generators[] = {
+		{ "plane", ShapeGenerator::makePlane, { 10, 100, 255 } },
+		{ "sphere", ShapeGenerator::makeSphere, { 20, 100, 255 } },
+		{ "cylinder", ShapeGenerator::makeCylinder, { 10, 100, 1000 } },
+	};
+
+	std::cout << "vertex formats, " << sizeof(Vertex) << " bytes per float vertex, " << sizeof(CompactVertex) << " compact:" << std::endl;
+	for (const Generator& generator : generators)
+	{
+		for (uint size : generator.sizes)
+		{
+			ShapeData shape = generator.make(size);
+			GeometryBuffer floats, compact(GeometryBuffer::COMPACT_VERTICES);
+			floats.add(shape);
+			MeshDraw mesh = compact.add(shape);
+
+			// decode every vertex again on the CPU the way the GPU does
+			PositionQuantization quantization;
+			quantization.scale = mesh.positionScale;
+			quantization.offset = mesh.positionOffset;
+			float positionError = 0.0f, normalError = 0.0f, texCoordError = 0.0f;
+			for (GLuint i = 0; i < shape.numVertices; i++)
+			{
+				const Vertex& vertex = shape.vertices[i];
+				GLushort position[4];
+				quantization.encode(vertex.position, position);
+				positionError = std::max(positionError, glm::length(quantization.decode(position) - vertex.position));
+				glm::vec2 octahedral = VertexFormat::encodeOctahedral(vertex.normal);
+				glm::vec3 normal = VertexFormat::decodeOctahedral(glm::vec2(
+					VertexFormat::unpackSnorm16(VertexFormat::packSnorm16(octahedral.x)),
+					VertexFormat::unpackSnorm16(VertexFormat::packSnorm16(octahedral.y))));
+				// atan2 keeps its precision for the tiny angles acos loses
+				glm::vec3 reference = glm::normalize(vertex.normal);
+				float angle = std::atan2(glm::length(glm::cross(normal, reference)), glm::dot(normal, reference));
+				normalError = std::max(normalError, glm::degrees(angle));
+				for (int axis = 0; axis < 2; axis++)
+				{
+					float texCoord = VertexFormat::unpackHalf(VertexFormat::packHalf(vertex.texCoord[axis]));
+					texCoordError = std::max(texCoordError, std::fabs(texCoord - vertex.texCoord[axis]));
+				}
+			}
+			std::printf("  %-8s %4u, %7u vertices: %8.1f KB -> %7.1f KB, max error position %.2g, normal %.3g deg, uv %.2g\n",
+				generator.name, size, shape.numVertices, floats.vertexBufferSize() / 1024.0, compact.vertexBufferSize() / 1024.0,
+				positionError, normalError, texCoordError);
+			floats.cleanup();
+			compact.cleanup();
+			shape.cleanup();
+		}
+	}
+
+	// GPU: the normal matrix benchmark's dense spheres, drawn from each layout
+	// into a tiny viewport so the time goes to fetching and shading vertices
+	// ---------------------------------------------------------------------------
+	const unsigned int TESSELATION = 255;
+	const int GRID = 4;
+	Shader shader("shaderfiles/6.multiple_lights_instanced_normal.vs", "shaderfiles/6.multiple_lights.fs");
+	LightBuffer lights;
+	lights.create();
+	lights.bindTo(shader);
+	DirLight dirLight = {};
+	dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+	dirLight.diffuse = glm::vec3(0.8f);
+	lights.setDirLight(dirLight);
+	lights.flush();
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 12.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+	setFrameUniforms(shader, view, projection);
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glViewport(0, 0, 16, 16);
+	ShapeData sphere = ShapeGenerator::makeSphere(TESSELATION);
+	MeshOptimizer::optimize(sphere);
+	const GeometryBuffer::Layout layouts[] = { GeometryBuffer::FLOAT_VERTICES, GeometryBuffer::COMPACT_VERTICES };
+	for (GeometryBuffer::Layout layout : layouts)
+	{
+		GeometryBuffer geometry(layout);
+		MeshDraw sphereMesh = geometry.add(sphere);
+		geometry.upload();
+		geometry.configure(shader);
+		InstanceBatch spheres;
+		for (int x = 0; x < GRID; x++)
+			for (int y = 0; y < GRID; y++)
+				spheres.add(sphereMesh, glm::translate(glm::mat4(1.0f), glm::vec3(x * 2.5f - 3.75f, y * 2.5f - 3.75f, 0.0f)));
+		spheres.upload();
+		glBindVertexArray(geometry.vao());
+		DrawTiming timing = timeDraws(shader, spheres);
+		std::cout << "  " << GRID * GRID << " spheres x " << sphere.numVertices << " vertices, "
+			<< (layout == GeometryBuffer::COMPACT_VERTICES ? "compact" : "float  ") << ": gpu " << timing.gpuMs
+			<< " ms, wall " << timing.wallMs << " ms, " << geometry.vertexBufferSize() / 1024 << " KB" << std::endl;
+		spheres.cleanup();
+		geometry.cleanup();
+	}
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	sphere.cleanup();
+	lights.cleanup();
+	glDeleteProgram(shader.ID);
+}
+
+void benchmarkIndexWidths()
+{
+	struct Generator { const char* name; ShapeData (*make)(uint); uint size; float scale; };
+	const Generator generators[] = {
+		{ "plane", ShapeGenerator::makePlane, 400, 1.0f / 200.0f },   // one unit per vertex
+		{ "sphere", ShapeGenerator::makeSphere, 400, 1.0f },
+	};
+	const int GRID = 2;
+
+	Shader shader("shaderfiles/6.multiple_lights_instanced_normal.vs", "shaderfiles/6.multiple_lights.fs");
+	LightBuffer lights;
+	lights.create();
+	lights.bindTo(shader);
+	lights.flush();
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 12.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+	setFrameUniforms(shader, view, projection);
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glViewport(0, 0, 16, 16);
+
+	std::cout << "index widths, " << GRID * GRID << " instances each:" << std::endl;
+	for (const Generator& generator : generators)
+	{
+		ShapeData shape = generator.make(generator.size);
+		MeshOptimizer::optimizeVertexCache(shape);
+		for (int split = 0; split < 2; split++)
+		{
+			GeometryBuffer geometry;
+			std::vector<MeshDraw> draws;
+			if (split)
+				draws = geometry.addSplit(shape);
+			else
+				draws.push_back(geometry.add(shape));
+			geometry.upload();
+			geometry.configure(shader);
+
+			InstanceBatch batch;
+			for (int x = 0; x < GRID; x++)
+			{
+				for (int y = 0; y < GRID; y++)
+				{
+					// the plane is shrunk to the sphere's size and stood up to face the camera
+					glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x * 2.5f - 1.25f, y * 2.5f - 1.25f, 0.0f));
+					model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+					model = glm::scale(model, glm::vec3(generator.scale));
+					for (const MeshDraw& draw : draws)
+						batch.add(draw, model);
+				}
+			}
+			batch.upload();
+			glBindVertexArray(geometry.vao());
+			DrawTiming timing = timeDraws(shader, batch);
+			std::printf("  %-6s %u, %6u vertices, %s: %zu draw(s), %6u vertices, %7.1f KB of indices, gpu %.3f ms, wall %.3f ms\n",
+				generator.name, generator.size, shape.numVertices, split ? "16-bit pieces" : "32-bit       ", draws.size(),
+				geometry.numVertices(), geometry.indexBufferSize() / 1024.0, timing.gpuMs, timing.wallMs);
+			batch.cleanup();
+			geometry.cleanup();
+		}
+		shape.cleanup();
+	}
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	lights.cleanup();
+	glDeleteProgram(shader.ID);
+}
+
+void benchmarkShapeGeneration()
+{
+	const uint SIZE = 2048;
+	// FNV-1a over the vertex and index bytes
+	auto checksum = [](const ShapeData& shape) {
+		uint32_t hash = 2166136261u;
+		const unsigned char* bytes = (const unsigned char*)shape.vertices;
+		size_t vertexBytes = (size_t)shape.vertexBufferSize();
+		for (size_t i = 0; i < vertexBytes; i++)
+			hash = (hash ^ bytes[i]) * 16777619u;
+		bytes = (const unsigned char*)shape.indices;
+		for (size_t i = 0; i < shape.numIndices * sizeof(GLuint); i++)
+			hash = (hash ^ bytes[i]) * 16777619u;
+		return hash;
+	};
+
+	unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+	std::cout << "shape generation, " << SIZE << "x" << SIZE << " vertices, " << hardware << " hardware threads:" << std::endl;
+	for (unsigned int threads = 1; ; threads = std::min(threads * 2, hardware))
+	{
+		ThreadPool pool(threads - 1);
+		Clock::time_point start = Clock::now();
+		ShapeData plane = ShapeGenerator::makePlane(SIZE, pool);
+		double planeMs = millisecondsSince(start);
+		start = Clock::now();
+		ShapeData sphere = ShapeGenerator::makeSphere(SIZE, pool);
+		double sphereMs = millisecondsSince(start);
+		std::printf("  %2u threads: plane %8.1f ms (checksum %08x), sphere %8.1f ms (checksum %08x)\n",
+			threads, planeMs, checksum(plane), sphereMs, checksum(sphere));
+		plane.cleanup();
+		sphere.cleanup();
+		if (threads == hardware)
+			break;
+	}
+}
+
+void benchmarkSphereGenerators()
+{
+	struct Generator { const char* name; ShapeData (*make)(uint); uint first; uint last; };
+	const Generator generators[] = {
+		{ "UV sphere", ShapeGenerator::makeSphere, 4, 1024 },
+		{ "icosphere", ShapeGenerator::makeIcosphere, 0, 8 },
+		{ "cube sphere", ShapeGenerator::makeCubeSphere, 1, 512 },
+	};
+	const float targets[] = { 1e-2f, 1e-3f, 1e-4f };
+
+	std::cout << "sphere generators, smallest size under each deviation from the unit sphere:" << std::endl;
+	for (float target : targets)
+	{
+		for (const Generator& generator : generators)
+		{
+			// the error only shrinks as the size grows, so the first size under the
+			// target is the one to report
+			for (uint size = generator.first; size <= generator.last; size++)
+			{
+				ShapeData shape = generator.make(size);
+				SphereError error = measureSphere(shape);
+				if (error.maxError <= target || size == generator.last)
+				{
+					std::printf("  error %.0e, %-11s %4u: %7u vertices, %7u triangles (%5u degenerate, smallest angle %4.1f), error %.2e\n",
+						target, generator.name, size, shape.numVertices, shape.numIndices / 3, error.degenerate, error.smallestAngle, error.maxError);
+					shape.cleanup();
+					break;
+				}
+				shape.cleanup();
+			}
+		}
+	}
+}
+
+void benchmarkMeshCache()
+{
+	const MeshKey keys[] = {
+		{ MeshKey::CUBE, 0 }, { MeshKey::PLANE, 10 }, { MeshKey::SPHERE, 20 }, { MeshKey::CYLINDER, 10 }
+	};
+	const int REQUESTS = 1000;
+
+	std::cout << "mesh cache, " << REQUESTS << " requests of each scene shape:" << std::endl;
+	{
+		GeometryBuffer geometry(GeometryBuffer::COMPACT_VERTICES);
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < REQUESTS; i++)
+		{
+			for (const MeshKey& key : keys)
+			{
+				ShapeData shape;
+				switch (key.generator)
+				{
+				case MeshKey::CUBE: shape = ShapeGenerator::makeCube(); break;
+				case MeshKey::PLANE: shape = ShapeGenerator::makePlane(key.size); break;
+				case MeshKey::SPHERE: shape = ShapeGenerator::makeSphere(key.size); break;
+				default: shape = ShapeGenerator::makeCylinder(key.size); break;
+				}
+				MeshOptimizer::optimize(shape);
+				geometry.add(shape);
+				shape.cleanup();
+			}
+		}
+		double ms = millisecondsSince(start);
+		std::printf("  uncached: %9.3f us per request, %8.1f KB of buffers\n", ms * 1000.0 / (REQUESTS * 4),
+			(geometry.vertexBufferSize() + geometry.indexBufferSize()) / 1024.0);
+		geometry.cleanup();
+	}
+	{
+		GeometryBuffer geometry(GeometryBuffer::COMPACT_VERTICES);
+		MeshCache meshes(geometry);
+		std::vector<MeshHandle> handles;
+		handles.reserve(REQUESTS * 8);
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < REQUESTS; i++)
+		{
+			for (const MeshKey& key : keys)
+				handles.push_back(meshes.get(key));
+		}
+		double ms = millisecondsSince(start);
+		// the first request of each shape is the generation itself
+		start = Clock::now();
+		for (int i = 0; i < REQUESTS; i++)
+		{
+			for (const MeshKey& key : keys)
+				handles.push_back(meshes.get(key));
+		}
+		double hitMs = millisecondsSince(start);
+		std::printf("  cached:   %9.3f us per request, %8.1f KB of buffers, %.3f us per hit\n", ms * 1000.0 / (REQUESTS * 4),
+			(geometry.vertexBufferSize() + geometry.indexBufferSize()) / 1024.0, hitMs * 1000.0 / (REQUESTS * 4));
+		handles.clear();
+		meshes.report(std::cout);
+		geometry.cleanup();
+	}
+}
+
+void benchmarkMeshlets()
+{
+	struct Generator { const char* name; ShapeData (*make)(uint); uint size; float scale; };
+	const Generator generators[] = {
+		{ "sphere", ShapeGenerator::makeSphere, 255, 1.0f },
+		{ "icosphere", ShapeGenerator::makeIcosphere, 6, 1.0f },
+		{ "cube sphere", ShapeGenerator::makeCubeSphere, 100, 1.0f },
+		{ "plane", ShapeGenerator::makePlane, 255, 2.0f / 254.0f },   // 2 units across, facing up
+	};
+	// the shapes are all about 2 units across around the origin
+	struct Pose { const char* name; glm::vec3 eye; glm::vec3 target; };
+	const Pose poses[] = {
+		{ "overview", glm::vec3(0.0f, 2.0f, 4.0f), glm::vec3(0.0f) },
+		{ "close up", glm::vec3(0.3f, 0.6f, 1.5f), glm::vec3(0.0f, 0.3f, 0.7f) },
+		{ "from below", glm::vec3(0.5f, -2.5f, 1.5f), glm::vec3(0.0f) },
+	};
+	const float ASPECT = 16.0f / 9.0f;
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), ASPECT, 0.1f, 100.0f);
+
+	Shader shader("shaderfiles/6.multiple_lights_instanced_normal.vs", "shaderfiles/6.multiple_lights.fs");
+	LightBuffer lights;
+	lights.create();
+	lights.bindTo(shader);
+	lights.flush();
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glViewport(0, 0, 16, 16);
+
+	std::cout << "meshlets of up to " << Meshlets::MAX_VERTICES << " vertices and " << Meshlets::MAX_TRIANGLES << " triangles:" << std::endl;
+	for (const Generator& generator : generators)
+	{
+		ShapeData shape = generator.make(generator.size);
+		glm::mat4 model = glm::scale(glm::mat4(1.0f), glm::vec3(generator.scale));
+		Clock::time_point start = Clock::now();
+		std::vector<Meshlet> meshlets = Meshlets::build(shape);
+		double buildMs = millisecondsSince(start);
+		size_t vertices = 0;
+		for (const Meshlet& meshlet : meshlets)
+			vertices += meshlet.vertexCount;
+		std::printf("  %-11s %3u, %6u triangles: %5zu meshlets, %.1f triangles and %.1f vertices each, ACMR %.3f, built in %.1f ms\n",
+			generator.name, generator.size, shape.numIndices / 3, meshlets.size(), shape.numIndices / 3.0 / meshlets.size(),
+			(double)vertices / meshlets.size(), MeshOptimizer::analyze(shape).acmr, buildMs);
+
+		GeometryBuffer geometry;
+		MeshDraw mesh = geometry.add(shape);
+		geometry.upload();
+		geometry.configure(shader);
+
+		for (const Pose& pose : poses)
+		{
+			glm::mat4 view = glm::lookAt(pose.eye, pose.target, glm::vec3(0.0f, 1.0f, 0.0f));
+			Frustum frustum = Frustum::fromViewProjection(projection * view);
+			std::vector<MeshDraw> draws;
+			MeshletCullStats stats;
+			start = Clock::now();
+			Meshlets::cull(meshlets, mesh, model, frustum, pose.eye, draws, stats);
+			double cullMs = millisecondsSince(start);
+
+			// every dropped triangle must face away or lie wholly outside one plane
+			unsigned int wrong = 0;
+			std::vector<bool> kept(shape.numIndices / 3, false);
+			for (const MeshDraw& draw : draws)
+			{
+				GLuint first = (GLuint)((const char*)draw.indices - (const char*)mesh.indices) / (mesh.indexType == GL_UNSIGNED_SHORT ? 2 : 4) / 3;
+				for (GLuint t = first; t < first + draw.count / 3; t++)
+					kept[t] = true;
+			}
+			for (GLuint t = 0; t < shape.numIndices / 3; t++)
+			{
+				if (kept[t])
+					continue;
+				glm::vec3 corners[3];
+				for (int k = 0; k < 3; k++)
+					corners[k] = glm::vec3(model * glm::vec4(shape.vertices[shape.indices[t * 3 + k]].position, 1.0f));
+				bool facing = glm::dot(glm::cross(corners[1] - corners[0], corners[2] - corners[0]), pose.eye - corners[0]) > 0.0f;
+				bool outside = false;
+				for (int i = 0; i < 6 && !outside; i++)
+				{
+					outside = true;
+					for (int k = 0; k < 3; k++)
+						outside = outside && glm::dot(glm::vec3(frustum.planes[i]), corners[k]) + frustum.planes[i].w < 0.0f;
+				}
+				wrong += facing && !outside ? 1 : 0;
+			}
+
+			setFrameUniforms(shader, view, projection);
+			DrawTiming timings[2];
+			for (int culled = 0; culled < 2; culled++)
+			{
+				InstanceBatch batch;
+				if (culled)
+				{
+					for (const MeshDraw& draw : draws)
+						batch.add(draw, model);
+				}
+				else
+				{
+					batch.add(mesh, model);
+				}
+				batch.upload();
+				glBindVertexArray(geometry.vao());
+				timings[culled] = batch.size() > 0 ? timeDraws(shader, batch) : DrawTiming{ 0.0, 0.0 };
+				batch.cleanup();
+			}
+			std::printf("    %-10s culled %5.1f%% (%4.1f%% facing away, %4.1f%% off screen) in %.3f ms, %3u draws, %u wrongly culled, gpu %.3f -> %.3f ms, wall %.3f -> %.3f ms\n",
+				pose.name, stats.culledFraction() * 100.0f, 100.0f * stats.backfacingTriangles / stats.triangles,
+				100.0f * stats.offscreenTriangles / stats.triangles, cullMs, stats.ranges, wrong,
+				timings[0].gpuMs, timings[1].gpuMs, timings[0].wallMs, timings[1].wallMs);
+		}
+		geometry.cleanup();
+		shape.cleanup();
+	}
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	lights.cleanup();
+}
+
+void benchmarkSimplifier()
+{
+	struct Generator { const char* name; ShapeData (*make)(uint); uint size; bool sphere; };
+	const Generator generators[] = {
+		{ "sphere", ShapeGenerator::makeSphere, 100, true },
+		{ "icosphere", ShapeGenerator::makeIcosphere, 5, true },
+		{ "cube sphere", ShapeGenerator::makeCubeSphere, 40, true },
+		{ "plane", ShapeGenerator::makePlane, 100, false },
+	};
+	const float ratios[] = { 0.5f, 0.25f, 0.125f, 0.0625f };
+	const unsigned int LEVELS = sizeof(ratios) / sizeof(ratios[0]);
+	// a level is used until its error would cover a pixel at 1080 lines
+	const float PIXELS = 1.0f, VIEWPORT_HEIGHT = 1080.0f;
+	const char* path = "scenefiles/benchmark.lod";
+
+	std::cout << "quadric simplification, levels at";
+	for (float ratio : ratios)
+		std::cout << " " << ratio;
+	std::cout << " of the triangles:" << std::endl;
+	for (const Generator& generator : generators)
+	{
+		ShapeData shape = generator.make(generator.size);
+		Aabb bounds = Aabb::fromShape(shape);
+		std::vector<GLuint> original(shape.indices, shape.indices + shape.numIndices);
+		size_t originalOpen = countOpenEdges(shape, original);
+		float originalError = generator.sphere ? measureSphere(shape).maxError : 0.0f;
+
+		std::remove(path);
+		Clock::time_point start = Clock::now();
+		std::vector<SimplifiedLevel> levels = MeshSimplifier::cachedChain(path, shape, ratios, LEVELS);
+		double buildMs = millisecondsSince(start);
+		start = Clock::now();
+		std::vector<SimplifiedLevel> cached = MeshSimplifier::cachedChain(path, shape, ratios, LEVELS);
+		double loadMs = millisecondsSince(start);
+		bool same = cached.size() == levels.size();
+		for (size_t i = 0; same && i < levels.size(); i++)
+			same = cached[i].indices == levels[i].indices && cached[i].error == levels[i].error;
+		std::remove(path);
+
+		std::printf("  %-11s %3u, %6u triangles, %zu open edges: chain built in %.1f ms, read back from disk in %.2f ms%s\n",
+			generator.name, generator.size, shape.numIndices / 3, originalOpen, buildMs, loadMs, same ? "" : " (MISMATCH)");
+		for (unsigned int i = 0; i < LEVELS; i++)
+		{
+			const SimplifiedLevel& level = levels[i];
+			std::printf("    %6.4f: %6zu triangles, error %.5f", level.ratio, level.indices.size() / 3, level.error);
+			if (generator.sphere)
+			{
+				ShapeData simplified = MeshSimplifier::extract(shape, level);
+				std::printf(" (measured %.5f)", std::max(measureSphere(simplified).maxError - originalError, 0.0f));
+				simplified.cleanup();
+			}
+			// the finer level gives way to this one below the screen size
+			std::printf(", %zu open edges", countOpenEdges(shape, level.indices));
+			if (level.error > 0.0f)
+				std::printf(", used below screen size %.3f\n", LodChain::screenSizeForError(bounds, level.error, PIXELS, VIEWPORT_HEIGHT));
+			else
+				std::printf(", exact at any size\n");
+		}
+		shape.cleanup();
+	}
+}
+
+void benchmarkMeshFile()
+{
+	struct Generator { const char* name; ShapeData (*make)(uint); uint size; };
+	const Generator generators[] = {
+		{ "sphere", ShapeGenerator::makeSphere, 200 },
+		{ "icosphere", ShapeGenerator::makeIcosphere, 6 },
+		{ "cube sphere", ShapeGenerator::makeCubeSphere, 80 },
+		{ "plane", ShapeGenerator::makePlane, 500 },
+	};
+	const int RUNS = 5;
+	const char* path = "scenefiles/benchmark.mesh";
+
+	GLuint vao = 0, buffers[2] = { 0, 0 };
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(2, buffers);
+	glBindVertexArray(vao);
+
+	std::cout << "compiled mesh files against generating at startup (best of " << RUNS << ", file in the page cache):" << std::endl;
+	for (const Generator& generator : generators)
+	{
+		// what startup does without the file: generate, reorder, compute the
+		// tangents and upload the float layout
+		double buildMs = 1e30;
+		for (int run = 0; run < RUNS; run++)
+		{
+			Clock::time_point start = Clock::now();
+			ShapeData shape = generator.make(generator.size);
+			MeshOptimizer::optimize(shape);
+			std::vector<glm::vec4> tangents = MeshFile::computeTangents(shape);
+			glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+			glBufferData(GL_ARRAY_BUFFER, shape.vertexBufferSize(), shape.vertices, GL_STATIC_DRAW);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, shape.numIndices * sizeof(GLuint), shape.indices, GL_STATIC_DRAW);
+			glFinish();
+			buildMs = std::min(buildMs, millisecondsSince(start));
+			shape.cleanup();
+		}
+
+		ShapeData shape = generator.make(generator.size);
+		MeshOptimizer::optimize(shape);
+		Clock::time_point start = Clock::now();
+		if (!MeshFile::write(path, shape))
+			return;
+		double compileMs = millisecondsSince(start);
+
+		double loadMs = 1e30;
+		for (int run = 0; run < RUNS; run++)
+		{
+			MeshFile file;
+			start = Clock::now();
+			if (!file.open(path))
+				return;
+			file.upload(buffers[0], buffers[1]);
+			glFinish();
+			loadMs = std::min(loadMs, millisecondsSince(start));
+		}
+
+		// what survived the packing: positions against the originals, tangents
+		// against the normals and against the direction of increasing u
+		MeshFile file;
+		if (!file.open(path))
+			return;
+		PositionQuantization quantization = file.quantization();
+		std::vector<glm::vec3> tangents(file.vertexCount());
+		float positionError = 0.0f, tangentDot = 0.0f;
+		for (uint32_t i = 0; i < file.vertexCount(); i++)
+		{
+			const CompactMeshVertex& packed = file.vertices()[i];
+			positionError = std::max(positionError, glm::length(quantization.decode(packed.Position) - shape.vertices[i].position));
+			for (int axis = 0; axis < 3; axis++)
+			{
+				int value = (int)((packed.Tangent >> (axis * 10)) & 1023u);
+				tangents[i][axis] = std::max((value >= 512 ? value - 1024 : value) / 511.0f, -1.0f);
+			}
+			glm::vec2 octahedral(VertexFormat::unpackSnorm16(packed.Normal[0]), VertexFormat::unpackSnorm16(packed.Normal[1]));
+			tangentDot = std::max(tangentDot, std::fabs(glm::dot(glm::normalize(tangents[i]), VertexFormat::decodeOctahedral(octahedral))));
+		}
+		unsigned int along = 0, textured = 0;
+		for (GLuint i = 0; i + 2 < shape.numIndices; i += 3)
+		{
+			const Vertex& a = shape.vertices[shape.indices[i]];
+			const Vertex& b = shape.vertices[shape.indices[i + 1]];
+			const Vertex& c = shape.vertices[shape.indices[i + 2]];
+			glm::vec2 d1 = b.texCoord - a.texCoord, d2 = c.texCoord - a.texCoord;
+			float determinant = d1.x * d2.y - d2.x * d1.y;
+			if (std::fabs(determinant) < 1e-12f)
+				continue;
+			glm::vec3 u = ((b.position - a.position) * d2.y - (c.position - a.position) * d1.y) * (1.0f / determinant);
+			textured++;
+			along += glm::dot(u, tangents[shape.indices[i]]) > 0.0f ? 1 : 0;
+		}
+		size_t fileBytes = file.vertexCount() * sizeof(CompactMeshVertex) + file.indexBytes();
+		size_t floatBytes = shape.vertexBufferSize() + shape.numIndices * sizeof(GLuint);
+		file.close();
+		std::remove(path);
+
+		std::printf("  %-11s %3u, %6u vertices: generated %.2f ms, loaded %.2f ms (%.1fx), written in %.1f ms; %.0f KB against %.0f KB\n",
+			generator.name, generator.size, shape.numVertices, buildMs, loadMs, buildMs / loadMs, compileMs, fileBytes / 1024.0, floatBytes / 1024.0);
+		std::printf("    position error %.6f, largest |tangent . normal| %.4f, tangent along +u in %.1f%% of textured triangles\n",
+			positionError, tangentDot, textured > 0 ? 100.0 * along / textured : 0.0);
+		shape.cleanup();
+	}
+
+	glBindVertexArray(0);
+	glDeleteBuffers(2, buffers);
+	glDeleteVertexArrays(1, &vao);
+}
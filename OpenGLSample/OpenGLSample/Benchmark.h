@@ -0,0 +1,70 @@
+#pragma once
+
+// Offline measurements, run instead of the scene with "--benchmark" on the
+// command line. Each one prints its results to the console. A GL context must
+// be current and glad loaded.
+
+// Vertex-stage cost of the instanced lighting shader with inverse() per vertex
+// against the variant that reads a CPU-computed normal matrix, plus the CPU
+// cost of the batched normal-matrix kernel against plain glm.
+void benchmarkNormalMatrices();
+
+// Writes a scene file of a million objects, then times mapping it and one pass
+// over its bounds.
+void benchmarkSceneFile();
+
+// Frustum test of a million boxes with each SIMD path the CPU supports.
+void benchmarkFrustumCulling();
+
+// Builds a BVH over a million boxes in clusters like a scene's, then times
+// hierarchical frustum culling, refitting and ray queries against flat scans.
+void benchmarkBvh();
+
+// Moves a hundred thousand boxes every frame through a loose octree and through
+// a refit BVH, timing the updates and a frustum cull of each.
+void benchmarkLooseOctree();
+
+// ACMR and ATVR of every shape generator at a few sizes, as generated, after the
+// vertex cache pass and after the overdraw pass.
+void benchmarkMeshOptimizer();
+
+// Vertex buffer size of the tessellated shapes in the float and compact layouts
+// with the error the compact one introduces, then the GPU time of drawing dense
+// spheres from each.
+void benchmarkVertexFormats();
+
+// A plane and a sphere past the 16-bit vertex limit, drawn once with 32-bit
+// indices and once split into 16-bit pieces: index bytes and GPU time of each.
+void benchmarkIndexWidths();
+
+// Generates a 2048x2048 plane and sphere on pools of 1, 2, 4... threads up to
+// the CPU's count, with a checksum of each result to show it does not change.
+void benchmarkShapeGeneration();
+
+// UV sphere, icosphere and cube sphere at the smallest size that brings their
+// deviation from the true sphere under a few targets: vertices, triangles and
+// degenerate triangles of each.
+void benchmarkSphereGenerators();
+
+// The scene's shapes asked for a thousand times each, first generated and added
+// on every request, then through a MeshCache: time per request and buffer size
+// of both, and the cache's report.
+void benchmarkMeshCache();
+
+// Splits a dense sphere, icosphere, cube sphere and plane into meshlets, then
+// culls them from a few camera poses: the fraction of triangles dropped as
+// facing away and as off screen, a check that no visible triangle was dropped,
+// and the GPU time of the whole shape against the surviving ranges.
+void benchmarkMeshlets();
+
+// LOD chains of a few shapes by quadric simplification: triangles and the
+// reported error of each level with the screen size it would switch at, the
+// measured error for the spheres, open edges against the original (seams and
+// borders must not crack), and building the chain against reading it back from
+// the disk cache.
+void benchmarkSimplifier();
+
+// Dense shapes generated, reordered, given tangents and uploaded as at startup,
+// against compiled into a mesh file and then mapped and uploaded from it: time
+// of each, bytes, and what the packing cost in position and tangent accuracy.
+void benchmarkMeshFile();
@@ -0,0 +1,381 @@
+#include "Bvh.h"
+#include "Scene.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const int BIN_COUNT = 16;
+	const uint32_t MAX_LEAF_OBJECTS = 8;
+	// cost of visiting one more node, relative to testing one object's box
+	const float TRAVERSAL_COST = 1.0f;
+	// below this depth the SAH decides; past it nodes are halved by count, which
+	// keeps any tree shallow enough for the fixed traversal stacks
+	const int SAH_DEPTH = 40;
+	const int STACK_SIZE = 64;
+
+	float area(const glm::vec3& min, const glm::vec3& max)
+	{
+		glm::vec3 d = glm::max(max - min, glm::vec3(0.0f));
+		return d.x * d.y + d.y * d.z + d.z * d.x;
+	}
+
+	struct Bin
+	{
+		glm::vec3 min = glm::vec3(INFINITY);
+		glm::vec3 max = glm::vec3(-INFINITY);
+		uint32_t count = 0;
+
+		void grow(const Aabb& box)
+		{
+			min = glm::min(min, box.min);
+			max = glm::max(max, box.max);
+		}
+		void grow(const Bin& bin)
+		{
+			min = glm::min(min, bin.min);
+			max = glm::max(max, bin.max);
+			count += bin.count;
+		}
+	};
+
+	// which planes of the mask the node lies fully in front of are dropped from
+	// it, so its children skip them; false if it is behind any plane
+	bool testPlanes(const Frustum& frustum, const BvhNode& node, unsigned int& mask)
+	{
+		glm::vec3 center = (node.min + node.max) * 0.5f;
+		glm::vec3 extent = (node.max - node.min) * 0.5f;
+		for (int p = 0; p < 6; p++)
+		{
+			if ((mask & (1u << p)) == 0)
+				continue;
+			const glm::vec4& plane = frustum.planes[p];
+			float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+			float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+			if (distance + radius < 0.0f)
+				return false;
+			if (distance - radius >= 0.0f)
+				mask &= ~(1u << p);
+		}
+		return true;
+	}
+
+	bool overlaps(const glm::vec3& minA, const glm::vec3& maxA, const Aabb& b)
+	{
+		return minA.x <= b.max.x && maxA.x >= b.min.x
+			&& minA.y <= b.max.y && maxA.y >= b.min.y
+			&& minA.z <= b.max.z && maxA.z >= b.min.z;
+	}
+
+	// slab test; the entry distance when the ray hits the box before limit. An
+	// axis the ray is parallel to (infinite inverse) is tested on the origin
+	// alone, since 0 * infinity would be NaN for an origin on one of its planes.
+	bool hitBox(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin, const glm::vec3& inverse, float limit, float& entry)
+	{
+		float tNear = 0.0f, tFar = limit;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (std::isinf(inverse[axis]))
+			{
+				if (origin[axis] < min[axis] || origin[axis] > max[axis])
+					return false;
+				continue;
+			}
+			float t0 = (min[axis] - origin[axis]) * inverse[axis];
+			float t1 = (max[axis] - origin[axis]) * inverse[axis];
+			tNear = std::max(tNear, std::min(t0, t1));
+			tFar = std::min(tFar, std::max(t0, t1));
+		}
+		entry = tNear;
+		return tNear <= tFar;
+	}
+}
+
+void Bvh::build(const Aabb* newBoxes, size_t count)
+{
+	clear();
+	if (count == 0)
+		return;
+	boxes.assign(newBoxes, newBoxes + count);
+	order.resize(count);
+	std::vector<glm::vec3> centroids(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		order[i] = i;
+		centroids[i] = boxes[i].center();
+	}
+	nodes.reserve(count * 2 / MAX_LEAF_OBJECTS * 2 + 1);
+	buildNode(0, (uint32_t)count, 0, centroids);
+	dirty = false;
+}
+
+uint32_t Bvh::buildNode(uint32_t first, uint32_t count, int depth, std::vector<glm::vec3>& centroids)
+{
+	uint32_t self = (uint32_t)nodes.size();
+	nodes.push_back(BvhNode());
+
+	Bin bounds, centroidBounds;
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		bounds.grow(boxes[order[i]]);
+		centroidBounds.min = glm::min(centroidBounds.min, centroids[order[i]]);
+		centroidBounds.max = glm::max(centroidBounds.max, centroids[order[i]]);
+	}
+	nodes[self].min = bounds.min;
+	nodes[self].max = bounds.max;
+
+	auto makeLeaf = [&]() {
+		nodes[self].index = first;
+		nodes[self].count = count;
+		return self;
+	};
+	if (count == 1)
+		return makeLeaf();
+
+	// try the bin boundaries along each axis; cost is objects times surface area
+	// on both sides plus the extra node, against the leaf's objects times its own
+	float bestCost = INFINITY;
+	int bestAxis = -1;
+	int bestSplit = 0;
+	glm::vec3 centroidExtent = centroidBounds.max - centroidBounds.min;
+	for (int axis = 0; axis < 3 && depth < SAH_DEPTH; axis++)
+	{
+		if (centroidExtent[axis] <= 0.0f)
+			continue;
+		Bin bins[BIN_COUNT];
+		float scale = BIN_COUNT / centroidExtent[axis];
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			int bin = std::min(BIN_COUNT - 1, (int)((centroids[order[i]][axis] - centroidBounds.min[axis]) * scale));
+			bins[bin].grow(boxes[order[i]]);
+			bins[bin].count++;
+		}
+		// right-hand areas swept from the top, then left-hand ones from the bottom
+		float rightCost[BIN_COUNT];
+		Bin right;
+		for (int split = BIN_COUNT - 1; split > 0; split--)
+		{
+			right.grow(bins[split]);
+			rightCost[split] = right.count * area(right.min, right.max);
+		}
+		Bin left;
+		for (int split = 1; split < BIN_COUNT; split++)
+		{
+			left.grow(bins[split - 1]);
+			if (left.count == 0 || left.count == count)
+				continue;
+			float cost = left.count * area(left.min, left.max) + rightCost[split];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	uint32_t middle;
+	if (bestAxis >= 0)
+	{
+		float nodeArea = area(bounds.min, bounds.max);
+		if (count <= MAX_LEAF_OBJECTS && TRAVERSAL_COST * nodeArea + bestCost >= count * nodeArea)
+			return makeLeaf();
+		float scale = BIN_COUNT / centroidExtent[bestAxis];
+		float lowest = centroidBounds.min[bestAxis];
+		uint32_t* split = std::partition(order.data() + first, order.data() + first + count, [&](uint32_t object) {
+			return std::min(BIN_COUNT - 1, (int)((centroids[object][bestAxis] - lowest) * scale)) < bestSplit;
+		});
+		middle = (uint32_t)(split - order.data());
+	}
+	else
+	{
+		// all centroids in one spot, or too deep: halve by count
+		if (count <= MAX_LEAF_OBJECTS)
+			return makeLeaf();
+		int axis = centroidExtent.x >= centroidExtent.y && centroidExtent.x >= centroidExtent.z ? 0 : centroidExtent.y >= centroidExtent.z ? 1 : 2;
+		middle = first + count / 2;
+		std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + first + count, [&](uint32_t a, uint32_t b) {
+			return centroids[a][axis] < centroids[b][axis];
+		});
+	}
+
+	buildNode(first, middle - first, depth + 1, centroids);
+	uint32_t rightChild = buildNode(middle, first + count - middle, depth + 1, centroids);
+	nodes[self].index = rightChild;
+	nodes[self].count = 0;
+	return self;
+}
+
+void Bvh::setBounds(uint32_t object, const Aabb& box)
+{
+	boxes[object] = box;
+	dirty = true;
+}
+
+// Children always come after their parent, so one backwards pass sees every
+// node after both of its children.
+void Bvh::refit()
+{
+	if (!dirty)
+		return;
+	for (size_t i = nodes.size(); i-- > 0;)
+	{
+		BvhNode& node = nodes[i];
+		if (node.count > 0)
+		{
+			node.min = boxes[order[node.index]].min;
+			node.max = boxes[order[node.index]].max;
+			for (uint32_t j = node.index + 1; j < node.index + node.count; j++)
+			{
+				node.min = glm::min(node.min, boxes[order[j]].min);
+				node.max = glm::max(node.max, boxes[order[j]].max);
+			}
+		}
+		else
+		{
+			const BvhNode& left = nodes[i + 1];
+			const BvhNode& right = nodes[node.index];
+			node.min = glm::min(left.min, right.min);
+			node.max = glm::max(left.max, right.max);
+		}
+	}
+	dirty = false;
+}
+
+void Bvh::addSubtree(uint32_t node, std::vector<uint32_t>& objects) const
+{
+	// a subtree's leaves cover one run of the order: from its first leaf's start
+	// to its last leaf's end
+	uint32_t first = node;
+	while (nodes[first].count == 0)
+		first++;
+	uint32_t last = node;
+	while (nodes[last].count == 0)
+		last = nodes[last].index;
+	objects.insert(objects.end(), order.begin() + nodes[first].index, order.begin() + nodes[last].index + nodes[last].count);
+}
+
+void Bvh::cull(const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+	visible.clear();
+	if (nodes.empty())
+		return;
+	struct Entry { uint32_t node; unsigned int mask; };
+	Entry stack[STACK_SIZE];
+	int top = 0;
+	stack[top++] = { 0, 0x3F };
+	while (top > 0)
+	{
+		Entry entry = stack[--top];
+		const BvhNode& node = nodes[entry.node];
+		if (!testPlanes(frustum, node, entry.mask))
+			continue;
+		if (entry.mask == 0)
+		{
+			addSubtree(entry.node, visible);
+			continue;
+		}
+		if (node.count > 0)
+		{
+			for (uint32_t i = node.index; i < node.index + node.count; i++)
+			{
+				const Aabb& box = boxes[order[i]];
+				BvhNode leaf = { box.min, box.max, 0, 1 };
+				unsigned int mask = entry.mask;
+				if (testPlanes(frustum, leaf, mask))
+					visible.push_back(order[i]);
+			}
+			continue;
+		}
+		stack[top++] = { node.index, entry.mask };
+		stack[top++] = { entry.node + 1, entry.mask };
+	}
+	std::sort(visible.begin(), visible.end());
+}
+
+void Bvh::overlap(const Aabb& box, std::vector<uint32_t>& objects) const
+{
+	objects.clear();
+	if (nodes.empty())
+		return;
+	uint32_t stack[STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		uint32_t index = stack[--top];
+		const BvhNode& node = nodes[index];
+		if (!overlaps(node.min, node.max, box))
+			continue;
+		if (node.count > 0)
+		{
+			for (uint32_t i = node.index; i < node.index + node.count; i++)
+				if (overlaps(boxes[order[i]].min, boxes[order[i]].max, box))
+					objects.push_back(order[i]);
+			continue;
+		}
+		stack[top++] = node.index;
+		stack[top++] = index + 1;
+	}
+	std::sort(objects.begin(), objects.end());
+}
+
+bool Bvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t& object, float& distance) const
+{
+	if (nodes.empty())
+		return false;
+	// 1/0 gives infinity, which hitBox() treats as a ray parallel to that slab
+	glm::vec3 inverse = 1.0f / direction;
+	float best = maxDistance;
+	bool found = false;
+	struct Entry { uint32_t node; float entry; };
+	Entry stack[STACK_SIZE];
+	int top = 0;
+	float entry;
+	if (!hitBox(nodes[0].min, nodes[0].max, origin, inverse, best, entry))
+		return false;
+	stack[top++] = { 0, entry };
+	while (top > 0)
+	{
+		Entry current = stack[--top];
+		// a closer hit found since this node was pushed may rule it out
+		if (current.entry > best)
+			continue;
+		const BvhNode& node = nodes[current.node];
+		if (node.count > 0)
+		{
+			for (uint32_t i = node.index; i < node.index + node.count; i++)
+			{
+				const Aabb& box = boxes[order[i]];
+				if (hitBox(box.min, box.max, origin, inverse, best, entry) && (!found || entry < best))
+				{
+					best = entry;
+					object = order[i];
+					found = true;
+				}
+			}
+			continue;
+		}
+		// push the farther child first so the nearer one is visited next
+		uint32_t children[2] = { current.node + 1, node.index };
+		float entries[2];
+		bool hits[2];
+		for (int c = 0; c < 2; c++)
+			hits[c] = hitBox(nodes[children[c]].min, nodes[children[c]].max, origin, inverse, best, entries[c]);
+		int nearer = hits[0] && hits[1] && entries[1] < entries[0] ? 1 : 0;
+		for (int c : { 1 - nearer, nearer })
+			if (hits[c])
+				stack[top++] = { children[c], entries[c] };
+	}
+	if (found)
+		distance = best;
+	return found;
+}
+
+void Bvh::clear()
+{
+	nodes.clear();
+	order.clear();
+	boxes.clear();
+	dirty = false;
+}
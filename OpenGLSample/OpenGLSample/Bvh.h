@@ -0,0 +1,57 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "FrustumCuller.h"
+
+struct Aabb;
+
+// Bounding volume hierarchy over a set of boxes, split by the surface area
+// heuristic with binned centroids. Nodes are stored depth first in one array:
+// an interior node's left child directly follows it and only the right child's
+// index is kept, so a node is 32 bytes and a traversal mostly walks forwards.
+// Every subtree's objects are contiguous in the object order, so a node that is
+// entirely inside a query hands over all of its objects without testing them.
+struct BvhNode
+{
+	glm::vec3 min;
+	glm::vec3 max;
+	uint32_t index;    // leaf: first entry in the object order; interior: right child
+	uint32_t count;    // objects in a leaf, 0 for interior nodes
+};
+
+class Bvh
+{
+public:
+	void build(const Aabb* boxes, size_t count);
+
+	// move one object; refit() then grows or shrinks every node above it
+	void setBounds(uint32_t object, const Aabb& box);
+	// recompute all node bounds bottom up, keeping the tree's shape. Cheap enough
+	// per frame for a few moving objects; rebuild once they have drifted far.
+	void refit();
+
+	// objects whose boxes touch the frustum, in ascending order
+	void cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+	// objects whose boxes overlap box, in ascending order
+	void overlap(const Aabb& box, std::vector<uint32_t>& objects) const;
+	// nearest object box hit by the ray within maxDistance; false if none.
+	// direction need not be normalized, distance is in its units
+	bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t& object, float& distance) const;
+
+	size_t size() const { return boxes.size(); }
+	size_t nodeCount() const { return nodes.size(); }
+	const BvhNode& root() const { return nodes[0]; }
+
+	void clear();
+
+private:
+	uint32_t buildNode(uint32_t first, uint32_t count, int depth, std::vector<glm::vec3>& centroids);
+	void addSubtree(uint32_t node, std::vector<uint32_t>& objects) const;
+
+	std::vector<BvhNode> nodes;
+	std::vector<uint32_t> order;        // object indices, grouped by leaf
+	std::vector<Aabb> boxes;            // per object, in object index order
+	bool dirty = false;
+};
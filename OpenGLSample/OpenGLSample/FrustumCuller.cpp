@@ -0,0 +1,347 @@
+#include "FrustumCuller.h"
+#include "Scene.h"
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define FRUSTUM_CULLER_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and clang only emit AVX instructions inside functions marked for them;
+// MSVC accepts the intrinsics anywhere
+#if defined(__GNUC__)
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#else
+#define AVX2_FUNCTION
+#endif
+
+namespace
+{
+	const size_t LANES = 8;
+	const float LEVELS = 65535.0f;
+
+	glm::vec4 row(const glm::mat4& m, int i)
+	{
+		return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+	}
+
+	// center-extent test against one plane: the box is behind it when even its
+	// corner furthest along the normal is
+	inline bool behind(const glm::vec4& plane, const glm::vec3& center, const glm::vec3& extent)
+	{
+		float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+		float radius = std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y + std::fabs(plane.z) * extent.z;
+		return distance + radius < 0.0f;
+	}
+
+	// A plane rewritten for quantized corners. With s = qmin + qmax and
+	// d = qmax - qmin, the center is rangeMin + s * step / 2 and the extent
+	// d * step / 2, so the test becomes n . s + w + |n| . d < 0 with n and w
+	// scaled and shifted once per frame instead of once per box.
+	struct QuantizedPlane
+	{
+		float x, y, z, w;
+		float ax, ay, az;
+	};
+
+	struct CullInput
+	{
+		const uint16_t* minX;
+		const uint16_t* minY;
+		const uint16_t* minZ;
+		const uint16_t* maxX;
+		const uint16_t* maxY;
+		const uint16_t* maxZ;
+		size_t count;
+		QuantizedPlane planes[6];
+	};
+
+	// lanes of the last block that hold real boxes
+	inline unsigned int validLanes(size_t i, size_t count, unsigned int full)
+	{
+		size_t left = count - i;
+		return left >= LANES ? full : full & ((1u << left) - 1);
+	}
+
+#ifdef FRUSTUM_CULLER_SIMD
+	inline unsigned int lowestBit(unsigned int mask)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return index;
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+	bool cpuHasAvx2()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+		if (!osSavesYmm || (info[2] & (1 << 28)) == 0)
+			return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__)
+		return __builtin_cpu_supports("avx2");
+#else
+		return false;
+#endif
+	}
+
+	inline void appendVisible(unsigned int mask, size_t first, std::vector<uint32_t>& visible)
+	{
+		while (mask != 0)
+		{
+			visible.push_back((uint32_t)(first + lowestBit(mask)));
+			mask &= mask - 1;
+		}
+	}
+
+	// four 16-bit values widened to floats with SSE2 only
+	inline void loadSumDifference(const uint16_t* minimum, const uint16_t* maximum, __m128& sum, __m128& difference)
+	{
+		__m128i zero = _mm_setzero_si128();
+		__m128i lo = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)minimum), zero);
+		__m128i hi = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)maximum), zero);
+		sum = _mm_cvtepi32_ps(_mm_add_epi32(lo, hi));
+		difference = _mm_cvtepi32_ps(_mm_sub_epi32(hi, lo));
+	}
+
+	void cullSse(const CullInput& in, std::vector<uint32_t>& visible)
+	{
+		for (size_t i = 0; i < in.count; i += 4)
+		{
+			__m128 sx, sy, sz, dx, dy, dz;
+			loadSumDifference(in.minX + i, in.maxX + i, sx, dx);
+			loadSumDifference(in.minY + i, in.maxY + i, sy, dy);
+			loadSumDifference(in.minZ + i, in.maxZ + i, sz, dz);
+			__m128 outside = _mm_setzero_ps();
+			for (const QuantizedPlane& plane : in.planes)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), sx), _mm_mul_ps(_mm_set1_ps(plane.y), sy)),
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), sz), _mm_set1_ps(plane.w)));
+				__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.ax), dx), _mm_mul_ps(_mm_set1_ps(plane.ay), dy)),
+					_mm_mul_ps(_mm_set1_ps(plane.az), dz));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+			}
+			unsigned int mask = ~(unsigned int)_mm_movemask_ps(outside) & validLanes(i, in.count, 0xF);
+			appendVisible(mask, i, visible);
+		}
+	}
+
+	AVX2_FUNCTION inline void loadSumDifference(const uint16_t* minimum, const uint16_t* maximum, __m256& sum, __m256& difference)
+	{
+		__m256i lo = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)minimum));
+		__m256i hi = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)maximum));
+		sum = _mm256_cvtepi32_ps(_mm256_add_epi32(lo, hi));
+		difference = _mm256_cvtepi32_ps(_mm256_sub_epi32(hi, lo));
+	}
+
+	AVX2_FUNCTION void cullAvx2(const CullInput& in, std::vector<uint32_t>& visible)
+	{
+		__m256 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+		for (int p = 0; p < 6; p++)
+		{
+			px[p] = _mm256_set1_ps(in.planes[p].x);
+			py[p] = _mm256_set1_ps(in.planes[p].y);
+			pz[p] = _mm256_set1_ps(in.planes[p].z);
+			pw[p] = _mm256_set1_ps(in.planes[p].w);
+			ax[p] = _mm256_set1_ps(in.planes[p].ax);
+			ay[p] = _mm256_set1_ps(in.planes[p].ay);
+			az[p] = _mm256_set1_ps(in.planes[p].az);
+		}
+		for (size_t i = 0; i < in.count; i += 8)
+		{
+			__m256 sx, sy, sz, dx, dy, dz;
+			loadSumDifference(in.minX + i, in.maxX + i, sx, dx);
+			loadSumDifference(in.minY + i, in.maxY + i, sy, dy);
+			loadSumDifference(in.minZ + i, in.maxZ + i, sz, dz);
+			__m256 outside = _mm256_setzero_ps();
+			for (int p = 0; p < 6; p++)
+			{
+				__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px[p], sx), _mm256_mul_ps(py[p], sy)),
+					_mm256_add_ps(_mm256_mul_ps(pz[p], sz), pw[p]));
+				__m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[p], dx), _mm256_mul_ps(ay[p], dy)),
+					_mm256_mul_ps(az[p], dz));
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+			}
+			unsigned int mask = ~(unsigned int)_mm256_movemask_ps(outside) & validLanes(i, in.count, 0xFF);
+			appendVisible(mask, i, visible);
+		}
+	}
+#endif
+}
+
+// Gribb and Hartmann: with r0..r3 the rows of the matrix, a clip-space point is
+// inside when -w <= x, y, z <= w, i.e. (r3 +/- rk) . p >= 0.
+Frustum Frustum::fromViewProjection(const glm::mat4& m)
+{
+	Frustum frustum;
+	glm::vec4 r3 = row(m, 3);
+	for (int k = 0; k < 3; k++)
+	{
+		frustum.planes[k * 2] = r3 + row(m, k);
+		frustum.planes[k * 2 + 1] = r3 - row(m, k);
+	}
+	return frustum;
+}
+
+Frustum Frustum::expanded(float distance) const
+{
+	Frustum frustum;
+	for (int p = 0; p < 6; p++)
+	{
+		glm::vec4 plane = planes[p] / glm::length(glm::vec3(planes[p]));
+		plane.w += distance;
+		frustum.planes[p] = plane;
+	}
+	return frustum;
+}
+
+bool Frustum::intersects(const Aabb& box) const
+{
+	for (const glm::vec4& plane : planes)
+		if (behind(plane, box.center(), box.extent()))
+			return false;
+	return true;
+}
+
+void FrustumCuller::resize(size_t count)
+{
+	Aabb empty = { glm::vec3(0.0f), glm::vec3(0.0f) };
+	boxes.resize(count, empty);
+	size_t padded = (count + LANES - 1) / LANES * LANES;
+	for (std::vector<uint16_t>* array : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+		array->resize(padded, 0);
+}
+
+void FrustumCuller::setRange(const glm::vec3& min, const glm::vec3& max)
+{
+	// a little slack so boxes on the edge still round outwards
+	glm::vec3 margin = (max - min) * 0.001f + glm::vec3(0.001f);
+	rangeMin = min - margin;
+	rangeMax = max + margin;
+	step = (rangeMax - rangeMin) / LEVELS;
+	for (size_t i = 0; i < boxes.size(); i++)
+		quantize(i);
+}
+
+void FrustumCuller::quantize(size_t i)
+{
+	glm::vec3 lo = (boxes[i].min - rangeMin) / step;
+	glm::vec3 hi = (boxes[i].max - rangeMin) / step;
+	uint16_t* minimum[3] = { &minX[i], &minY[i], &minZ[i] };
+	uint16_t* maximum[3] = { &maxX[i], &maxY[i], &maxZ[i] };
+	for (int axis = 0; axis < 3; axis++)
+	{
+		// one extra step each way covers the float rounding on both sides
+		*minimum[axis] = (uint16_t)glm::clamp(std::floor(lo[axis]) - 1.0f, 0.0f, LEVELS);
+		*maximum[axis] = (uint16_t)glm::clamp(std::ceil(hi[axis]) + 1.0f, 0.0f, LEVELS);
+	}
+}
+
+void FrustumCuller::setBounds(size_t i, const Aabb& box)
+{
+	boxes[i] = box;
+	bool inside = box.min.x >= rangeMin.x && box.min.y >= rangeMin.y && box.min.z >= rangeMin.z
+		&& box.max.x <= rangeMax.x && box.max.y <= rangeMax.y && box.max.z <= rangeMax.z;
+	if (inside)
+	{
+		quantize(i);
+		return;
+	}
+	// grow by a quarter on top so an object drifting outwards does not
+	// requantize every frame
+	glm::vec3 min = glm::min(rangeMin, box.min);
+	glm::vec3 max = glm::max(rangeMax, box.max);
+	glm::vec3 growth = (max - min) * 0.25f;
+	setRange(min - growth, max + growth);
+}
+
+void FrustumCuller::setBounds(const Aabb* newBoxes, size_t count)
+{
+	resize(0);
+	resize(count);
+	if (count == 0)
+		return;
+	glm::vec3 min = newBoxes[0].min, max = newBoxes[0].max;
+	for (size_t i = 0; i < count; i++)
+	{
+		boxes[i] = newBoxes[i];
+		min = glm::min(min, newBoxes[i].min);
+		max = glm::max(max, newBoxes[i].max);
+	}
+	setRange(min, max);
+}
+
+void FrustumCuller::cull(const Frustum& frustum, std::vector<uint32_t>& visible, Path path) const
+{
+	visible.clear();
+	visible.reserve(boxes.size());
+	CullInput in = {};
+	in.minX = minX.data();
+	in.minY = minY.data();
+	in.minZ = minZ.data();
+	in.maxX = maxX.data();
+	in.maxY = maxY.data();
+	in.maxZ = maxZ.data();
+	in.count = boxes.size();
+	for (int p = 0; p < 6; p++)
+	{
+		const glm::vec4& plane = frustum.planes[p];
+		glm::vec3 n = glm::vec3(plane) * step * 0.5f;
+		in.planes[p] = { n.x, n.y, n.z, plane.w + glm::dot(glm::vec3(plane), rangeMin), std::fabs(n.x), std::fabs(n.y), std::fabs(n.z) };
+	}
+#ifdef FRUSTUM_CULLER_SIMD
+	if (path == AVX2)
+	{
+		cullAvx2(in, visible);
+		return;
+	}
+	if (path == SSE)
+	{
+		cullSse(in, visible);
+		return;
+	}
+#endif
+	for (size_t i = 0; i < in.count; i++)
+	{
+		glm::vec3 sum((float)(minX[i] + maxX[i]), (float)(minY[i] + maxY[i]), (float)(minZ[i] + maxZ[i]));
+		glm::vec3 difference((float)(maxX[i] - minX[i]), (float)(maxY[i] - minY[i]), (float)(maxZ[i] - minZ[i]));
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+		{
+			const QuantizedPlane& plane = in.planes[p];
+			float distance = plane.x * sum.x + plane.y * sum.y + plane.z * sum.z + plane.w;
+			float radius = plane.ax * difference.x + plane.ay * difference.y + plane.az * difference.z;
+			outside = distance + radius < 0.0f;
+		}
+		if (!outside)
+			visible.push_back((uint32_t)i);
+	}
+}
+
+FrustumCuller::Path FrustumCuller::bestPath()
+{
+#ifdef FRUSTUM_CULLER_SIMD
+	static const Path best = cpuHasAvx2() ? AVX2 : SSE;
+	return best;
+#else
+	return SCALAR;
+#endif
+}
+
+const char* FrustumCuller::pathName(Path path)
+{
+	return path == AVX2 ? "AVX2" : path == SSE ? "SSE2" : "scalar";
+}
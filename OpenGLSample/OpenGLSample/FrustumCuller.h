@@ -0,0 +1,61 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+struct Aabb;
+
+// The six planes of a view frustum, pointing inwards: a point p is inside when
+// dot(plane.xyz, p) + plane.w >= 0 for all of them.
+struct Frustum
+{
+	glm::vec4 planes[6];   // left, right, bottom, top, near, far
+
+	// planes of projection * view, read off the rows of the matrix
+	static Frustum fromViewProjection(const glm::mat4& viewProjection);
+
+	// the same frustum with every plane moved outwards by distance world units
+	Frustum expanded(float distance) const;
+
+	// one box at a time, for the odd object outside a culler
+	bool intersects(const Aabb& box) const;
+};
+
+// World-space boxes in separate arrays per axis, so the frustum test runs on
+// eight boxes per instruction with AVX2, four with SSE2, and one at a time
+// otherwise. The fastest path the CPU supports is picked at run time.
+//
+// The test is memory bound, so the box corners are stored as 16-bit steps across
+// the range of all boxes (12 bytes a box instead of 24), rounded outwards. Like
+// the plane test itself this only ever keeps a box that could be culled, never
+// the other way round. A box moved outside the range widens it and requantizes.
+class FrustumCuller
+{
+public:
+	enum Path { SCALAR, SSE, AVX2 };
+
+	void resize(size_t count);
+	void setBounds(size_t i, const Aabb& box);
+	void setBounds(const Aabb* boxes, size_t count);
+	size_t size() const { return boxes.size(); }
+
+	// indices of the boxes in or touching the frustum, in ascending order
+	void cull(const Frustum& frustum, std::vector<uint32_t>& visible) const { cull(frustum, visible, bestPath()); }
+	void cull(const Frustum& frustum, std::vector<uint32_t>& visible, Path path) const;
+
+	static Path bestPath();
+	static const char* pathName(Path path);
+
+private:
+	void setRange(const glm::vec3& min, const glm::vec3& max);
+	void quantize(size_t i);
+
+	std::vector<Aabb> boxes;    // full precision, read only to requantize
+
+	// quantized corners, padded to a multiple of 8
+	std::vector<uint16_t> minX, minY, minZ;
+	std::vector<uint16_t> maxX, maxY, maxZ;
+	glm::vec3 rangeMin = glm::vec3(0.0f);
+	glm::vec3 rangeMax = glm::vec3(0.0f);
+	glm::vec3 step = glm::vec3(1.0f);     // world units per quantization step
+};
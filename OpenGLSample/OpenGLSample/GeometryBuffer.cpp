@@ -0,0 +1,156 @@
+#include "GeometryBuffer.h"
+#include "ShapeGenerator.h"
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+	const Uniform<int> OCTAHEDRAL_NORMALS_UNIFORM("octahedralNormals");
+
+	CompactVertex compress(const Vertex& vertex, const PositionQuantization& quantization)
+	{
+		CompactVertex packed;
+		quantization.encode(vertex.position, packed.position);
+		glm::vec2 normal = VertexFormat::encodeOctahedral(vertex.normal);
+		packed.normal[0] = VertexFormat::packSnorm16(normal.x);
+		packed.normal[1] = VertexFormat::packSnorm16(normal.y);
+		packed.texCoord[0] = VertexFormat::packHalf(vertex.texCoord.x);
+		packed.texCoord[1] = VertexFormat::packHalf(vertex.texCoord.y);
+		packed.color[0] = VertexFormat::packUnorm8(vertex.color.x);
+		packed.color[1] = VertexFormat::packUnorm8(vertex.color.y);
+		packed.color[2] = VertexFormat::packUnorm8(vertex.color.z);
+		packed.color[3] = 255;
+		return packed;
+	}
+}
+
+GeometryBuffer::GeometryBuffer(Layout layout) :
+	vertexLayout(layout), indexCount(0), vertexArray(0), vertexBuffer(0), indexBuffer(0)
+{
+}
+
+MeshDraw GeometryBuffer::add(const ShapeData& shape)
+{
+	// the VAO name is handed out now so the draw can refer to it before upload()
+	if (vertexArray == 0)
+		glGenVertexArrays(1, &vertexArray);
+
+	GLint baseVertex = (GLint)numVertices();
+	GLenum indexType = shape.indexType();
+	size_t offset = indexData.size();
+	if (indexType == GL_UNSIGNED_SHORT)
+	{
+		indexData.resize(offset + shape.numIndices * sizeof(GLushort));
+		GLushort* shortIndices = (GLushort*)(indexData.data() + offset);
+		for (GLuint i = 0; i < shape.numIndices; i++)
+			shortIndices[i] = (GLushort)shape.indices[i];
+	}
+	else
+	{
+		offset = (offset + sizeof(GLuint) - 1) / sizeof(GLuint) * sizeof(GLuint);
+		indexData.resize(offset + shape.numIndices * sizeof(GLuint));
+		std::memcpy(indexData.data() + offset, shape.indices, shape.numIndices * sizeof(GLuint));
+	}
+	indexCount += shape.numIndices;
+	MeshDraw mesh = MeshDraw::elements(vertexArray, shape.numIndices, indexType, (void*)offset, baseVertex);
+	if (vertexLayout == FLOAT_VERTICES)
+	{
+		vertices.insert(vertices.end(), shape.vertices, shape.vertices + shape.numVertices);
+		return mesh;
+	}
+
+	glm::vec3 min(0.0f), max(0.0f);
+	if (shape.numVertices > 0)
+		min = max = shape.vertices[0].position;
+	for (GLuint i = 1; i < shape.numVertices; i++)
+	{
+		min = glm::min(min, shape.vertices[i].position);
+		max = glm::max(max, shape.vertices[i].position);
+	}
+	PositionQuantization quantization = PositionQuantization::fromBounds(min, max);
+	for (GLuint i = 0; i < shape.numVertices; i++)
+		compactVertices.push_back(compress(shape.vertices[i], quantization));
+	mesh.positionScale = quantization.scale;
+	mesh.positionOffset = quantization.offset;
+	return mesh;
+}
+
+std::vector<MeshDraw> GeometryBuffer::addSplit(const ShapeData& shape)
+{
+	if (shape.indexType() == GL_UNSIGNED_SHORT)
+		return std::vector<MeshDraw>(1, add(shape));
+	std::vector<MeshDraw> draws;
+	for (ShapeData& piece : ShapeGenerator::split(shape))
+	{
+		draws.push_back(add(piece));
+		piece.cleanup();
+	}
+	return draws;
+}
+
+void GeometryBuffer::upload()
+{
+	if (vertexArray == 0)
+		glGenVertexArrays(1, &vertexArray);
+	if (vertexBuffer == 0)
+		glGenBuffers(1, &vertexBuffer);
+	if (indexBuffer == 0)
+		glGenBuffers(1, &indexBuffer);
+
+	glBindVertexArray(vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	const void* vertexData = vertexLayout == COMPACT_VERTICES ? (const void*)compactVertices.data() : (const void*)vertices.data();
+	glBufferData(GL_ARRAY_BUFFER, vertexBufferSize(), vertexData, GL_STATIC_DRAW);
+	// the element buffer binding is part of the VAO state
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexData.size(), indexData.data(), GL_STATIC_DRAW);
+
+	glEnableVertexAttribArray(POSITION_LOCATION);
+	glEnableVertexAttribArray(NORMAL_LOCATION);
+	glEnableVertexAttribArray(TEXCOORD_LOCATION);
+	if (vertexLayout == COMPACT_VERTICES)
+	{
+		// positions and normals come out of the normalized integers in [0, 1] and
+		// [-1, 1]; the normal's missing z reads as 0 and is rebuilt in the shader
+		glVertexAttribPointer(POSITION_LOCATION, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, position));
+		glVertexAttribPointer(NORMAL_LOCATION, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, normal));
+		glVertexAttribPointer(TEXCOORD_LOCATION, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, texCoord));
+	}
+	else
+	{
+		glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+		glVertexAttribPointer(NORMAL_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+		glVertexAttribPointer(TEXCOORD_LOCATION, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
+	}
+	glBindVertexArray(0);
+}
+
+GLsizeiptr GeometryBuffer::vertexBufferSize() const
+{
+	if (vertexLayout == COMPACT_VERTICES)
+		return compactVertices.size() * sizeof(CompactVertex);
+	return vertices.size() * sizeof(Vertex);
+}
+
+void GeometryBuffer::configure(Shader& shader) const
+{
+	shader.use();
+	shader.set(OCTAHEDRAL_NORMALS_UNIFORM, vertexLayout == COMPACT_VERTICES ? 1 : 0);
+}
+
+void GeometryBuffer::cleanup()
+{
+	glDeleteVertexArrays(1, &vertexArray);
+	glDeleteBuffers(1, &vertexBuffer);
+	glDeleteBuffers(1, &indexBuffer);
+	vertexArray = vertexBuffer = indexBuffer = 0;
+	vertices.clear();
+	compactVertices.clear();
+	indexData.clear();
+	indexCount = 0;
+}
+
+bool GeometryBuffer::multiDrawIndirect()
+{
+	return GLAD_GL_VERSION_4_3 && glMultiDrawElementsIndirect != nullptr;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <glad/glad.h>
+#include <vector>
+
+#include "ShapeData.h"
+#include "Vertex.h"
+#include "VertexFormat.h"
+#include "shader.h"
+
+// The geometry part of a draw call: which VAO and which vertices or indices.
+struct MeshDraw
+{
+	GLuint vao;
+	bool indexed;
+	GLint first;           // first vertex, for glDrawArrays
+	GLsizei count;         // vertex or index count
+	GLenum indexType;
+	const void* indices;   // byte offset into the element buffer
+	GLint baseVertex;      // added to every index, for shapes sharing one buffer
+	// undoes the quantization of a compact buffer's positions; identity otherwise
+	glm::vec3 positionScale = glm::vec3(1.0f);
+	glm::vec3 positionOffset = glm::vec3(0.0f);
+
+	static MeshDraw arrays(GLuint vao, GLint first, GLsizei count)
+	{
+		MeshDraw mesh = { vao, false, first, count, 0, nullptr, 0 };
+		return mesh;
+	}
+	static MeshDraw elements(GLuint vao, GLsizei count, GLenum indexType, const void* indices, GLint baseVertex = 0)
+	{
+		MeshDraw mesh = { vao, true, 0, count, indexType, indices, baseVertex };
+		return mesh;
+	}
+
+	// goes before the model matrix of anything drawn with this shape
+	glm::mat4 positionTransform() const
+	{
+		glm::mat4 transform(1.0f);
+		transform[0][0] = positionScale.x;
+		transform[1][1] = positionScale.y;
+		transform[2][2] = positionScale.z;
+		transform[3] = glm::vec4(positionOffset, 1.0f);
+		return transform;
+	}
+};
+
+// One vertex buffer and one index buffer that every shape is copied into. Each
+// ShapeData keeps its own indices and is drawn with a base vertex, so one VAO
+// describes all of them and switching shapes needs no VAO or buffer bind. The
+// indices are 16-bit for shapes of up to 65536 vertices and 32-bit beyond that,
+// both kinds sharing the one element buffer.
+//
+// The vertices are stored either as Vertex or as CompactVertex. In the compact
+// layout each shape's positions are quantized in its own box, whose transform is
+// handed out with its MeshDraw; a whole multi-draw can then mix shapes, since the
+// box travels with each object's model matrix rather than with the draw.
+class GeometryBuffer
+{
+public:
+	enum Layout { FLOAT_VERTICES, COMPACT_VERTICES };
+
+	static const GLuint POSITION_LOCATION = 0;
+	static const GLuint NORMAL_LOCATION = 1;
+	static const GLuint TEXCOORD_LOCATION = 2;
+
+	explicit GeometryBuffer(Layout layout = FLOAT_VERTICES);
+
+	// append a shape; the returned draw can be used once upload() has been called
+	MeshDraw add(const ShapeData& shape);
+	// append a shape as pieces that all take 16-bit indices, one draw per piece;
+	// a shape that already fits comes back as a single draw. Half the index
+	// bandwidth of add() for large shapes, at the cost of more draws.
+	std::vector<MeshDraw> addSplit(const ShapeData& shape);
+	// copy everything added so far to the GPU in one go
+	void upload();
+
+	GLuint vao() const { return vertexArray; }
+	Layout layout() const { return vertexLayout; }
+	GLuint numVertices() const { return vertexLayout == COMPACT_VERTICES ? (GLuint)compactVertices.size() : (GLuint)vertices.size(); }
+	GLuint numIndices() const { return indexCount; }
+	GLsizeiptr vertexBufferSize() const;
+	GLsizeiptr indexBufferSize() const { return (GLsizeiptr)indexData.size(); }
+
+	// tells a program that reads normals how this buffer stores them; call once
+	// per program before drawing
+	void configure(Shader& shader) const;
+
+	void cleanup();
+
+	// glMultiDrawElementsIndirect with base instances needs GL 4.3 (or
+	// ARB_multi_draw_indirect, which glad was not generated with)
+	static bool multiDrawIndirect();
+
+private:
+	Layout vertexLayout;
+	std::vector<Vertex> vertices;
+	std::vector<CompactVertex> compactVertices;
+	std::vector<GLubyte> indexData;    // 16- and 32-bit runs, each aligned to its size
+	GLuint indexCount;
+	GLuint vertexArray, vertexBuffer, indexBuffer;
+};
@@ -0,0 +1,227 @@
+#include "InstanceBatch.h"
+#include "RenderStats.h"
+#include "NormalMatrix.h"
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+
+namespace
+{
+	GLuint indexSize(GLenum type)
+	{
+		return type == GL_UNSIGNED_INT ? 4 : type == GL_UNSIGNED_SHORT ? 2 : 1;
+	}
+
+	bool sameShape(const MeshDraw& a, const MeshDraw& b)
+	{
+		return a.indices == b.indices && a.baseVertex == b.baseVertex && a.count == b.count;
+	}
+}
+
+InstanceBatch::InstanceBatch() :
+	instanceVBO(0), normalVBO(0), indirectBuffer(0), uploadedCount(0), boundsCenter(0.0f)
+{
+}
+
+void InstanceBatch::add(const glm::mat4& model)
+{
+	transforms.push_back(model);
+}
+
+void InstanceBatch::add(const MeshDraw& mesh, const glm::mat4& model)
+{
+	meshes.push_back(mesh);
+	transforms.push_back(model);
+}
+
+void InstanceBatch::clear()
+{
+	transforms.clear();
+	meshes.clear();
+	commands.clear();
+	ranges.clear();
+}
+
+// Sorts the instances so each shape's matrices are contiguous and writes one
+// indirect command per shape pointing at that range. Shapes are ordered by index
+// type first so each type's commands form one range.
+void InstanceBatch::buildCommands()
+{
+	commands.clear();
+	ranges.clear();
+	if (meshes.empty())
+		return;
+
+	std::vector<size_t> order(meshes.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+		if (meshes[a].indexType != meshes[b].indexType)
+			return meshes[a].indexType < meshes[b].indexType;
+		if (meshes[a].indices != meshes[b].indices)
+			return (uintptr_t)meshes[a].indices < (uintptr_t)meshes[b].indices;
+		return meshes[a].baseVertex < meshes[b].baseVertex;
+	});
+	std::vector<glm::mat4> sortedTransforms(transforms.size());
+	std::vector<MeshDraw> sortedMeshes(meshes.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		sortedTransforms[i] = transforms[order[i]];
+		sortedMeshes[i] = meshes[order[i]];
+	}
+	transforms.swap(sortedTransforms);
+	meshes.swap(sortedMeshes);
+
+	for (GLuint i = 0; i < (GLuint)meshes.size(); i++)
+	{
+		const MeshDraw& mesh = meshes[i];
+		if (!commands.empty() && sameShape(mesh, meshes[i - 1]))
+		{
+			commands.back().instanceCount++;
+			continue;
+		}
+		if (ranges.empty() || ranges.back().indexType != mesh.indexType)
+		{
+			CommandRange range = { mesh.indexType, (GLsizei)commands.size(), 0 };
+			ranges.push_back(range);
+		}
+		ranges.back().count++;
+		DrawCommand command = { (GLuint)mesh.count, 1,
+			(GLuint)((uintptr_t)mesh.indices / indexSize(mesh.indexType)), mesh.baseVertex, i };
+		commands.push_back(command);
+	}
+}
+
+void InstanceBatch::upload()
+{
+	buildCommands();
+	// each shape's position box goes in front of its model matrices, so shapes
+	// quantized in different boxes still share one draw
+	std::vector<glm::mat4> models(transforms);
+	for (size_t i = 0; i < meshes.size(); i++)
+		models[i] = transforms[i] * meshes[i].positionTransform();
+	if (instanceVBO == 0)
+		glGenBuffers(1, &instanceVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, models.size() * sizeof(glm::mat4), models.data(), GL_STATIC_DRAW);
+	uploadedCount = (GLsizei)transforms.size();
+
+	std::vector<glm::mat3> normals(transforms.size());
+	computeNormalMatrices(transforms.data(), normals.data(), normals.size());
+	if (normalVBO == 0)
+		glGenBuffers(1, &normalVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, normalVBO);
+	glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::mat3), normals.data(), GL_STATIC_DRAW);
+
+	if (!commands.empty() && GeometryBuffer::multiDrawIndirect())
+	{
+		if (indirectBuffer == 0)
+			glGenBuffers(1, &indirectBuffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand), commands.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	boundsCenter = glm::vec3(0.0f);
+	for (const glm::mat4& model : transforms)
+		boundsCenter += glm::vec3(model[3]);
+	if (!transforms.empty())
+		boundsCenter /= (float)transforms.size();
+}
+
+// The shape VAOs are shared by several batches, so the instance attribute is
+// pointed at this batch's buffer right before each draw instead of being baked
+// into the VAO. firstInstance offsets the pointer, which stands in for a base
+// instance on drivers without one.
+void InstanceBatch::bindInstanceAttributes(GLuint firstInstance) const
+{
+	bindModelAttribute(instanceVBO, sizeof(glm::mat4) * firstInstance);
+	glBindBuffer(GL_ARRAY_BUFFER, normalVBO);
+	for (GLuint column = 0; column < 3; column++)
+	{
+		GLuint location = NORMAL_MATRIX_LOCATION + column;
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(glm::mat3),
+			(void*)(sizeof(glm::mat3) * firstInstance + sizeof(glm::vec3) * column));
+		glVertexAttribDivisor(location, 1);
+	}
+}
+
+void InstanceBatch::bindModelAttribute(GLuint buffer, GLintptr offset)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	for (GLuint column = 0; column < 4; column++)
+	{
+		GLuint location = MODEL_LOCATION + column;
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+			(void*)(offset + sizeof(glm::vec4) * column));
+		glVertexAttribDivisor(location, 1);
+	}
+}
+
+void InstanceBatch::drawArrays(GLenum mode, GLint first, GLsizei count) const
+{
+	if (uploadedCount == 0)
+		return;
+	bindInstanceAttributes();
+	glDrawArraysInstanced(mode, first, count, uploadedCount);
+	renderStats().drawCalls++;
+	renderStats().instances += uploadedCount;
+	renderStats().triangles += count / 3 * uploadedCount;
+}
+
+void InstanceBatch::drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices, GLint baseVertex) const
+{
+	if (uploadedCount == 0)
+		return;
+	bindInstanceAttributes();
+	glDrawElementsInstancedBaseVertex(mode, count, type, indices, uploadedCount, baseVertex);
+	renderStats().drawCalls++;
+	renderStats().instances += uploadedCount;
+	renderStats().triangles += count / 3 * uploadedCount;
+}
+
+void InstanceBatch::drawMulti(GLenum mode) const
+{
+	if (uploadedCount == 0 || commands.empty())
+		return;
+	if (indirectBuffer != 0)
+	{
+		bindInstanceAttributes();
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		for (const CommandRange& range : ranges)
+		{
+			glMultiDrawElementsIndirect(mode, range.indexType, (void*)(range.first * sizeof(DrawCommand)), range.count, 0);
+			renderStats().drawCalls++;
+		}
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+	else
+	{
+		for (const CommandRange& range : ranges)
+		{
+			GLuint size = indexSize(range.indexType);
+			for (GLsizei c = range.first; c < range.first + range.count; c++)
+			{
+				const DrawCommand& command = commands[c];
+				bindInstanceAttributes(command.baseInstance);
+				glDrawElementsInstancedBaseVertex(mode, command.count, range.indexType, (void*)((uintptr_t)command.firstIndex * size),
+					command.instanceCount, command.baseVertex);
+				renderStats().drawCalls++;
+			}
+		}
+	}
+	renderStats().instances += uploadedCount;
+	for (const DrawCommand& command : commands)
+		renderStats().triangles += command.count / 3 * command.instanceCount;
+}
+
+void InstanceBatch::cleanup()
+{
+	glDeleteBuffers(1, &instanceVBO);
+	glDeleteBuffers(1, &normalVBO);
+	glDeleteBuffers(1, &indirectBuffer);
+	instanceVBO = normalVBO = indirectBuffer = 0;
+	uploadedCount = 0;
+	clear();
+}
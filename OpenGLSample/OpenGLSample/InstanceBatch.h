@@ -0,0 +1,84 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "GeometryBuffer.h"
+
+// A list of model matrices for one shape type. The matrices live in their own
+// buffer and are fed to the vertex shader as a per-instance attribute, so the
+// whole list is drawn with a single instanced draw call.
+//
+// A batch can also hold instances of several shapes from one GeometryBuffer. The
+// instances are grouped by shape on upload() and drawMulti() sends the groups as
+// one glMultiDrawElementsIndirect, each group picking its matrices by base instance.
+// Shapes with 16-bit and 32-bit indices take one multi-draw per index type.
+class InstanceBatch
+{
+public:
+	// a mat4 attribute takes four consecutive locations (3, 4, 5 and 6)
+	static const GLuint MODEL_LOCATION = 3;
+	// the matching normal matrix, a mat3 at 7, 8 and 9, computed on upload()
+	static const GLuint NORMAL_MATRIX_LOCATION = 7;
+
+	InstanceBatch();
+
+	// an instance of the shape passed to drawArrays()/drawElements(); the matrix is
+	// used as given, so a compact shape's positionTransform() must already be in it
+	void add(const glm::mat4& model);
+	// an instance of one of several shapes; draw the batch with drawMulti()
+	void add(const MeshDraw& mesh, const glm::mat4& model);
+	void clear();
+	GLsizei size() const { return (GLsizei)transforms.size(); }
+	// average position of the instances, used to order batches by distance
+	glm::vec3 center() const { return boundsCenter; }
+
+	// copy the transforms to the GPU; call again after add()/clear()
+	void upload();
+
+	// both draw functions expect the shape's VAO to already be bound
+	void drawArrays(GLenum mode, GLint first, GLsizei count) const;
+	void drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices, GLint baseVertex = 0) const;
+	// draws every shape of a multi-shape batch; expects the geometry VAO to be bound
+	void drawMulti(GLenum mode) const;
+	// VAO of the shapes in a multi-shape batch
+	GLuint vao() const { return meshes.empty() ? 0 : meshes[0].vao; }
+
+	void cleanup();
+
+	// points the per-instance model attribute at tightly packed matrices in any
+	// buffer, e.g. a StreamBuffer region; the target VAO must be bound
+	static void bindModelAttribute(GLuint buffer, GLintptr offset);
+
+private:
+	// same layout as DrawElementsIndirectCommand in the GL spec
+	struct DrawCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// consecutive commands sharing an index type
+	struct CommandRange
+	{
+		GLenum indexType;
+		GLsizei first;
+		GLsizei count;
+	};
+
+	void bindInstanceAttributes(GLuint firstInstance = 0) const;
+	void buildCommands();
+
+	std::vector<glm::mat4> transforms;
+	std::vector<MeshDraw> meshes;   // one per transform, multi-shape batches only
+	std::vector<DrawCommand> commands;
+	std::vector<CommandRange> ranges;
+	GLuint instanceVBO;
+	GLuint normalVBO;
+	GLuint indirectBuffer;
+	GLsizei uploadedCount;
+	glm::vec3 boundsCenter;
+};
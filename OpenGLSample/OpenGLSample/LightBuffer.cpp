@@ -0,0 +1,129 @@
+#include "LightBuffer.h"
+#include "RenderStats.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+LightBuffer::LightBuffer() :
+	block(sizeof(Header) + MAX_POINT_LIGHTS * sizeof(PointLight), 0), ubo(0)
+{
+}
+
+void LightBuffer::create()
+{
+	glGenBuffers(1, &ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+	glBufferData(GL_UNIFORM_BUFFER, block.size(), block.data(), GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo);
+	dirtyRanges.clear();
+}
+
+void LightBuffer::bindTo(const Shader& shader) const
+{
+	GLuint index = glGetUniformBlockIndex(shader.ID, "Lights");
+	if (index == GL_INVALID_INDEX)
+		return;
+	GLint size = 0;
+	glGetActiveUniformBlockiv(shader.ID, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+	if ((size_t)size != block.size())
+		std::cout << "ERROR::LIGHTS::BLOCK_SIZE_MISMATCH: shader " << size << " bytes, buffer " << block.size() << " bytes" << std::endl;
+	glUniformBlockBinding(shader.ID, index, BINDING);
+}
+
+void LightBuffer::setDirLight(const DirLight& light)
+{
+	write(offsetof(Header, dirLight), &light, sizeof(light));
+}
+
+void LightBuffer::setSpotLight(const SpotLight& light)
+{
+	write(offsetof(Header, spotLight), &light, sizeof(light));
+}
+
+int LightBuffer::addPointLight(const PointLight& light)
+{
+	int index = pointLightCount();
+	if (index >= MAX_POINT_LIGHTS)
+		return -1;
+	setPointLight(index, light);
+	GLint count = index + 1;
+	write(offsetof(Header, numPointLights), &count, sizeof(count));
+	return index;
+}
+
+void LightBuffer::setPointLight(int index, const PointLight& light)
+{
+	write(pointLightOffset(index), &light, sizeof(light));
+}
+
+// the last light is moved into the freed slot, so indices of other lights may change
+void LightBuffer::removePointLight(int index)
+{
+	GLint count = pointLightCount();
+	if (index < 0 || index >= count)
+		return;
+	count--;
+	if (index != count)
+		setPointLight(index, pointLight(count));
+	write(offsetof(Header, numPointLights), &count, sizeof(count));
+}
+
+int LightBuffer::pointLightCount() const
+{
+	return reinterpret_cast<const Header*>(block.data())->numPointLights;
+}
+
+const PointLight& LightBuffer::pointLight(int index) const
+{
+	return *reinterpret_cast<const PointLight*>(block.data() + pointLightOffset(index));
+}
+
+size_t LightBuffer::pointLightOffset(int index) const
+{
+	return sizeof(Header) + index * sizeof(PointLight);
+}
+
+// only the bytes that differ from the CPU copy are marked dirty, so setting the
+// same light every frame costs a compare and no upload
+void LightBuffer::write(size_t offset, const void* data, size_t size)
+{
+	unsigned char* dst = block.data() + offset;
+	if (memcmp(dst, data, size) == 0)
+		return;
+	memcpy(dst, data, size);
+	dirtyRanges.push_back(std::make_pair(offset, offset + size));
+}
+
+void LightBuffer::flush()
+{
+	if (dirtyRanges.empty())
+		return;
+	// merge touching or overlapping ranges so neighbouring lights go up in one call
+	std::sort(dirtyRanges.begin(), dirtyRanges.end());
+	glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+	size_t begin = dirtyRanges[0].first, end = dirtyRanges[0].second;
+	for (size_t i = 1; i <= dirtyRanges.size(); i++)
+	{
+		if (i < dirtyRanges.size() && dirtyRanges[i].first <= end)
+		{
+			end = std::max(end, dirtyRanges[i].second);
+			continue;
+		}
+		glBufferSubData(GL_UNIFORM_BUFFER, begin, end - begin, block.data() + begin);
+		renderStats().lightUploads++;
+		renderStats().lightBytesUploaded += (unsigned int)(end - begin);
+		if (i < dirtyRanges.size())
+		{
+			begin = dirtyRanges[i].first;
+			end = dirtyRanges[i].second;
+		}
+	}
+	dirtyRanges.clear();
+}
+
+void LightBuffer::cleanup()
+{
+	glDeleteBuffers(1, &ubo);
+	ubo = 0;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "shader.h"
+
+// C++ mirrors of the light structs in the "Lights" uniform block. The block uses
+// the std140 layout, where a vec3 is aligned like a vec4, so each vec3 is
+// followed by a float that either fills the gap or is padding.
+struct DirLight
+{
+	glm::vec3 direction; float pad0;
+	glm::vec3 ambient;   float pad1;
+	glm::vec3 diffuse;   float pad2;
+	glm::vec3 specular;  float pad3;
+};
+
+struct PointLight
+{
+	glm::vec3 position;  float constant;
+	glm::vec3 ambient;   float linear;
+	glm::vec3 diffuse;   float quadratic;
+	glm::vec3 specular;  float pad0;
+};
+
+struct SpotLight
+{
+	glm::vec3 position;  float cutOff;
+	glm::vec3 direction; float outerCutOff;
+	glm::vec3 ambient;   float constant;
+	glm::vec3 diffuse;   float linear;
+	glm::vec3 specular;  float quadratic;
+};
+
+static_assert(sizeof(DirLight) == 64, "DirLight does not match its std140 layout");
+static_assert(sizeof(PointLight) == 64, "PointLight does not match its std140 layout");
+static_assert(sizeof(SpotLight) == 80, "SpotLight does not match its std140 layout");
+
+// One uniform buffer holding every light in the scene, bound to the same binding
+// point for every program that declares the "Lights" block. A CPU copy of the
+// block is kept, setters only mark the bytes that actually changed, and flush()
+// sends just those ranges.
+class LightBuffer
+{
+public:
+	static const GLuint BINDING = 0;
+	// must match MAX_POINT_LIGHTS in the shaders that use the block
+	static const int MAX_POINT_LIGHTS = 128;
+
+	LightBuffer();
+
+	void create();
+	// attach a program's "Lights" block to this buffer; programs without the block are left alone
+	void bindTo(const Shader& shader) const;
+
+	void setDirLight(const DirLight& light);
+	void setSpotLight(const SpotLight& light);
+	// returns the new light's index, or -1 when the block is full
+	int addPointLight(const PointLight& light);
+	void setPointLight(int index, const PointLight& light);
+	void removePointLight(int index);
+
+	int pointLightCount() const;
+	const PointLight& pointLight(int index) const;
+
+	// upload the dirty ranges; call once per frame before drawing
+	void flush();
+	void cleanup();
+
+private:
+	struct Header
+	{
+		DirLight dirLight;
+		SpotLight spotLight;
+		GLint numPointLights; GLint pad[3];
+	};
+
+	void write(size_t offset, const void* data, size_t size);
+	size_t pointLightOffset(int index) const;
+
+	std::vector<unsigned char> block;
+	// [begin, end) byte ranges written since the last flush
+	std::vector<std::pair<size_t, size_t>> dirtyRanges;
+	GLuint ubo;
+};
@@ -0,0 +1,51 @@
+#include "Lod.h"
+#include <algorithm>
+#include <cfloat>
+
+void LodChain::addLevel(const MeshDraw& mesh, const Aabb& levelBounds, float screenSize)
+{
+	if (levelCount == MAX_LOD_LEVELS)
+		return;
+	if (levelCount == 0)
+		bounds = levelBounds;
+	levels[levelCount] = mesh;
+	minScreenSize[levelCount] = screenSize;
+	levelCount++;
+}
+
+unsigned int LodChain::select(float screenSize, unsigned int current) const
+{
+	// stay while inside the current level's range widened on both sides
+	float lower = minScreenSize[current] * (1.0f - LOD_HYSTERESIS);
+	bool finerExists = current > 0;
+	float upper = finerExists ? minScreenSize[current - 1] * (1.0f + LOD_HYSTERESIS) : 0.0f;
+	if (screenSize >= lower && (!finerExists || screenSize < upper))
+		return current;
+
+	unsigned int level = 0;
+	while (level + 1 < levelCount && screenSize < minScreenSize[level])
+		level++;
+	return level;
+}
+
+// projection[1][1] is 1 / tan(fovy / 2) for a perspective projection, so the
+// sphere covers radius * projection[1][1] / distance of the half-height. An
+// orthographic projection has no distance term.
+float LodChain::screenSize(const Aabb& worldBounds, const glm::vec3& eye, const glm::mat4& projection)
+{
+	float radius = glm::length(worldBounds.extent());
+	if (projection[3][3] == 1.0f)
+		return radius * projection[1][1];
+	float distance = std::max(glm::length(worldBounds.center() - eye), radius);
+	return radius * projection[1][1] / distance;
+}
+
+// screenSize() is the bounding sphere's diameter over the viewport height, so
+// anything of size error covers screenSize * error / diameter of that height
+float LodChain::screenSizeForError(const Aabb& bounds, float error, float pixels, float viewportHeight)
+{
+	if (error <= 0.0f)
+		return FLT_MAX;
+	float diameter = 2.0f * glm::length(bounds.extent());
+	return pixels / viewportHeight * diameter / error;
+}
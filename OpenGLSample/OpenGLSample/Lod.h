@@ -0,0 +1,37 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include "GeometryBuffer.h"
+#include "Scene.h"
+
+const unsigned int MAX_LOD_LEVELS = 4;
+// a level is kept until the screen size passes its boundary by this fraction,
+// so an object sitting on a boundary does not flip between levels every frame
+const float LOD_HYSTERESIS = 0.15f;
+
+// One shape generated at several tessellations, finest first. Each level has the
+// smallest screen size it is drawn at: the object's bounding sphere diameter as
+// a fraction of the viewport height. The last level's is 0.
+//
+// The coarser levels must fit inside the finest one's bounds, which are the
+// bounds the objects are culled with.
+struct LodChain
+{
+	MeshDraw levels[MAX_LOD_LEVELS];
+	float minScreenSize[MAX_LOD_LEVELS];
+	unsigned int levelCount = 0;
+	Aabb bounds;
+
+	void addLevel(const MeshDraw& mesh, const Aabb& levelBounds, float screenSize);
+
+	// the level for an object of the given screen size that is drawn at current
+	unsigned int select(float screenSize, unsigned int current) const;
+
+	// diameter of the box's bounding sphere over the viewport height
+	static float screenSize(const Aabb& worldBounds, const glm::vec3& eye, const glm::mat4& projection);
+	// the screen size at which a level that is off the true surface by up to
+	// error, in the units of bounds, starts to be off by more than pixels on a
+	// viewport viewportHeight pixels high: the minScreenSize of the next finer
+	// level. See MeshSimplifier for the errors of generated levels.
+	static float screenSizeForError(const Aabb& bounds, float error, float pixels, float viewportHeight);
+};
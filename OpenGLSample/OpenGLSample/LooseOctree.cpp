@@ -0,0 +1,197 @@
+#include "LooseOctree.h"
+#include "RenderStats.h"
+#include "Scene.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// first node of each level: a level has 8 times the cells of the one above
+	int levelOffset(int level)
+	{
+		return ((1 << (3 * level)) - 1) / 7;
+	}
+
+	// as in the BVH: planes the box lies fully in front of are dropped from the
+	// mask, so the cells below skip them; false if it is behind any plane
+	bool testPlanes(const Frustum& frustum, const glm::vec3& center, const glm::vec3& extent, unsigned int& mask)
+	{
+		for (int p = 0; p < 6; p++)
+		{
+			if ((mask & (1u << p)) == 0)
+				continue;
+			const glm::vec4& plane = frustum.planes[p];
+			float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+			float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+			if (distance + radius < 0.0f)
+				return false;
+			if (distance - radius >= 0.0f)
+				mask &= ~(1u << p);
+		}
+		return true;
+	}
+}
+
+void LooseOctree::create(const Aabb& bounds, size_t capacity)
+{
+	glm::vec3 size = bounds.max - bounds.min;
+	rootSize = std::max(std::max(size.x, size.y), std::max(size.z, 0.001f));
+	origin = bounds.min;
+
+	nodes.assign(levelOffset(DEPTH), Node());
+	parents.assign(nodes.size(), -1);
+	for (int level = 1; level < DEPTH; level++)
+	{
+		int n = 1 << level;
+		for (int z = 0; z < n; z++)
+			for (int y = 0; y < n; y++)
+				for (int x = 0; x < n; x++)
+					parents[nodeIndex(level, glm::ivec3(x, y, z))] = nodeIndex(level - 1, glm::ivec3(x, y, z) / 2);
+	}
+	entries.assign(capacity, Entry());
+}
+
+int32_t LooseOctree::nodeIndex(int level, const glm::ivec3& cell) const
+{
+	int n = 1 << level;
+	return levelOffset(level) + (cell.z * n + cell.y) * n + cell.x;
+}
+
+// The deepest level whose cells are as large as the box, so the loose cell,
+// half a cell wider on every side, holds it whenever it holds the center.
+int32_t LooseOctree::nodeFor(const glm::vec3& min, const glm::vec3& max) const
+{
+	glm::vec3 size = max - min;
+	float largest = std::max(std::max(size.x, size.y), size.z);
+	int level = 0;
+	float cellSize = rootSize;
+	while (level + 1 < DEPTH && cellSize * 0.5f >= largest)
+	{
+		level++;
+		cellSize *= 0.5f;
+	}
+	glm::vec3 position = ((min + max) * 0.5f - origin) / cellSize;
+	if (position.x < 0.0f || position.y < 0.0f || position.z < 0.0f)
+		return 0;
+	int n = 1 << level;
+	glm::ivec3 cell((int)position.x, (int)position.y, (int)position.z);
+	if (cell.x >= n || cell.y >= n || cell.z >= n)
+		return 0;
+	return nodeIndex(level, cell);
+}
+
+void LooseOctree::link(uint32_t object, int32_t node)
+{
+	Entry& entry = entries[object];
+	entry.node = node;
+	entry.previous = -1;
+	entry.next = nodes[node].first;
+	if (entry.next >= 0)
+		entries[entry.next].previous = (int32_t)object;
+	nodes[node].first = (int32_t)object;
+	for (int32_t i = node; i >= 0; i = parents[i])
+		nodes[i].count++;
+}
+
+void LooseOctree::unlink(uint32_t object)
+{
+	Entry& entry = entries[object];
+	if (entry.previous >= 0)
+		entries[entry.previous].next = entry.next;
+	else
+		nodes[entry.node].first = entry.next;
+	if (entry.next >= 0)
+		entries[entry.next].previous = entry.previous;
+	for (int32_t i = entry.node; i >= 0; i = parents[i])
+		nodes[i].count--;
+	entry.node = -1;
+}
+
+void LooseOctree::insert(uint32_t object, const Aabb& box)
+{
+	if (object >= entries.size())
+		entries.resize(object + 1);
+	if (entries[object].node >= 0)
+		unlink(object);
+	entries[object].min = box.min;
+	entries[object].max = box.max;
+	link(object, nodeFor(box.min, box.max));
+}
+
+void LooseOctree::move(uint32_t object, const Aabb& box)
+{
+	Entry& entry = entries[object];
+	entry.min = box.min;
+	entry.max = box.max;
+	int32_t node = nodeFor(box.min, box.max);
+	if (node == entry.node)
+		return;
+	unlink(object);
+	link(object, node);
+	renderStats().octreeRelinks++;
+}
+
+void LooseOctree::remove(uint32_t object)
+{
+	if (contains(object))
+		unlink(object);
+}
+
+void LooseOctree::cull(const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+	if (size() > 0)
+		cullNode(frustum, 0, glm::ivec3(0), 0x3F, visible);
+}
+
+// The root's own objects are tested whatever its bounds, since those that left
+// it are kept there; every other cell is entered only when its loose bounds
+// touch the frustum.
+void LooseOctree::cullNode(const Frustum& frustum, int level, const glm::ivec3& cell, unsigned int mask, std::vector<uint32_t>& visible) const
+{
+	const Node& node = nodes[nodeIndex(level, cell)];
+	for (int32_t i = node.first; i >= 0; i = entries[i].next)
+	{
+		const Entry& entry = entries[i];
+		unsigned int objectMask = mask;
+		if (testPlanes(frustum, (entry.min + entry.max) * 0.5f, (entry.max - entry.min) * 0.5f, objectMask))
+			visible.push_back((uint32_t)i);
+	}
+	if (level + 1 == DEPTH)
+		return;
+
+	float childSize = rootSize / (float)(2 << level);
+	for (int child = 0; child < 8; child++)
+	{
+		glm::ivec3 childCell = cell * 2 + glm::ivec3(child & 1, (child >> 1) & 1, child >> 2);
+		if (nodes[nodeIndex(level + 1, childCell)].count == 0)
+			continue;
+		glm::vec3 center = origin + (glm::vec3(childCell) + 0.5f) * childSize;
+		unsigned int childMask = mask;
+		if (!testPlanes(frustum, center, glm::vec3(childSize), childMask))
+			continue;
+		if (childMask == 0)
+			addSubtree(level + 1, childCell, visible);
+		else
+			cullNode(frustum, level + 1, childCell, childMask, visible);
+	}
+}
+
+void LooseOctree::addSubtree(int level, const glm::ivec3& cell, std::vector<uint32_t>& visible) const
+{
+	const Node& node = nodes[nodeIndex(level, cell)];
+	if (node.count == 0)
+		return;
+	for (int32_t i = node.first; i >= 0; i = entries[i].next)
+		visible.push_back((uint32_t)i);
+	if (level + 1 == DEPTH)
+		return;
+	for (int child = 0; child < 8; child++)
+		addSubtree(level + 1, cell * 2 + glm::ivec3(child & 1, (child >> 1) & 1, child >> 2), visible);
+}
+
+void LooseOctree::clear()
+{
+	nodes.clear();
+	parents.clear();
+	entries.clear();
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "FrustumCuller.h"
+
+struct Aabb;
+
+// Loose octree for objects that move every frame. The cells of every level are
+// stored as a dense grid, so the cell of a box is found by arithmetic alone: the
+// level from the box's size, the cell from its center. Each cell's bounds are
+// loosened to twice its size, so an object sits in the cell holding its center
+// on the deepest level whose cells are at least as large as the object.
+//
+// Objects hang off their cell in an intrusive doubly-linked list, and every cell
+// counts the objects below it to let culling skip empty subtrees. Insert, move
+// and remove therefore cost a fixed number of steps whatever the object count,
+// and a move that stays within the same cell only stores the new box. Objects
+// whose centers leave the root cell are kept in the root, which is always
+// searched.
+class LooseOctree
+{
+public:
+	static const int DEPTH = 5;     // levels, root included
+
+	// a root cell around bounds; objects are numbered by the caller, and the
+	// storage for the first capacity of them is allocated here
+	void create(const Aabb& bounds, size_t capacity);
+
+	void insert(uint32_t object, const Aabb& box);
+	// stores the new box, moving the object to another cell only when needed
+	void move(uint32_t object, const Aabb& box);
+	void remove(uint32_t object);
+	bool contains(uint32_t object) const { return object < entries.size() && entries[object].node >= 0; }
+
+	// appends the objects whose boxes touch the frustum, in no particular order
+	void cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+	size_t size() const { return nodes.empty() ? 0 : nodes[0].count; }
+	size_t nodeCount() const { return nodes.size(); }
+
+	void clear();
+
+private:
+	struct Node
+	{
+		int32_t first = -1;     // first object in this cell
+		uint32_t count = 0;     // objects in this cell and all below it
+	};
+	struct Entry
+	{
+		glm::vec3 min = glm::vec3(0.0f);
+		glm::vec3 max = glm::vec3(0.0f);
+		int32_t node = -1;      // -1 while not in the tree
+		int32_t previous = -1;
+		int32_t next = -1;
+	};
+
+	int32_t nodeFor(const glm::vec3& min, const glm::vec3& max) const;
+	void link(uint32_t object, int32_t node);
+	void unlink(uint32_t object);
+	void cullNode(const Frustum& frustum, int level, const glm::ivec3& cell, unsigned int mask, std::vector<uint32_t>& visible) const;
+	void addSubtree(int level, const glm::ivec3& cell, std::vector<uint32_t>& visible) const;
+	int32_t nodeIndex(int level, const glm::ivec3& cell) const;
+
+	std::vector<Node> nodes;        // level by level, each level a dense grid
+	std::vector<int32_t> parents;   // per node, -1 for the root
+	std::vector<Entry> entries;     // per object
+	glm::vec3 origin = glm::vec3(0.0f);
+	float rootSize = 1.0f;
+};
@@ -0,0 +1,78 @@
+#include "MappedFile.h"
+#include <iostream>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::open(const char* path)
+{
+	close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		std::cout << "ERROR::MAPPEDFILE::OPEN_FAILED: " << path << std::endl;
+		return false;
+	}
+	LARGE_INTEGER size;
+	GetFileSizeEx(file, &size);
+	HANDLE fileMapping = size.QuadPart > 0 ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	const void* view = fileMapping != NULL ? MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (view == NULL)
+	{
+		if (fileMapping != NULL)
+			CloseHandle(fileMapping);
+		CloseHandle(file);
+		std::cout << "ERROR::MAPPEDFILE::MAP_FAILED: " << path << std::endl;
+		return false;
+	}
+	fileHandle = file;
+	mappingHandle = fileMapping;
+	mapping = view;
+	mappingSize = (size_t)size.QuadPart;
+#else
+	int file = ::open(path, O_RDONLY);
+	if (file < 0)
+	{
+		std::cout << "ERROR::MAPPEDFILE::OPEN_FAILED: " << path << std::endl;
+		return false;
+	}
+	struct stat info;
+	void* view = MAP_FAILED;
+	if (fstat(file, &info) == 0 && info.st_size > 0)
+		view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file); // the mapping keeps the file alive
+	if (view == MAP_FAILED)
+	{
+		std::cout << "ERROR::MAPPEDFILE::MAP_FAILED: " << path << std::endl;
+		return false;
+	}
+	mapping = view;
+	mappingSize = (size_t)info.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mapping == nullptr)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(mapping);
+	CloseHandle((HANDLE)mappingHandle);
+	CloseHandle((HANDLE)fileHandle);
+	fileHandle = mappingHandle = nullptr;
+#else
+	munmap((void*)mapping, mappingSize);
+#endif
+	mapping = nullptr;
+	mappingSize = 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+
+// A whole file mapped read-only into memory, for the binary formats that are
+// read in place (SceneFile, MeshFile). The data stays valid until close().
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { close(); }
+
+	// fails for a missing or empty file
+	bool open(const char* path);
+	void close();
+
+	const void* data() const { return mapping; }
+	size_t size() const { return mappingSize; }
+
+private:
+	const void* mapping = nullptr;
+	size_t mappingSize = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,139 @@
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "ShapeGenerator.h"
+#include <cstdio>
+#include <utility>
+
+namespace
+{
+	ShapeData generate(const MeshKey& key)
+	{
+		switch (key.generator)
+		{
+		case MeshKey::CUBE: return ShapeGenerator::makeCube();
+		case MeshKey::PLANE: return ShapeGenerator::makePlane(key.size);
+		case MeshKey::SPHERE: return ShapeGenerator::makeSphere(key.size);
+		case MeshKey::CYLINDER: return ShapeGenerator::makeCylinder(key.size);
+		case MeshKey::ICOSPHERE: return ShapeGenerator::makeIcosphere(key.size);
+		case MeshKey::CUBE_SPHERE: return ShapeGenerator::makeCubeSphere(key.size);
+		}
+		return ShapeData();
+	}
+}
+
+const char* MeshKey::name() const
+{
+	switch (generator)
+	{
+	case CUBE: return "cube";
+	case PLANE: return "plane";
+	case SPHERE: return "sphere";
+	case CYLINDER: return "cylinder";
+	case ICOSPHERE: return "icosphere";
+	case CUBE_SPHERE: return "cube sphere";
+	}
+	return "?";
+}
+
+MeshHandle::MeshHandle(const MeshHandle& other) : cache(other.cache), entry(other.entry)
+{
+	if (cache != nullptr)
+		cache->entries[entry].references++;
+}
+
+MeshHandle::MeshHandle(MeshHandle&& other) : cache(other.cache), entry(other.entry)
+{
+	other.cache = nullptr;
+}
+
+MeshHandle& MeshHandle::operator=(MeshHandle other)
+{
+	std::swap(cache, other.cache);
+	std::swap(entry, other.entry);
+	return *this;
+}
+
+MeshHandle::~MeshHandle()
+{
+	reset();
+}
+
+const MeshDraw& MeshHandle::draw() const
+{
+	return cache->entries[entry].draw;
+}
+
+const Aabb& MeshHandle::bounds() const
+{
+	return cache->entries[entry].bounds;
+}
+
+void MeshHandle::reset()
+{
+	if (cache != nullptr)
+		cache->entries[entry].references--;
+	cache = nullptr;
+}
+
+MeshHandle MeshCache::get(const MeshKey& key)
+{
+	auto found = lookup.find(key.packed());
+	if (found != lookup.end())
+	{
+		hits++;
+		entries[found->second].references++;
+		return MeshHandle(this, found->second);
+	}
+
+	ShapeData shape = generate(key);
+	MeshOptimizer::optimize(shape);
+	GLsizeiptr vertexBytes = geometry.vertexBufferSize();
+	GLsizeiptr indexBytes = geometry.indexBufferSize();
+	Entry added;
+	added.key = key;
+	if (key.generator == MeshKey::CUBE)
+		added.key.size = 0;
+	added.draw = geometry.add(shape);
+	added.bounds = Aabb::fromShape(shape);
+	added.vertexCount = shape.numVertices;
+	added.vertexBytes = (size_t)(geometry.vertexBufferSize() - vertexBytes);
+	added.indexBytes = (size_t)(geometry.indexBufferSize() - indexBytes);
+	added.references = 1;
+	shape.cleanup();
+
+	uint32_t entry = (uint32_t)entries.size();
+	entries.push_back(added);
+	lookup[key.packed()] = entry;
+	return MeshHandle(this, entry);
+}
+
+size_t MeshCache::residentBytes() const
+{
+	size_t bytes = 0;
+	for (const Entry& entry : entries)
+		bytes += entry.vertexBytes + entry.indexBytes;
+	return bytes;
+}
+
+size_t MeshCache::unreferencedBytes() const
+{
+	size_t bytes = 0;
+	for (const Entry& entry : entries)
+		bytes += entry.references == 0 ? entry.vertexBytes + entry.indexBytes : 0;
+	return bytes;
+}
+
+void MeshCache::report(std::ostream& out) const
+{
+	char line[128];
+	for (const Entry& entry : entries)
+	{
+		std::snprintf(line, sizeof(line), "  %-11s %4u: %6u vertices, %6u triangles, %7.1f KB, %u reference(s)\n",
+			entry.key.name(), entry.key.size, entry.vertexCount, (unsigned int)entry.draw.count / 3,
+			(entry.vertexBytes + entry.indexBytes) / 1024.0, entry.references);
+		out << line;
+	}
+	std::snprintf(line, sizeof(line), "  %zu meshes, %.1f KB resident (%.1f KB unreferenced), %llu hits\n",
+		entries.size(), residentBytes() / 1024.0, unreferencedBytes() / 1024.0, hits);
+	out << line;
+}
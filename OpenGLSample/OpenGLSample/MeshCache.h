@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "GeometryBuffer.h"
+#include "Scene.h"
+
+// A generated shape: which ShapeGenerator function and the one size it takes
+// (tessellation, dimensions or subdivisions; ignored for the cube)
+struct MeshKey
+{
+	enum Generator { CUBE, PLANE, SPHERE, CYLINDER, ICOSPHERE, CUBE_SPHERE };
+
+	Generator generator;
+	unsigned int size;
+
+	const char* name() const;
+	// the cube's size is left out, so every cube is the same mesh
+	uint64_t packed() const { return ((uint64_t)generator << 32) | (generator == CUBE ? 0u : size); }
+};
+
+class MeshCache;
+
+// Counted reference to a mesh in a MeshCache. Copies share the mesh; the last
+// one to go releases it. A default-constructed handle refers to nothing. Every
+// handle must be gone before its cache.
+class MeshHandle
+{
+public:
+	MeshHandle() : cache(nullptr), entry(0) {}
+	MeshHandle(const MeshHandle& other);
+	MeshHandle(MeshHandle&& other);
+	MeshHandle& operator=(MeshHandle other);
+	~MeshHandle();
+
+	explicit operator bool() const { return cache != nullptr; }
+	const MeshDraw& draw() const;
+	// the shape's own bounds, before any model matrix
+	const Aabb& bounds() const;
+
+	void reset();
+
+private:
+	friend class MeshCache;
+	// takes over a reference already counted by the cache
+	MeshHandle(MeshCache* cache, uint32_t entry) : cache(cache), entry(entry) {}
+
+	MeshCache* cache;
+	uint32_t entry;
+};
+
+// Generates each shape once and copies it into a GeometryBuffer once, however
+// many times and from wherever it is asked for. A hit is a hash lookup and a
+// counter increment. Every mesh goes through MeshOptimizer::optimize() on the
+// way in, as the scene does for all of its shapes.
+//
+// The buffer is append-only, so a mesh whose last handle is gone stays resident:
+// it is reported as unreferenced, and asking for it again brings it back without
+// regenerating it. Its memory comes back only with the buffer's cleanup(). A
+// miss after the buffer's upload() needs another upload() before drawing.
+class MeshCache
+{
+public:
+	explicit MeshCache(GeometryBuffer& geometry) : geometry(geometry) {}
+
+	MeshHandle get(const MeshKey& key);
+
+	size_t meshCount() const { return entries.size(); }
+	// vertex and index bytes in the buffer, of all meshes and of those no handle
+	// refers to any more
+	size_t residentBytes() const;
+	size_t unreferencedBytes() const;
+	unsigned long long hitCount() const { return hits; }
+	unsigned long long missCount() const { return entries.size(); }
+
+	// one line per mesh: vertices, triangles, bytes and references
+	void report(std::ostream& out) const;
+
+private:
+	friend class MeshHandle;
+
+	struct Entry
+	{
+		MeshKey key;
+		MeshDraw draw;
+		Aabb bounds;
+		GLuint vertexCount;
+		size_t vertexBytes;
+		size_t indexBytes;      // with any padding to align 32-bit indices
+		unsigned int references;
+	};
+
+	GeometryBuffer& geometry;
+	std::vector<Entry> entries;
+	std::unordered_map<uint64_t, uint32_t> lookup;   // MeshKey::packed() -> entry
+	unsigned long long hits = 0;
+};
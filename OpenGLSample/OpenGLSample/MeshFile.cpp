@@ -0,0 +1,189 @@
+#include "MeshFile.h"
+#include "ShapeData.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+	const char MAGIC[4] = { 'M', 'S', 'H', 'B' };
+
+	// every section starts on a 16-byte boundary
+	uint64_t align(uint64_t offset)
+	{
+		return (offset + 15) & ~(uint64_t)15;
+	}
+
+	bool sectionFits(uint64_t offset, uint64_t bytes, uint64_t fileSize)
+	{
+		return offset % 16 == 0 && offset <= fileSize && bytes <= fileSize - offset;
+	}
+
+	// any unit vector orthogonal to normal
+	glm::vec3 orthogonal(const glm::vec3& normal)
+	{
+		glm::vec3 axis = std::fabs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		return glm::normalize(glm::cross(normal, axis));
+	}
+}
+
+std::vector<glm::vec4> MeshFile::computeTangents(const ShapeData& shape)
+{
+	// sums of the triangles' texture-space u and v directions at each vertex,
+	// weighted by the triangles' area since the vectors are not normalized
+	std::vector<glm::vec3> uSums(shape.numVertices, glm::vec3(0.0f));
+	std::vector<glm::vec3> vSums(shape.numVertices, glm::vec3(0.0f));
+	for (GLuint i = 0; i + 2 < shape.numIndices; i += 3)
+	{
+		const Vertex& a = shape.vertices[shape.indices[i]];
+		const Vertex& b = shape.vertices[shape.indices[i + 1]];
+		const Vertex& c = shape.vertices[shape.indices[i + 2]];
+		glm::vec3 e1 = b.position - a.position;
+		glm::vec3 e2 = c.position - a.position;
+		glm::vec2 d1 = b.texCoord - a.texCoord;
+		glm::vec2 d2 = c.texCoord - a.texCoord;
+		float determinant = d1.x * d2.y - d2.x * d1.y;
+		if (std::fabs(determinant) < 1e-12f)
+			continue;
+		float r = 1.0f / determinant;
+		glm::vec3 u = (e1 * d2.y - e2 * d1.y) * r;
+		glm::vec3 v = (e2 * d1.x - e1 * d2.x) * r;
+		for (int k = 0; k < 3; k++)
+		{
+			uSums[shape.indices[i + k]] += u;
+			vSums[shape.indices[i + k]] += v;
+		}
+	}
+
+	std::vector<glm::vec4> tangents(shape.numVertices);
+	for (GLuint i = 0; i < shape.numVertices; i++)
+	{
+		const glm::vec3& normal = shape.vertices[i].normal;
+		// Gram-Schmidt against the normal
+		glm::vec3 tangent = uSums[i] - normal * glm::dot(normal, uSums[i]);
+		float length = glm::length(tangent);
+		tangent = length > 1e-6f ? tangent * (1.0f / length) : orthogonal(normal);
+		float handedness = glm::dot(glm::cross(normal, tangent), vSums[i]) < 0.0f ? -1.0f : 1.0f;
+		tangents[i] = glm::vec4(tangent, handedness);
+	}
+	return tangents;
+}
+
+bool MeshFile::write(const char* path, const ShapeData& shape)
+{
+	MeshFileHeader header = {};
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = MESH_FILE_VERSION;
+	header.vertexCount = shape.numVertices;
+	header.indexCount = shape.numIndices;
+	header.indexType = shape.indexType();
+	header.vertexSize = sizeof(CompactMeshVertex);
+
+	glm::vec3 min(0.0f), max(0.0f);
+	if (shape.numVertices > 0)
+		min = max = shape.vertices[0].position;
+	for (GLuint i = 0; i < shape.numVertices; i++)
+	{
+		min = glm::min(min, shape.vertices[i].position);
+		max = glm::max(max, shape.vertices[i].position);
+	}
+	PositionQuantization quantization = PositionQuantization::fromBounds(min, max);
+	header.positionScale = quantization.scale;
+	header.positionOffset = quantization.offset;
+	header.boundsMin = min;
+	header.boundsMax = max;
+
+	uint64_t offset = align(sizeof(MeshFileHeader));
+	header.verticesOffset = offset;
+	offset = align(offset + (uint64_t)shape.numVertices * sizeof(CompactMeshVertex));
+	header.indicesOffset = offset;
+	offset = align(offset + shape.indexBufferSize());
+	header.fileSize = offset;
+
+	std::vector<char> file((size_t)header.fileSize, 0);
+	memcpy(file.data(), &header, sizeof(header));
+
+	std::vector<glm::vec4> tangents = computeTangents(shape);
+	CompactMeshVertex* packed = (CompactMeshVertex*)(file.data() + header.verticesOffset);
+	for (GLuint i = 0; i < shape.numVertices; i++)
+	{
+		const Vertex& vertex = shape.vertices[i];
+		quantization.encode(vertex.position, packed[i].Position);
+		glm::vec2 normal = VertexFormat::encodeOctahedral(vertex.normal);
+		packed[i].Normal[0] = VertexFormat::packSnorm16(normal.x);
+		packed[i].Normal[1] = VertexFormat::packSnorm16(normal.y);
+		packed[i].TexCoords[0] = VertexFormat::packHalf(vertex.texCoord.x);
+		packed[i].TexCoords[1] = VertexFormat::packHalf(vertex.texCoord.y);
+		packed[i].Tangent = VertexFormat::packTangent(glm::vec3(tangents[i]), tangents[i].w);
+	}
+
+	if (header.indexType == GL_UNSIGNED_SHORT)
+	{
+		GLushort* indices = (GLushort*)(file.data() + header.indicesOffset);
+		for (GLuint i = 0; i < shape.numIndices; i++)
+			indices[i] = (GLushort)shape.indices[i];
+	}
+	else if (shape.numIndices > 0)
+		memcpy(file.data() + header.indicesOffset, shape.indices, shape.numIndices * sizeof(GLuint));
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write(file.data(), file.size());
+	if (!out)
+	{
+		std::cout << "ERROR::MESHFILE::WRITE_FAILED: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool MeshFile::open(const char* path)
+{
+	close();
+	if (!mapped.open(path))
+		return false;
+	size_t mappingSize = mapped.size();
+
+	// validate the header and that both sections lie inside the file; the
+	// vertices and indices themselves are never read on the CPU
+	const char* base = (const char*)mapped.data();
+	header = (const MeshFileHeader*)base;
+	if (mappingSize < sizeof(MeshFileHeader) || memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0
+		|| header->version != MESH_FILE_VERSION || header->fileSize != mappingSize
+		|| header->vertexSize != sizeof(CompactMeshVertex)
+		|| (header->indexType != GL_UNSIGNED_SHORT && header->indexType != GL_UNSIGNED_INT)
+		|| !sectionFits(header->verticesOffset, (uint64_t)header->vertexCount * sizeof(CompactMeshVertex), mappingSize)
+		|| !sectionFits(header->indicesOffset, indexBytes(), mappingSize))
+	{
+		std::cout << "ERROR::MESHFILE::INVALID_FILE: " << path << std::endl;
+		close();
+		return false;
+	}
+	vertexArray = (const CompactMeshVertex*)(base + header->verticesOffset);
+	indexArray = base + header->indicesOffset;
+	return true;
+}
+
+void MeshFile::close()
+{
+	mapped.close();
+	header = nullptr;
+	vertexArray = nullptr;
+	indexArray = nullptr;
+}
+
+void MeshFile::upload(GLuint vertexBuffer, GLuint elementBuffer) const
+{
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)header->vertexCount * sizeof(CompactMeshVertex), vertexArray, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexBytes(), indexArray, GL_STATIC_DRAW);
+}
+
+PositionQuantization MeshFile::quantization() const
+{
+	PositionQuantization quantization;
+	quantization.scale = header->positionScale;
+	quantization.offset = header->positionOffset;
+	return quantization;
+}
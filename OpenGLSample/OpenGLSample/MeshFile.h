@@ -0,0 +1,86 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "MappedFile.h"
+#include "VertexFormat.h"
+
+// Binary mesh layout, written offline by the MeshCompiler tool and loaded by
+// mapping the file into memory. The vertices are already in the layout Mesh
+// draws from (CompactMeshVertex, with tangents computed) and the indices already
+// in vertex cache order and at their GPU width, so loading is handing the two
+// sections to glBufferData: no parsing and no per-vertex work.
+//
+// Only a forward declaration of ShapeData is used here, since mesh.h includes
+// this file and has a Vertex of its own.
+
+const uint32_t MESH_FILE_VERSION = 1;
+
+struct ShapeData;
+
+struct MeshFileHeader
+{
+	char magic[4];              // "MSHB"
+	uint32_t version;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t indexType;         // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	uint32_t vertexSize;        // sizeof(CompactMeshVertex) when written
+	glm::vec3 positionScale;    // the quantization box, see PositionQuantization
+	glm::vec3 positionOffset;
+	glm::vec3 boundsMin;        // unquantized
+	glm::vec3 boundsMax;
+	uint64_t verticesOffset;    // CompactMeshVertex[vertexCount]
+	uint64_t indicesOffset;     // GLushort or GLuint [indexCount]
+	uint64_t fileSize;
+};
+
+// A mapped binary mesh. The sections point straight into the mapping and stay
+// valid until close().
+class MeshFile
+{
+public:
+	MeshFile() = default;
+	MeshFile(const MeshFile&) = delete;
+	MeshFile& operator=(const MeshFile&) = delete;
+	~MeshFile() { close(); }
+
+	bool open(const char* path);
+	void close();
+
+	// Packs shape into the file layout: tangents from its texture coordinates,
+	// positions quantized in its bounds, normals octahedral and indices 16-bit
+	// when it has few enough vertices. The index order is written as it is, so
+	// run MeshOptimizer over the shape first.
+	static bool write(const char* path, const ShapeData& shape);
+
+	// Per-vertex tangent from the texture coordinates of the triangles around it
+	// (Lengyel's method), made orthogonal to the normal; w is the handedness of
+	// the bitangent, cross(normal, tangent) * w. Vertices whose triangles have
+	// no usable texture coordinates get any unit vector orthogonal to the normal.
+	static std::vector<glm::vec4> computeTangents(const ShapeData& shape);
+
+	// copies both sections into the buffers, binding them to GL_ARRAY_BUFFER and
+	// GL_ELEMENT_ARRAY_BUFFER; the element binding is part of the current VAO
+	void upload(GLuint vertexBuffer, GLuint elementBuffer) const;
+
+	uint32_t vertexCount() const { return header->vertexCount; }
+	const CompactMeshVertex* vertices() const { return vertexArray; }
+	uint32_t indexCount() const { return header->indexCount; }
+	GLenum indexType() const { return header->indexType; }
+	const void* indices() const { return indexArray; }
+	size_t indexBytes() const { return header->indexCount * (header->indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint)); }
+
+	PositionQuantization quantization() const;
+	glm::vec3 boundsMin() const { return header->boundsMin; }
+	glm::vec3 boundsMax() const { return header->boundsMax; }
+
+private:
+	MappedFile mapped;
+
+	const MeshFileHeader* header = nullptr;
+	const CompactMeshVertex* vertexArray = nullptr;
+	const void* indexArray = nullptr;
+};
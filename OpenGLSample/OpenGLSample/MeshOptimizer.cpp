@@ -0,0 +1,223 @@
+#include "MeshOptimizer.h"
+#include "MeshTopology.h"
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace
+{
+	// FIFO cache misses per triangle of the order
+	std::vector<unsigned int> simulateFifo(const ShapeData& shape, unsigned int cacheSize)
+	{
+		std::vector<unsigned int> misses(shape.numIndices / 3, 0);
+		// a vertex is in the cache while fewer than cacheSize others were loaded after it
+		std::vector<unsigned int> loaded(shape.numVertices, 0);
+		unsigned int time = cacheSize + 1;
+		for (GLuint i = 0; i < misses.size() * 3; i++)
+		{
+			GLuint v = shape.indices[i];
+			if (time - loaded[v] > cacheSize)
+			{
+				loaded[v] = time++;
+				misses[i / 3]++;
+			}
+		}
+		return misses;
+	}
+}
+
+// Tipsify (Sander, Nehab and Barczak): triangles are emitted as whole fans
+// around one vertex at a time. The next fan is the vertex of the last fan that
+// entered the cache earliest while its remaining triangles would still find it
+// there; a dead end falls back to the most recent vertex with triangles left,
+// then to the input order. The cylinder's caps come out with their side quads,
+// since each rim vertex's fan holds its cap triangle.
+void MeshOptimizer::optimizeVertexCache(ShapeData& shape, unsigned int cacheSize)
+{
+	GLuint triangleCount = shape.numIndices / 3;
+	if (triangleCount == 0)
+		return;
+	const GLuint* indices = shape.indices;
+
+	Adjacency adjacency;
+	adjacency.build(indices, triangleCount * 3, shape.numVertices);
+	std::vector<unsigned int> live(adjacency.counts);
+	// when each vertex was last loaded; in the cache while within cacheSize loads
+	std::vector<unsigned int> loaded(shape.numVertices, 0);
+	unsigned int time = cacheSize + 1;
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<GLuint> deadEnds;
+	std::vector<GLuint> fanVertices;
+	std::vector<GLuint> order;
+	order.reserve(triangleCount * 3);
+	GLuint nextUnused = 0;
+
+	int fan = indices[0];
+	while (fan >= 0)
+	{
+		fanVertices.clear();
+		for (unsigned int j = adjacency.offsets[fan]; j < adjacency.offsets[fan + 1]; j++)
+		{
+			unsigned int t = adjacency.triangles[j];
+			if (emitted[t])
+				continue;
+			emitted[t] = true;
+			for (int k = 0; k < 3; k++)
+			{
+				GLuint v = indices[t * 3 + k];
+				order.push_back(v);
+				deadEnds.push_back(v);
+				fanVertices.push_back(v);
+				live[v]--;
+				if (time - loaded[v] > cacheSize)
+					loaded[v] = time++;
+			}
+		}
+
+		fan = -1;
+		int bestAge = -1;
+		for (GLuint v : fanVertices)
+		{
+			if (live[v] == 0)
+				continue;
+			int age = 0;
+			if (time - loaded[v] + 2 * live[v] <= cacheSize)
+				age = (int)(time - loaded[v]);
+			if (age > bestAge)
+			{
+				bestAge = age;
+				fan = v;
+			}
+		}
+		while (fan < 0 && !deadEnds.empty())
+		{
+			GLuint v = deadEnds.back();
+			deadEnds.pop_back();
+			if (live[v] > 0)
+				fan = v;
+		}
+		while (fan < 0 && nextUnused < shape.numVertices)
+		{
+			if (live[nextUnused] > 0)
+				fan = (int)nextUnused;
+			nextUnused++;
+		}
+	}
+	assert(order.size() == triangleCount * 3);
+	std::copy(order.begin(), order.end(), shape.indices);
+}
+
+void MeshOptimizer::optimizeOverdraw(ShapeData& shape, float threshold, unsigned int cacheSize)
+{
+	GLuint triangleCount = shape.numIndices / 3;
+	if (triangleCount < 2)
+		return;
+	const GLuint* indices = shape.indices;
+	unsigned int totalMisses = 0;
+	for (unsigned int m : simulateFifo(shape, cacheSize))
+		totalMisses += m;
+	float limit = threshold * totalMisses / triangleCount;
+
+	// Each cluster is costed as if drawn from an empty cache, since after sorting
+	// it follows some other cluster. A triangle sharing nothing with the cluster
+	// starts a new one; so does the first triangle after the cluster's ACMR got
+	// down to the limit.
+	std::vector<GLuint> clusterStarts(1, 0);
+	std::vector<unsigned int> loaded(shape.numVertices, 0);
+	unsigned int time = cacheSize + 1;
+	unsigned int clusterMisses = 0;
+	for (GLuint t = 0; t < triangleCount; t++)
+	{
+		GLuint clusterSize = t - clusterStarts.back();
+		unsigned int misses = 0;
+		for (int k = 0; k < 3; k++)
+			misses += time - loaded[indices[t * 3 + k]] > cacheSize ? 1 : 0;
+		if (clusterSize > 0 && (misses == 3 || clusterMisses <= limit * clusterSize))
+		{
+			clusterStarts.push_back(t);
+			clusterMisses = 0;
+			time += cacheSize;      // empties the cache
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			GLuint v = indices[t * 3 + k];
+			if (time - loaded[v] > cacheSize)
+			{
+				loaded[v] = time++;
+				clusterMisses++;
+			}
+		}
+	}
+	clusterStarts.push_back(triangleCount);
+
+	// area-weighted centroid and normal per cluster, and of the whole shape
+	size_t clusterCount = clusterStarts.size() - 1;
+	std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+	std::vector<float> areas(clusterCount, 0.0f);
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		for (GLuint t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+		{
+			glm::vec3 a = shape.vertices[indices[t * 3]].position;
+			glm::vec3 b = shape.vertices[indices[t * 3 + 1]].position;
+			glm::vec3 d = shape.vertices[indices[t * 3 + 2]].position;
+			glm::vec3 normal = glm::cross(b - a, d - a);
+			float area = glm::length(normal);
+			centroids[c] += (a + b + d) * (area / 3.0f);
+			normals[c] += normal;
+			areas[c] += area;
+		}
+		meshCentroid += centroids[c];
+		meshArea += areas[c];
+		if (areas[c] > 0.0f)
+			centroids[c] /= areas[c];
+	}
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	// clusters facing out of the shape the most are drawn first
+	std::vector<float> keys(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float length = glm::length(normals[c]);
+		keys[c] = length > 0.0f ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.0f;
+	}
+	std::vector<size_t> sorted(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+		sorted[c] = c;
+	std::stable_sort(sorted.begin(), sorted.end(), [&keys](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+	std::vector<GLuint> order;
+	order.reserve(triangleCount * 3);
+	for (size_t c : sorted)
+		order.insert(order.end(), indices + clusterStarts[c] * 3, indices + clusterStarts[c + 1] * 3);
+	std::copy(order.begin(), order.end(), shape.indices);
+}
+
+void MeshOptimizer::optimize(ShapeData& shape)
+{
+	optimizeVertexCache(shape);
+	optimizeOverdraw(shape);
+}
+
+VertexCacheStats MeshOptimizer::analyze(const ShapeData& shape, unsigned int cacheSize)
+{
+	VertexCacheStats stats;
+	stats.triangles = shape.numIndices / 3;
+	for (unsigned int m : simulateFifo(shape, cacheSize))
+		stats.misses += m;
+	std::vector<bool> used(shape.numVertices, false);
+	for (GLuint i = 0; i < stats.triangles * 3; i++)
+	{
+		stats.vertices += used[shape.indices[i]] ? 0 : 1;
+		used[shape.indices[i]] = true;
+	}
+	if (stats.triangles > 0)
+		stats.acmr = (float)stats.misses / stats.triangles;
+	if (stats.vertices > 0)
+		stats.atvr = (float)stats.misses / stats.vertices;
+	return stats;
+}
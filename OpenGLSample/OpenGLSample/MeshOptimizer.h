@@ -0,0 +1,42 @@
+#pragma once
+#include "ShapeData.h"
+
+// How well an index order uses the GPU's post-transform vertex cache, simulated
+// as a FIFO. ACMR is vertex shader runs per triangle (0.5 is the ideal for a
+// large regular grid, 3 the worst); ATVR is runs per vertex (1 is ideal).
+struct VertexCacheStats
+{
+	unsigned int triangles = 0;
+	unsigned int vertices = 0;      // distinct vertices referenced
+	unsigned int misses = 0;        // vertex shader runs
+	float acmr = 0.0f;
+	float atvr = 0.0f;
+};
+
+// Index reordering passes that run on any ShapeData in place. Only the order of
+// the triangles changes: the vertices, the triangles themselves and their
+// winding stay as they are.
+class MeshOptimizer
+{
+public:
+	// entries of the FIFO the passes order for and the analyzer simulates, about
+	// what current GPUs keep
+	static const unsigned int CACHE_SIZE = 16;
+
+	// Tipsify ordering: whole fans of triangles around one vertex at a time,
+	// moving on to a neighbouring vertex that is still in the cache
+	static void optimizeVertexCache(ShapeData& shape, unsigned int cacheSize = CACHE_SIZE);
+
+	// Keeps the cache order but draws the outward-facing parts of the shape
+	// first, so more of its hidden surface fails the depth test. The cache-ordered
+	// triangles are cut into clusters wherever the cache would start over anyway,
+	// or once a cluster misses no more than threshold times the ACMR of the whole
+	// order; the clusters are then sorted by how much they face away from the
+	// centre of the shape. Run after optimizeVertexCache().
+	static void optimizeOverdraw(ShapeData& shape, float threshold = 1.05f, unsigned int cacheSize = CACHE_SIZE);
+
+	// both passes
+	static void optimize(ShapeData& shape);
+
+	static VertexCacheStats analyze(const ShapeData& shape, unsigned int cacheSize = CACHE_SIZE);
+};
@@ -0,0 +1,508 @@
+#include "MeshSimplifier.h"
+#include "MeshTopology.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+namespace
+{
+	enum VertexKind { MANIFOLD, BORDER, SEAM, LOCKED };
+
+	const GLuint NONE = ~0u;
+	// an open edge is held in place by a plane through it, square to its
+	// triangle, weighted this many times the triangle's own plane
+	const double EDGE_WEIGHT = 10.0;
+	// vertices closer than this fraction of the mesh's size are one position,
+	// so a seam whose sides came out of different arithmetic is still a seam
+	const float WELD_TOLERANCE = 1e-5f;
+
+	inline uint64_t edgeKey(GLuint a, GLuint b)
+	{
+		return ((uint64_t)a << 32) | b;
+	}
+
+	// sum of weighted squared distances to a set of planes, as the symmetric
+	// matrix A, the vector b and the constant c of x.A.x + 2 b.x + c
+	struct Quadric
+	{
+		double a00, a11, a22, a10, a20, a21;
+		double b0, b1, b2;
+		double c;
+		double weight;
+
+		static Quadric plane(const glm::vec3& normal, float distance, double weight)
+		{
+			double x = normal.x, y = normal.y, z = normal.z, d = distance;
+			Quadric q = { weight * x * x, weight * y * y, weight * z * z, weight * y * x, weight * z * x, weight * z * y,
+				weight * x * d, weight * y * d, weight * z * d, weight * d * d, weight };
+			return q;
+		}
+
+		void add(const Quadric& other)
+		{
+			a00 += other.a00; a11 += other.a11; a22 += other.a22;
+			a10 += other.a10; a20 += other.a20; a21 += other.a21;
+			b0 += other.b0; b1 += other.b1; b2 += other.b2;
+			c += other.c;
+			weight += other.weight;
+		}
+
+		// weighted sum of squared distances, without dividing by the weight
+		double evaluate(const glm::vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double rx = a00 * x + a10 * y + a20 * z + b0;
+			double ry = a10 * x + a11 * y + a21 * z + b1;
+			double rz = a20 * x + a21 * y + a22 * z + b2;
+			return rx * x + ry * y + rz * z + b0 * x + b1 * y + b2 * z + c;
+		}
+	};
+
+	struct Collapse
+	{
+		GLuint from;
+		GLuint to;
+		double error;       // mean squared distance to the planes after the collapse
+	};
+
+	// 21 bits per axis of a grid cell
+	inline uint64_t cellKey(const glm::ivec3& cell)
+	{
+		const int BIAS = 1 << 20;
+		return ((uint64_t)(cell.x + BIAS) & 0x1FFFFF) | (((uint64_t)(cell.y + BIAS) & 0x1FFFFF) << 21) | (((uint64_t)(cell.z + BIAS) & 0x1FFFFF) << 42);
+	}
+
+	// for every vertex, the first vertex within tolerance of it; the points are
+	// hashed into cells of that size, and a point's own and neighbouring cells
+	// are searched
+	std::vector<GLuint> weldPositions(const glm::vec3* positions, size_t stride, GLuint vertexCount)
+	{
+		std::vector<GLuint> remap(vertexCount);
+		if (vertexCount == 0)
+			return remap;
+		glm::vec3 min = positionAt(positions, stride, 0), max = min;
+		for (GLuint v = 1; v < vertexCount; v++)
+		{
+			min = glm::min(min, positionAt(positions, stride, v));
+			max = glm::max(max, positionAt(positions, stride, v));
+		}
+		glm::vec3 size = max - min;
+		float extent = std::max(size.x, std::max(size.y, size.z));
+		float tolerance = extent > 0.0f ? extent * WELD_TOLERANCE : 1.0f;
+
+		std::unordered_multimap<uint64_t, GLuint> cells;
+		for (GLuint v = 0; v < vertexCount; v++)
+		{
+			const glm::vec3& p = positionAt(positions, stride, v);
+			glm::ivec3 cell((int)std::floor((p.x - min.x) / tolerance), (int)std::floor((p.y - min.y) / tolerance), (int)std::floor((p.z - min.z) / tolerance));
+			remap[v] = v;
+			for (int i = 0; i < 27 && remap[v] == v; i++)
+			{
+				auto range = cells.equal_range(cellKey(cell + glm::ivec3(i % 3 - 1, i / 3 % 3 - 1, i / 9 - 1)));
+				for (auto it = range.first; it != range.second; ++it)
+				{
+					glm::vec3 offset = positionAt(positions, stride, it->second) - p;
+					if (glm::dot(offset, offset) <= tolerance * tolerance)
+					{
+						remap[v] = it->second;
+						break;
+					}
+				}
+			}
+			if (remap[v] == v)
+				cells.emplace(cellKey(cell), v);
+		}
+		return remap;
+	}
+
+	uint64_t fnv1a(uint64_t hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		return hash;
+	}
+
+	uint64_t chainKey(const GLuint* indices, GLuint indexCount, const glm::vec3* positions, size_t stride, GLuint vertexCount,
+		const float* ratios, unsigned int levelCount)
+	{
+		uint64_t hash = fnv1a(14695981039346656037ull, &LOD_FILE_VERSION, sizeof(LOD_FILE_VERSION));
+		for (GLuint v = 0; v < vertexCount; v++)
+			hash = fnv1a(hash, &positionAt(positions, stride, v), sizeof(glm::vec3));
+		hash = fnv1a(hash, indices, indexCount * sizeof(GLuint));
+		return fnv1a(hash, ratios, levelCount * sizeof(float));
+	}
+
+	struct LodFileHeader
+	{
+		char magic[4];          // "LODC"
+		uint32_t version;
+		uint64_t key;           // chainKey() of the mesh the chain was built from
+		uint32_t levelCount;
+		uint32_t padding;
+	};
+
+	struct LodFileLevel
+	{
+		float ratio;
+		float error;
+		uint32_t indexCount;    // the indices of all levels follow the level table
+		uint32_t padding;
+	};
+
+	bool readChain(const char* path, uint64_t key, std::vector<SimplifiedLevel>& levels)
+	{
+		std::ifstream in(path, std::ios::binary);
+		LodFileHeader header;
+		if (!in.read((char*)&header, sizeof(header)))
+			return false;
+		if (std::memcmp(header.magic, "LODC", 4) != 0 || header.version != LOD_FILE_VERSION || header.key != key)
+			return false;
+		std::vector<LodFileLevel> table(header.levelCount);
+		if (!in.read((char*)table.data(), table.size() * sizeof(LodFileLevel)))
+			return false;
+		levels.resize(header.levelCount);
+		for (uint32_t i = 0; i < header.levelCount; i++)
+		{
+			levels[i].ratio = table[i].ratio;
+			levels[i].error = table[i].error;
+			levels[i].indices.resize(table[i].indexCount);
+			if (!in.read((char*)levels[i].indices.data(), table[i].indexCount * sizeof(GLuint)))
+				return false;
+		}
+		return true;
+	}
+
+	void writeChain(const char* path, uint64_t key, const std::vector<SimplifiedLevel>& levels)
+	{
+		LodFileHeader header = { { 'L', 'O', 'D', 'C' }, LOD_FILE_VERSION, key, (uint32_t)levels.size(), 0 };
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out.write((const char*)&header, sizeof(header));
+		for (const SimplifiedLevel& level : levels)
+		{
+			LodFileLevel entry = { level.ratio, level.error, (uint32_t)level.indices.size(), 0 };
+			out.write((const char*)&entry, sizeof(entry));
+		}
+		for (const SimplifiedLevel& level : levels)
+			out.write((const char*)level.indices.data(), level.indices.size() * sizeof(GLuint));
+		if (!out)
+			std::cout << "ERROR::MESHSIMPLIFIER::WRITE_FAILED: " << path << std::endl;
+	}
+}
+
+std::vector<GLuint> MeshSimplifier::simplify(const GLuint* indices, GLuint indexCount, const glm::vec3* positions, size_t stride, GLuint vertexCount,
+	GLuint targetIndexCount, float maxError, float* error)
+{
+	std::vector<GLuint> result(indices, indices + indexCount / 3 * 3);
+	if (error != nullptr)
+		*error = 0.0f;
+	if (result.size() <= targetIndexCount)
+		return result;
+
+	// vertices at one position are welded to the first of them for the
+	// topology and the quadrics, and linked in a ring through wedge
+	std::vector<GLuint> remap = weldPositions(positions, stride, vertexCount);
+	std::vector<GLuint> wedge(vertexCount);
+	for (GLuint v = 0; v < vertexCount; v++)
+	{
+		wedge[v] = remap[v] == v ? v : wedge[remap[v]];
+		wedge[remap[v]] = v;
+	}
+
+	// Half-edges without a twin running the other way are open: on a border of
+	// the welded mesh, or on a seam when only open with the attributes. An
+	// edge used twice in one direction is not manifold and pins its ends.
+	std::unordered_map<uint64_t, unsigned int> edges, weldedEdges;
+	for (size_t i = 0; i < result.size(); i++)
+	{
+		GLuint a = result[i], b = result[i - i % 3 + (i + 1) % 3];
+		edges[edgeKey(a, b)]++;
+		weldedEdges[edgeKey(remap[a], remap[b])]++;
+	}
+	std::vector<GLuint> openNext(vertexCount, NONE), openPrev(vertexCount, NONE);
+	std::vector<unsigned int> openOut(vertexCount, 0), openIn(vertexCount, 0), weldedOpen(vertexCount, 0);
+	std::vector<bool> pinned(vertexCount, false);
+	for (size_t i = 0; i < result.size(); i++)
+	{
+		GLuint a = result[i], b = result[i - i % 3 + (i + 1) % 3];
+		if (edges[edgeKey(a, b)] > 1 || weldedEdges[edgeKey(remap[a], remap[b])] > 1)
+			pinned[remap[a]] = pinned[remap[b]] = true;
+		if (edges.find(edgeKey(b, a)) == edges.end())
+		{
+			openOut[a]++;
+			openIn[b]++;
+			openNext[a] = b;
+			openPrev[b] = a;
+		}
+		if (weldedEdges.find(edgeKey(remap[b], remap[a])) == weldedEdges.end())
+			weldedOpen[remap[a]]++;
+	}
+
+	std::vector<VertexKind> kinds(vertexCount, LOCKED);
+	for (GLuint v = 0; v < vertexCount; v++)
+	{
+		unsigned int wedges = 1;
+		for (GLuint w = wedge[v]; w != v; w = wedge[w])
+			wedges++;
+		bool simpleOpen = openOut[v] == 1 && openIn[v] == 1;
+		if (pinned[remap[v]])
+			kinds[v] = LOCKED;
+		else if (wedges == 1)
+			kinds[v] = openOut[v] == 0 && openIn[v] == 0 ? MANIFOLD : simpleOpen ? BORDER : LOCKED;
+		else if (wedges == 2)
+			kinds[v] = weldedOpen[remap[v]] == 0 && simpleOpen && openOut[wedge[v]] == 1 && openIn[wedge[v]] == 1 ? SEAM : LOCKED;
+	}
+
+	// Area-weighted triangle planes, plus a plane along every open edge that
+	// makes moving it cost more. The collapses are ordered by both; the error
+	// handed back only measures the distance to the surface.
+	std::vector<Quadric> quadrics(vertexCount, Quadric()), surfaces(vertexCount, Quadric());
+	for (size_t t = 0; t < result.size(); t += 3)
+	{
+		const glm::vec3& p0 = positionAt(positions, stride, result[t]);
+		const glm::vec3& p1 = positionAt(positions, stride, result[t + 1]);
+		const glm::vec3& p2 = positionAt(positions, stride, result[t + 2]);
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float length = glm::length(normal);
+		if (length == 0.0f)
+			continue;
+		normal = normal / length;
+		Quadric plane = Quadric::plane(normal, -glm::dot(normal, p0), length * 0.5);
+		for (int k = 0; k < 3; k++)
+		{
+			GLuint a = result[t + k], b = result[t + (k + 1) % 3];
+			quadrics[remap[a]].add(plane);
+			surfaces[remap[a]].add(plane);
+			if (openNext[a] != b)
+				continue;
+			const glm::vec3& pa = positionAt(positions, stride, a);
+			glm::vec3 edge = positionAt(positions, stride, b) - pa;
+			glm::vec3 side = glm::cross(normal, edge);
+			float sideLength = glm::length(side);
+			if (sideLength == 0.0f)
+				continue;
+			side = side / sideLength;
+			Quadric edgePlane = Quadric::plane(side, -glm::dot(side, pa), glm::dot(edge, edge) * EDGE_WEIGHT);
+			quadrics[remap[a]].add(edgePlane);
+			quadrics[remap[b]].add(edgePlane);
+		}
+	}
+
+	// the vertex at to's position that from's seam twin moves to
+	auto twinTarget = [&](GLuint from, GLuint to) -> GLuint {
+		GLuint twin = wedge[from];
+		GLuint target = openNext[from] == to ? openPrev[twin] : openNext[twin];
+		return target != NONE && remap[target] == remap[to] ? target : NONE;
+	};
+	auto canCollapse = [&](GLuint from, GLuint to) -> bool {
+		if (remap[from] == remap[to])
+			return false;
+		bool alongOpenEdge = openNext[from] == to || openPrev[from] == to;
+		switch (kinds[from])
+		{
+		case MANIFOLD: return true;
+		case BORDER: return alongOpenEdge && (kinds[to] == BORDER || kinds[to] == LOCKED);
+		case SEAM: return alongOpenEdge && (kinds[to] == SEAM || kinds[to] == LOCKED) && twinTarget(from, to) != NONE;
+		default: return false;
+		}
+	};
+	auto collapseError = [&](const std::vector<Quadric>& planes, GLuint from, GLuint to) -> double {
+		const Quadric& a = planes[remap[from]];
+		const Quadric& b = planes[remap[to]];
+		double weight = a.weight + b.weight;
+		const glm::vec3& p = positionAt(positions, stride, to);
+		return weight > 0.0 ? std::fabs(a.evaluate(p) + b.evaluate(p)) / weight : 0.0;
+	};
+
+	// rebuilt from result every pass
+	Adjacency adjacency;
+	const std::vector<GLuint>& offsets = adjacency.offsets;
+	const std::vector<GLuint>& adjacent = adjacency.triangles;
+	std::vector<GLuint> target(vertexCount);
+	std::vector<bool> locked(vertexCount);
+	std::vector<Collapse> candidates;
+	double maxErrorSquared = maxError < FLT_MAX ? (double)maxError * maxError : DBL_MAX;
+	double worst = 0.0;
+
+	// false when collapsing from onto to would turn a triangle around from
+	// over; adds the triangles the collapse removes to removed
+	auto keptTriangles = [&](GLuint from, GLuint to, unsigned int& removed) -> bool {
+		const glm::vec3& destination = positionAt(positions, stride, to);
+		for (GLuint j = offsets[from]; j < offsets[from + 1]; j++)
+		{
+			const GLuint* triangle = &result[adjacent[j] * 3];
+			if (remap[triangle[0]] == remap[to] || remap[triangle[1]] == remap[to] || remap[triangle[2]] == remap[to])
+			{
+				removed++;
+				continue;
+			}
+			glm::vec3 before[3], after[3];
+			for (int k = 0; k < 3; k++)
+			{
+				before[k] = positionAt(positions, stride, triangle[k]);
+				after[k] = triangle[k] == from ? destination : before[k];
+			}
+			glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+			glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+			// more than about 75 degrees of turn is as good as a flip
+			if (glm::dot(n0, n1) <= 0.25f * glm::length(n0) * glm::length(n1))
+				return false;
+		}
+		return true;
+	};
+
+	while (result.size() > targetIndexCount)
+	{
+		GLuint triangleCount = (GLuint)(result.size() / 3);
+		adjacency.build(result.data(), (GLuint)result.size(), vertexCount);
+
+		// the cheaper way of collapsing each edge
+		candidates.clear();
+		for (size_t i = 0; i < result.size(); i++)
+		{
+			GLuint a = result[i], b = result[i - i % 3 + (i + 1) % 3];
+			bool forward = canCollapse(a, b), backward = canCollapse(b, a);
+			if (!forward && !backward)
+				continue;
+			double forwardError = forward ? collapseError(quadrics, a, b) : DBL_MAX;
+			double backwardError = backward ? collapseError(quadrics, b, a) : DBL_MAX;
+			Collapse collapse = forwardError <= backwardError ? Collapse{ a, b, forwardError } : Collapse{ b, a, backwardError };
+			candidates.push_back(collapse);
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+
+		// An independent set of collapses, cheapest first: everything around a
+		// collapse is locked for the rest of the pass, so the flip tests above
+		// stay true while the pass goes on.
+		for (GLuint v = 0; v < vertexCount; v++)
+		{
+			target[v] = v;
+			locked[v] = false;
+		}
+		GLuint needed = triangleCount - targetIndexCount / 3;
+		GLuint removedTotal = 0;
+		unsigned int collapses = 0;
+		for (const Collapse& collapse : candidates)
+		{
+			if (removedTotal >= needed || collapse.error > maxErrorSquared)
+				break;
+			GLuint from = collapse.from, to = collapse.to;
+			bool seam = kinds[from] == SEAM;
+			GLuint twin = seam ? wedge[from] : NONE;
+			GLuint twinTo = seam ? twinTarget(from, to) : NONE;
+			if (locked[from] || locked[to] || (seam && (locked[twin] || locked[twinTo])))
+				continue;
+			unsigned int removed = 0;
+			if (!keptTriangles(from, to, removed) || (seam && !keptTriangles(twin, twinTo, removed)))
+				continue;
+
+			target[from] = to;
+			if (seam)
+				target[twin] = twinTo;
+			for (GLuint moved : { from, twin })
+			{
+				if (moved == NONE)
+					continue;
+				for (GLuint j = offsets[moved]; j < offsets[moved + 1]; j++)
+				{
+					for (int k = 0; k < 3; k++)
+					{
+						GLuint v = result[adjacent[j] * 3 + k];
+						locked[v] = true;
+						locked[wedge[v]] = true;
+					}
+				}
+			}
+			worst = std::max(worst, collapseError(surfaces, from, to));
+			quadrics[remap[to]].add(quadrics[remap[from]]);
+			surfaces[remap[to]].add(surfaces[remap[from]]);
+			removedTotal += removed;
+			collapses++;
+		}
+		if (collapses == 0)
+			break;
+
+		// move the collapsed vertices and drop the triangles that lost their area
+		size_t kept = 0;
+		for (size_t t = 0; t < result.size(); t += 3)
+		{
+			GLuint a = target[result[t]], b = target[result[t + 1]], c = target[result[t + 2]];
+			if (remap[a] == remap[b] || remap[b] == remap[c] || remap[c] == remap[a])
+				continue;
+			result[kept++] = a;
+			result[kept++] = b;
+			result[kept++] = c;
+		}
+		result.resize(kept);
+	}
+
+	if (error != nullptr)
+		*error = (float)std::sqrt(worst);
+	return result;
+}
+
+std::vector<SimplifiedLevel> MeshSimplifier::buildChain(const GLuint* indices, GLuint indexCount, const glm::vec3* positions, size_t stride,
+	GLuint vertexCount, const float* ratios, unsigned int levelCount)
+{
+	std::vector<SimplifiedLevel> levels(levelCount);
+	for (unsigned int i = 0; i < levelCount; i++)
+	{
+		GLuint target = (GLuint)(indexCount / 3 * ratios[i]) * 3;
+		levels[i].ratio = ratios[i];
+		levels[i].indices = simplify(indices, indexCount, positions, stride, vertexCount, target, FLT_MAX, &levels[i].error);
+	}
+	return levels;
+}
+
+std::vector<SimplifiedLevel> MeshSimplifier::buildChain(const ShapeData& shape, const float* ratios, unsigned int levelCount)
+{
+	const glm::vec3* positions = shape.numVertices > 0 ? &shape.vertices[0].position : nullptr;
+	return buildChain(shape.indices, shape.numIndices, positions, sizeof(Vertex), shape.numVertices, ratios, levelCount);
+}
+
+std::vector<SimplifiedLevel> MeshSimplifier::cachedChain(const char* path, const GLuint* indices, GLuint indexCount, const glm::vec3* positions,
+	size_t stride, GLuint vertexCount, const float* ratios, unsigned int levelCount)
+{
+	uint64_t key = chainKey(indices, indexCount, positions, stride, vertexCount, ratios, levelCount);
+	std::vector<SimplifiedLevel> levels;
+	if (readChain(path, key, levels))
+		return levels;
+	levels = buildChain(indices, indexCount, positions, stride, vertexCount, ratios, levelCount);
+	writeChain(path, key, levels);
+	return levels;
+}
+
+std::vector<SimplifiedLevel> MeshSimplifier::cachedChain(const char* path, const ShapeData& shape, const float* ratios, unsigned int levelCount)
+{
+	const glm::vec3* positions = shape.numVertices > 0 ? &shape.vertices[0].position : nullptr;
+	return cachedChain(path, shape.indices, shape.numIndices, positions, sizeof(Vertex), shape.numVertices, ratios, levelCount);
+}
+
+ShapeData MeshSimplifier::extract(const ShapeData& shape, const SimplifiedLevel& level)
+{
+	std::vector<GLuint> newIndex(shape.numVertices, NONE);
+	GLuint used = 0;
+	for (GLuint v : level.indices)
+	{
+		if (newIndex[v] == NONE)
+			newIndex[v] = used++;
+	}
+
+	ShapeData result;
+	result.numVertices = used;
+	result.vertices = new Vertex[used];
+	for (GLuint v = 0; v < shape.numVertices; v++)
+	{
+		if (newIndex[v] != NONE)
+			result.vertices[newIndex[v]] = shape.vertices[v];
+	}
+	result.numIndices = (GLuint)level.indices.size();
+	result.indices = new GLuint[result.numIndices];
+	for (GLuint i = 0; i < result.numIndices; i++)
+		result.indices[i] = newIndex[level.indices[i]];
+	return result;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "ShapeData.h"
+
+const uint32_t LOD_FILE_VERSION = 1;
+
+// One level of a simplified mesh. The indices refer to the original mesh's
+// vertices, so every level of a chain can share its vertex buffer.
+struct SimplifiedLevel
+{
+	float ratio;                // triangles asked for, as a fraction of the original
+	float error;                // how far the surface may have moved, in mesh units
+	std::vector<GLuint> indices;
+};
+
+// Quadric error metric simplification (Garland and Heckbert) by half-edge
+// collapses: a vertex is merged into a neighbour and takes that neighbour's
+// position, normal and texture coordinates, so no attribute is ever
+// interpolated. The cheapest collapses by the error quadric of the removed
+// vertex go first, one independent set at a time.
+//
+// Vertices at the same position with different attributes (texture seams,
+// hard edges) are kept together: a seam vertex only moves along its seam, with
+// its twin on the other side moving to the matching twin, so seams never open.
+// Open borders only move along themselves and corners where several seams or
+// borders meet stay where they are. Collapses that would flip a triangle are
+// skipped.
+class MeshSimplifier
+{
+public:
+	// Removes triangles until at most targetIndexCount indices are left or the
+	// next collapse would move the surface further than maxError. Returns the
+	// new indices; error receives how far the surface has moved.
+	static std::vector<GLuint> simplify(const GLuint* indices, GLuint indexCount, const glm::vec3* positions, size_t stride, GLuint vertexCount,
+		GLuint targetIndexCount, float maxError, float* error);
+
+	// a level per ratio, each simplified from the original mesh; positions is
+	// the first vertex's position and stride the size of a whole vertex, so a
+	// Mesh's vertices can be passed as they are
+	static std::vector<SimplifiedLevel> buildChain(const GLuint* indices, GLuint indexCount, const glm::vec3* positions, size_t stride,
+		GLuint vertexCount, const float* ratios, unsigned int levelCount);
+	static std::vector<SimplifiedLevel> buildChain(const ShapeData& shape, const float* ratios, unsigned int levelCount);
+
+	// The same, read from a file at path when it holds the chain of this mesh
+	// and these ratios, and written there otherwise. The file is matched by a
+	// hash of the positions, indices and ratios, so a changed mesh is
+	// simplified again.
+	static std::vector<SimplifiedLevel> cachedChain(const char* path, const GLuint* indices, GLuint indexCount, const glm::vec3* positions,
+		size_t stride, GLuint vertexCount, const float* ratios, unsigned int levelCount);
+	static std::vector<SimplifiedLevel> cachedChain(const char* path, const ShapeData& shape, const float* ratios, unsigned int levelCount);
+
+	// a level as a shape of its own, holding only the vertices it uses
+	static ShapeData extract(const ShapeData& shape, const SimplifiedLevel& level);
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Helpers shared by the passes that walk an indexed mesh (MeshOptimizer,
+// Meshlets, MeshSimplifier). Internal to those .cpp files.
+
+// position of vertex v when the first vertex's position is at positions and a
+// whole vertex is stride bytes, so a ShapeData or a Mesh can be read as it is
+inline const glm::vec3& positionAt(const glm::vec3* positions, size_t stride, GLuint v)
+{
+	return *(const glm::vec3*)((const char*)positions + v * stride);
+}
+
+// the triangles using each vertex, as ranges of one array: those of v are
+// triangles[offsets[v]] up to triangles[offsets[v + 1]]
+struct Adjacency
+{
+	std::vector<GLuint> offsets;
+	std::vector<GLuint> counts;       // triangles using the vertex
+	std::vector<GLuint> triangles;
+
+	void build(const GLuint* indices, GLuint indexCount, GLuint vertexCount)
+	{
+		counts.assign(vertexCount, 0);
+		for (GLuint i = 0; i < indexCount; i++)
+			counts[indices[i]]++;
+		offsets.assign(vertexCount + 1, 0);
+		for (GLuint v = 0; v < vertexCount; v++)
+			offsets[v + 1] = offsets[v] + counts[v];
+		triangles.resize(indexCount);
+		std::vector<GLuint> fill(offsets.begin(), offsets.end() - 1);
+		for (GLuint i = 0; i < indexCount; i++)
+			triangles[fill[indices[i]]++] = i / 3;
+	}
+};
@@ -0,0 +1,252 @@
+#include "Meshlet.h"
+#include "MeshTopology.h"
+#include "Scene.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// a meshlet whose normals are all within about 84 degrees of the axis can
+	// still face away as a whole; a wider one never does
+	const float MIN_CONE_DOT = 0.1f;
+	// weight of facing the other way to the meshlet against one new vertex
+	const float CONE_WEIGHT = 1.0f;
+
+	// bounds and normal cone of triangles [first, first + count) of indices
+	void computeBounds(Meshlet& meshlet, const GLuint* indices, const glm::vec3* positions, size_t stride,
+		const std::vector<glm::vec3>& normals)
+	{
+		glm::vec3 min(0.0f), max(0.0f);
+		glm::vec3 axis(0.0f);
+		for (GLuint t = meshlet.firstTriangle; t < meshlet.firstTriangle + meshlet.triangleCount; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				const glm::vec3& p = positionAt(positions, stride, indices[t * 3 + k]);
+				min = t == meshlet.firstTriangle && k == 0 ? p : glm::min(min, p);
+				max = t == meshlet.firstTriangle && k == 0 ? p : glm::max(max, p);
+			}
+			axis += normals[t];
+		}
+		meshlet.center = (min + max) * 0.5f;
+		float radius = 0.0f;
+		for (GLuint i = meshlet.firstTriangle * 3; i < (meshlet.firstTriangle + meshlet.triangleCount) * 3; i++)
+			radius = std::max(radius, glm::length(positionAt(positions, stride, indices[i]) - meshlet.center));
+		meshlet.radius = radius;
+
+		float length = glm::length(axis);
+		meshlet.coneAxis = length > 0.0f ? axis / length : glm::vec3(0.0f, 0.0f, 1.0f);
+		float minDot = length > 0.0f ? 1.0f : -1.0f;
+		for (GLuint t = meshlet.firstTriangle; t < meshlet.firstTriangle + meshlet.triangleCount; t++)
+		{
+			// degenerate triangles face nowhere and are never seen
+			if (normals[t] != glm::vec3(0.0f))
+				minDot = std::min(minDot, glm::dot(meshlet.coneAxis, normals[t]));
+		}
+		meshlet.coneCutoff = minDot > MIN_CONE_DOT ? std::sqrt(1.0f - minDot * minDot) : 1.0f;
+	}
+}
+
+std::vector<Meshlet> Meshlets::build(ShapeData& shape, GLuint maxVertices, GLuint maxTriangles)
+{
+	const glm::vec3* positions = shape.numVertices > 0 ? &shape.vertices[0].position : nullptr;
+	return build(shape.indices, shape.numIndices, positions, sizeof(Vertex), shape.numVertices, maxVertices, maxTriangles);
+}
+
+std::vector<Meshlet> Meshlets::build(GLuint* indices, GLuint indexCount, const glm::vec3* positions, size_t stride, GLuint vertexCount,
+	GLuint maxVertices, GLuint maxTriangles)
+{
+	std::vector<Meshlet> meshlets;
+	GLuint triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return meshlets;
+
+	// unit normal of every triangle, zero for degenerate ones
+	std::vector<glm::vec3> normals(triangleCount);
+	for (GLuint t = 0; t < triangleCount; t++)
+	{
+		const glm::vec3& a = positionAt(positions, stride, indices[t * 3]);
+		glm::vec3 normal = glm::cross(positionAt(positions, stride, indices[t * 3 + 1]) - a, positionAt(positions, stride, indices[t * 3 + 2]) - a);
+		float length = glm::length(normal);
+		normals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+	}
+
+	Adjacency adjacency;
+	adjacency.build(indices, triangleCount * 3, vertexCount);
+	const std::vector<GLuint>& offsets = adjacency.offsets;
+	const std::vector<GLuint>& adjacent = adjacency.triangles;
+
+	// the meshlet each vertex was last added to, so membership is one compare
+	std::vector<GLuint> vertexMeshlet(vertexCount, ~0u);
+	std::vector<bool> used(triangleCount, false);
+	std::vector<GLuint> order;           // triangles in meshlet order
+	order.reserve(triangleCount);
+	std::vector<GLuint> meshletVertices;
+	GLuint nextUnused = 0;
+	GLuint seed = 0;
+
+	while (order.size() < triangleCount)
+	{
+		GLuint id = (GLuint)meshlets.size();
+		Meshlet meshlet = {};
+		meshlet.firstTriangle = (GLuint)order.size();
+		meshletVertices.clear();
+		glm::vec3 normalSum(0.0f);
+
+		GLuint next = seed;
+		while (true)
+		{
+			used[next] = true;
+			order.push_back(next);
+			for (int k = 0; k < 3; k++)
+			{
+				GLuint v = indices[next * 3 + k];
+				if (vertexMeshlet[v] != id)
+				{
+					vertexMeshlet[v] = id;
+					meshletVertices.push_back(v);
+				}
+			}
+			normalSum += normals[next];
+			meshlet.triangleCount++;
+			if (meshlet.triangleCount == maxTriangles)
+				break;
+
+			// the cheapest unused triangle around the meshlet's vertices that fits
+			glm::vec3 axis = glm::length(normalSum) > 0.0f ? glm::normalize(normalSum) : glm::vec3(0.0f);
+			float bestCost = 0.0f;
+			bool found = false;
+			for (GLuint v : meshletVertices)
+			{
+				for (GLuint j = offsets[v]; j < offsets[v + 1]; j++)
+				{
+					GLuint t = adjacent[j];
+					if (used[t])
+						continue;
+					GLuint added = 0;
+					for (int k = 0; k < 3; k++)
+						added += vertexMeshlet[indices[t * 3 + k]] != id ? 1 : 0;
+					if (meshletVertices.size() + added > maxVertices)
+						continue;
+					float cost = added + CONE_WEIGHT * (1.0f - glm::dot(axis, normals[t]));
+					if (!found || cost < bestCost)
+					{
+						bestCost = cost;
+						next = t;
+						found = true;
+					}
+				}
+			}
+			if (!found)
+				break;
+		}
+		meshlet.vertexCount = (GLuint)meshletVertices.size();
+		meshlets.push_back(meshlet);
+
+		// the next meshlet starts next to this one when it can, which keeps the
+		// index order close to the original for the vertex cache
+		bool seeded = false;
+		for (size_t i = 0; i < meshletVertices.size() && !seeded; i++)
+		{
+			GLuint v = meshletVertices[i];
+			for (GLuint j = offsets[v]; j < offsets[v + 1] && !seeded; j++)
+			{
+				if (!used[adjacent[j]])
+				{
+					seed = adjacent[j];
+					seeded = true;
+				}
+			}
+		}
+		while (!seeded && nextUnused < triangleCount)
+		{
+			if (!used[nextUnused])
+			{
+				seed = nextUnused;
+				seeded = true;
+			}
+			nextUnused++;
+		}
+	}
+
+	std::vector<GLuint> reordered(triangleCount * 3);
+	std::vector<glm::vec3> orderedNormals(triangleCount);
+	for (GLuint t = 0; t < triangleCount; t++)
+	{
+		std::copy(indices + order[t] * 3, indices + order[t] * 3 + 3, reordered.begin() + t * 3);
+		orderedNormals[t] = normals[order[t]];
+	}
+	std::copy(reordered.begin(), reordered.end(), indices);
+	for (Meshlet& meshlet : meshlets)
+		computeBounds(meshlet, indices, positions, stride, orderedNormals);
+	return meshlets;
+}
+
+void Meshlets::cull(const std::vector<Meshlet>& meshlets, const MeshDraw& mesh, const glm::mat4& model,
+	const Frustum& frustum, const glm::vec3& eye, std::vector<MeshDraw>& draws, MeshletCullStats& stats)
+{
+	// Both tests run in the shape's space. A plane p of the frustum becomes
+	// transpose(model) * p there, renormalized so distances are in shape units;
+	// which side of a triangle the eye is on does not change under an affine map
+	// that does not mirror, so the cone is tested against the eye taken into the
+	// shape's space.
+	glm::mat4 transposed = glm::transpose(model);
+	glm::vec4 planes[6];
+	for (int i = 0; i < 6; i++)
+	{
+		planes[i] = transposed * frustum.planes[i];
+		float length = glm::length(glm::vec3(planes[i]));
+		if (length > 0.0f)
+			planes[i] = planes[i] * (1.0f / length);
+	}
+	glm::vec3 localEye = glm::vec3(glm::inverse(model) * glm::vec4(eye, 1.0f));
+
+	GLuint runStart = 0, runCount = 0;
+	for (const Meshlet& meshlet : meshlets)
+	{
+		stats.meshlets++;
+		stats.triangles += meshlet.triangleCount;
+
+		bool offscreen = false;
+		for (int i = 0; i < 6 && !offscreen; i++)
+			offscreen = glm::dot(glm::vec3(planes[i]), meshlet.center) + planes[i].w < -meshlet.radius;
+		glm::vec3 toCenter = meshlet.center - localEye;
+		bool backfacing = !offscreen &&
+			glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+
+		if (offscreen || backfacing)
+		{
+			if (offscreen)
+				stats.offscreenTriangles += meshlet.triangleCount;
+			else
+				stats.backfacingTriangles += meshlet.triangleCount;
+			continue;
+		}
+		if (runCount > 0 && runStart + runCount == meshlet.firstTriangle)
+		{
+			runCount += meshlet.triangleCount;
+			continue;
+		}
+		if (runCount > 0)
+		{
+			draws.push_back(range(mesh, runStart, runCount));
+			stats.ranges++;
+		}
+		runStart = meshlet.firstTriangle;
+		runCount = meshlet.triangleCount;
+	}
+	if (runCount > 0)
+	{
+		draws.push_back(range(mesh, runStart, runCount));
+		stats.ranges++;
+	}
+}
+
+MeshDraw Meshlets::range(const MeshDraw& mesh, GLuint firstTriangle, GLuint triangleCount)
+{
+	size_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	MeshDraw part = mesh;
+	part.count = (GLsizei)(triangleCount * 3);
+	part.indices = (const void*)((const char*)mesh.indices + firstTriangle * 3 * indexSize);
+	return part;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "FrustumCuller.h"
+#include "GeometryBuffer.h"
+#include "ShapeData.h"
+
+// A run of consecutive triangles of a shape's index order, small enough to be
+// culled on its own: a bounding sphere for the frustum and a cone around its
+// triangles' normals for back faces. Everything is in the shape's own space.
+struct Meshlet
+{
+	glm::vec3 center;
+	float radius;
+	glm::vec3 coneAxis;
+	// sine of the widest angle between coneAxis and a triangle normal; 1 for
+	// meshlets whose normals spread too far to ever face away as a whole
+	float coneCutoff;
+	GLuint firstTriangle;
+	GLuint triangleCount;
+	GLuint vertexCount;     // distinct vertices
+};
+
+// triangles and meshlets looked at by cull(), and how many triangles each test
+// dropped
+struct MeshletCullStats
+{
+	unsigned int meshlets = 0;
+	unsigned int triangles = 0;
+	unsigned int backfacingTriangles = 0;
+	unsigned int offscreenTriangles = 0;
+	unsigned int ranges = 0;            // draws handed out
+
+	float culledFraction() const { return triangles > 0 ? (float)(backfacingTriangles + offscreenTriangles) / triangles : 0.0f; }
+};
+
+class Meshlets
+{
+public:
+	// about what a mesh shader workgroup takes, and small enough that a cluster
+	// on a curved surface has a narrow normal cone
+	static const GLuint MAX_VERTICES = 64;
+	static const GLuint MAX_TRIANGLES = 124;
+
+	// Reorders the triangles in place so each meshlet is a contiguous run of the
+	// index order. Meshlets are grown from a seed triangle by adding the
+	// neighbouring triangle that brings in the fewest new vertices, preferring
+	// ones that face the same way as the meshlet so far, until either limit is
+	// reached or no neighbour fits. Vertices are not touched; a vertex on a
+	// border belongs to every meshlet around it.
+	static std::vector<Meshlet> build(ShapeData& shape, GLuint maxVertices = MAX_VERTICES, GLuint maxTriangles = MAX_TRIANGLES);
+	// the same for any indexed mesh, e.g. a Mesh: positions is the first vertex's
+	// position and stride the size of a whole vertex
+	static std::vector<Meshlet> build(GLuint* indices, GLuint indexCount, const glm::vec3* positions, size_t stride, GLuint vertexCount,
+		GLuint maxVertices = MAX_VERTICES, GLuint maxTriangles = MAX_TRIANGLES);
+
+	// Appends to draws the parts of mesh, drawn with model, that can be seen from
+	// eye: meshlets outside the frustum or facing away from the eye are dropped,
+	// and each run of consecutive survivors becomes one draw. The tests run in the
+	// shape's space, so model may scale unevenly, but must not mirror. The draws
+	// are for a multi-draw batch with model as each one's matrix.
+	static void cull(const std::vector<Meshlet>& meshlets, const MeshDraw& mesh, const glm::mat4& model,
+		const Frustum& frustum, const glm::vec3& eye, std::vector<MeshDraw>& draws, MeshletCullStats& stats);
+
+	// the draw for triangles [firstTriangle, firstTriangle + triangleCount) of mesh
+	static MeshDraw range(const MeshDraw& mesh, GLuint firstTriangle, GLuint triangleCount);
+};
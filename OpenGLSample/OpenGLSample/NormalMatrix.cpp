@@ -0,0 +1,83 @@
+#include "NormalMatrix.h"
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define NORMAL_MATRIX_SSE
+#include <xmmintrin.h>
+#endif
+
+// With a, b, c the columns of the 3x3, inverse(M)^T has the columns
+// b x c, c x a and a x b, all divided by det(M) = a . (b x c).
+glm::mat3 normalMatrix(const glm::mat4& model)
+{
+	glm::vec3 a = glm::vec3(model[0]);
+	glm::vec3 b = glm::vec3(model[1]);
+	glm::vec3 c = glm::vec3(model[2]);
+	glm::vec3 bc = glm::cross(b, c);
+	float invDet = 1.0f / glm::dot(a, bc);
+	return glm::mat3(bc * invDet, glm::cross(c, a) * invDet, glm::cross(a, b) * invDet);
+}
+
+#ifdef NORMAL_MATRIX_SSE
+namespace
+{
+	// SoA cross product: each register holds one component of four vectors
+	inline void cross4(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz,
+		__m128& rx, __m128& ry, __m128& rz)
+	{
+		rx = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+		ry = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+		rz = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+	}
+}
+#endif
+
+void computeNormalMatrices(const glm::mat4* models, glm::mat3* normals, size_t count)
+{
+	size_t i = 0;
+#ifdef NORMAL_MATRIX_SSE
+	for (; i + 4 <= count; i += 4)
+	{
+		// load column k of four matrices and transpose, giving x, y, z of that
+		// column for all four in separate registers
+		__m128 x[3], y[3], z[3];
+		for (int k = 0; k < 3; k++)
+		{
+			__m128 r0 = _mm_loadu_ps(&models[i + 0][k][0]);
+			__m128 r1 = _mm_loadu_ps(&models[i + 1][k][0]);
+			__m128 r2 = _mm_loadu_ps(&models[i + 2][k][0]);
+			__m128 r3 = _mm_loadu_ps(&models[i + 3][k][0]);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			x[k] = r0;
+			y[k] = r1;
+			z[k] = r2;
+		}
+
+		__m128 nx[3], ny[3], nz[3];
+		cross4(x[1], y[1], z[1], x[2], y[2], z[2], nx[0], ny[0], nz[0]); // b x c
+		cross4(x[2], y[2], z[2], x[0], y[0], z[0], nx[1], ny[1], nz[1]); // c x a
+		cross4(x[0], y[0], z[0], x[1], y[1], z[1], nx[2], ny[2], nz[2]); // a x b
+		__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x[0], nx[0]), _mm_mul_ps(y[0], ny[0])), _mm_mul_ps(z[0], nz[0]));
+		__m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+		for (int k = 0; k < 3; k++)
+		{
+			__m128 r0 = _mm_mul_ps(nx[k], invDet);
+			__m128 r1 = _mm_mul_ps(ny[k], invDet);
+			__m128 r2 = _mm_mul_ps(nz[k], invDet);
+			__m128 r3 = _mm_setzero_ps();
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			// glm::mat3 columns are 3 floats, so store through a padded temporary
+			float column[4][4];
+			_mm_storeu_ps(column[0], r0);
+			_mm_storeu_ps(column[1], r1);
+			_mm_storeu_ps(column[2], r2);
+			_mm_storeu_ps(column[3], r3);
+			for (int m = 0; m < 4; m++)
+				memcpy(&normals[i + m][k][0], column[m], sizeof(float) * 3);
+		}
+	}
+#endif
+	for (; i < count; i++)
+		normals[i] = normalMatrix(models[i]);
+}
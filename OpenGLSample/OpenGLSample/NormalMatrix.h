@@ -0,0 +1,14 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+
+// The matrix that takes object-space normals to world space: the inverse
+// transpose of the model matrix's upper 3x3. The lighting shaders used to build
+// it per vertex with inverse(); it is now computed here once per object.
+
+// one matrix, scalar
+glm::mat3 normalMatrix(const glm::mat4& model);
+
+// count matrices at a time; with SSE four are computed per iteration, the
+// remainder falls back to normalMatrix()
+void computeNormalMatrices(const glm::mat4* models, glm::mat3* normals, size_t count);
@@ -0,0 +1,306 @@
+#include "OcclusionCuller.h"
+#include "Scene.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define OCCLUSION_CULLER_SSE
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const int BAND_ROWS = 8;
+	const unsigned int OBJECTS_PER_TASK = 64;
+
+	// the twelve triangles of a box, wound counter-clockwise seen from outside;
+	// corner i has x from bit 0, y from bit 1 and z from bit 2
+	const int BOX_TRIANGLES[12][3] = {
+		{ 0, 2, 3 }, { 0, 3, 1 },   // -z
+		{ 4, 5, 7 }, { 4, 7, 6 },   // +z
+		{ 0, 4, 6 }, { 0, 6, 2 },   // -x
+		{ 1, 3, 7 }, { 1, 7, 5 },   // +x
+		{ 0, 1, 5 }, { 0, 5, 4 },   // -y
+		{ 2, 6, 7 }, { 2, 7, 3 },   // +y
+	};
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double millisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	glm::vec3 toScreen(const glm::vec4& clip)
+	{
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		return glm::vec3((ndc.x * 0.5f + 0.5f) * OcclusionCuller::WIDTH, (ndc.y * 0.5f + 0.5f) * OcclusionCuller::HEIGHT, ndc.z * 0.5f + 0.5f);
+	}
+
+	// a triangle in screen space with its depth plane; false for back faces and
+	// triangles with no area
+	bool setupTriangle(glm::vec3 a, glm::vec3 b, glm::vec3 c, bool mirrored, OcclusionCuller::Triangle& triangle)
+	{
+		float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+		if ((area > 0.0f) == mirrored || std::fabs(area) < 1e-6f)
+			return false;
+		if (area < 0.0f)
+		{
+			std::swap(b, c);
+			area = -area;
+		}
+		triangle.x[0] = a.x; triangle.x[1] = b.x; triangle.x[2] = c.x;
+		triangle.y[0] = a.y; triangle.y[1] = b.y; triangle.y[2] = c.y;
+		// depth = depthX * x + depthY * y + depthC through the three corners
+		triangle.depthX = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / area;
+		triangle.depthY = ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) / area;
+		triangle.depthC = a.z - triangle.depthX * a.x - triangle.depthY * a.y;
+		return true;
+	}
+
+	// the part of a clip-space triangle in front of the near plane (z >= -w), as
+	// a polygon of up to four corners
+	int clipNear(const glm::vec4* in, glm::vec4* out)
+	{
+		int count = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			const glm::vec4& p = in[i];
+			const glm::vec4& q = in[(i + 1) % 3];
+			float dp = p.z + p.w;
+			float dq = q.z + q.w;
+			if (dp >= 0.0f)
+				out[count++] = p;
+			if ((dp >= 0.0f) != (dq >= 0.0f))
+				out[count++] = p + (q - p) * (dp / (dp - dq));
+		}
+		return count;
+	}
+
+	// edge i -> j as a * x + b * y + c, positive inside a counter-clockwise triangle
+	struct Edge
+	{
+		float a, b, c;
+	};
+
+	Edge makeEdge(float xi, float yi, float xj, float yj)
+	{
+		Edge edge = { yi - yj, xj - xi, (yj - yi) * xi - (xj - xi) * yi };
+		return edge;
+	}
+}
+
+void OcclusionCuller::addOccluder(const Aabb& local, const glm::mat4& world)
+{
+	Occluder occluder;
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec3 corner((i & 1) ? local.max.x : local.min.x, (i & 2) ? local.max.y : local.min.y, (i & 4) ? local.max.z : local.min.z);
+		occluder.corners[i] = glm::vec3(world * glm::vec4(corner, 1.0f));
+	}
+	occluders.push_back(occluder);
+}
+
+void OcclusionCuller::clearOccluders()
+{
+	occluders.clear();
+	occluderTriangles.clear();
+	triangles.clear();
+}
+
+void OcclusionCuller::render(const glm::mat4& matrix, ThreadPool& pool)
+{
+	viewProjection = matrix;
+
+	// setup: corners to clip space, near clipping, back faces dropped
+	Clock::time_point start = Clock::now();
+	occluderTriangles.resize(occluders.size());
+	pool.parallelFor((unsigned int)occluders.size(), [this](unsigned int i) {
+		std::vector<Triangle>& out = occluderTriangles[i];
+		out.clear();
+		glm::vec4 clip[8];
+		for (int c = 0; c < 8; c++)
+			clip[c] = viewProjection * glm::vec4(occluders[i].corners[c], 1.0f);
+		// a mirrored corner order turns the box inside out
+		const glm::vec3* p = occluders[i].corners;
+		bool mirrored = glm::dot(glm::cross(p[1] - p[0], p[2] - p[0]), p[4] - p[0]) < 0.0f;
+		for (const int* corner : BOX_TRIANGLES)
+		{
+			glm::vec4 in[3] = { clip[corner[0]], clip[corner[1]], clip[corner[2]] };
+			glm::vec4 polygon[4];
+			int count = clipNear(in, polygon);
+			Triangle triangle;
+			for (int k = 2; k < count; k++)
+				if (setupTriangle(toScreen(polygon[0]), toScreen(polygon[k - 1]), toScreen(polygon[k]), mirrored, triangle))
+					out.push_back(triangle);
+		}
+	});
+	triangles.clear();
+	for (const std::vector<Triangle>& out : occluderTriangles)
+		triangles.insert(triangles.end(), out.begin(), out.end());
+	setupMs = millisecondsSince(start);
+
+	// rasterization, one band of rows per task, then the pyramid
+	start = Clock::now();
+	if (levels.empty())
+	{
+		for (int w = WIDTH, h = HEIGHT;; w = std::max(w / 2, 1), h = std::max(h / 2, 1))
+		{
+			levels.push_back(std::vector<float>(w * h, 1.0f));
+			if (w == 1 && h == 1)
+				break;
+		}
+	}
+	pool.parallelFor(HEIGHT / BAND_ROWS, [this](unsigned int band) {
+		rasterizeBand(band * BAND_ROWS, (band + 1) * BAND_ROWS);
+	});
+	buildPyramid();
+	rasterMs = millisecondsSince(start);
+}
+
+void OcclusionCuller::rasterizeBand(int firstRow, int endRow)
+{
+	float* buffer = levels[0].data();
+	std::fill(buffer + firstRow * WIDTH, buffer + endRow * WIDTH, 1.0f);
+
+	for (const Triangle& triangle : triangles)
+	{
+		// rows and columns whose pixel centers can lie inside
+		float minX = std::min(std::min(triangle.x[0], triangle.x[1]), triangle.x[2]);
+		float maxX = std::max(std::max(triangle.x[0], triangle.x[1]), triangle.x[2]);
+		float minY = std::min(std::min(triangle.y[0], triangle.y[1]), triangle.y[2]);
+		float maxY = std::max(std::max(triangle.y[0], triangle.y[1]), triangle.y[2]);
+		int rowStart = std::max(firstRow, (int)std::ceil(minY - 0.5f));
+		int rowEnd = std::min(endRow, (int)std::floor(maxY - 0.5f) + 1);
+		int colStart = std::max(0, (int)std::ceil(minX - 0.5f));
+		int colEnd = std::min(WIDTH, (int)std::floor(maxX - 0.5f) + 1);
+		if (rowStart >= rowEnd || colStart >= colEnd)
+			continue;
+
+		Edge edges[3] = {
+			makeEdge(triangle.x[0], triangle.y[0], triangle.x[1], triangle.y[1]),
+			makeEdge(triangle.x[1], triangle.y[1], triangle.x[2], triangle.y[2]),
+			makeEdge(triangle.x[2], triangle.y[2], triangle.x[0], triangle.y[0]),
+		};
+#ifdef OCCLUSION_CULLER_SSE
+		// four pixels at a time from a 4-aligned column; the pixels outside the
+		// bounding box fail the edge tests like any other outside pixel, and WIDTH
+		// is a multiple of four so no block runs past the row
+		colStart &= ~3;
+		__m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		__m128 zero = _mm_setzero_ps();
+		for (int row = rowStart; row < rowEnd; row++)
+		{
+			float y = row + 0.5f;
+			float* line = buffer + row * WIDTH;
+			for (int col = colStart; col < colEnd; col += 4)
+			{
+				__m128 x = _mm_add_ps(_mm_set1_ps((float)col), offsets);
+				__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+				for (const Edge& edge : edges)
+				{
+					__m128 e = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edge.a), x), _mm_set1_ps(edge.b * y + edge.c));
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(e, zero));
+				}
+				__m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.depthX), x), _mm_set1_ps(triangle.depthY * y + triangle.depthC));
+				__m128 old = _mm_loadu_ps(line + col);
+				__m128 nearer = _mm_min_ps(old, depth);
+				_mm_storeu_ps(line + col, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+			}
+		}
+#else
+		for (int row = rowStart; row < rowEnd; row++)
+		{
+			float y = row + 0.5f;
+			float* line = buffer + row * WIDTH;
+			for (int col = colStart; col < colEnd; col++)
+			{
+				float x = col + 0.5f;
+				bool inside = true;
+				for (const Edge& edge : edges)
+					inside = inside && edge.a * x + edge.b * y + edge.c >= 0.0f;
+				if (inside)
+					line[col] = std::min(line[col], triangle.depthX * x + triangle.depthY * y + triangle.depthC);
+			}
+		}
+#endif
+	}
+}
+
+void OcclusionCuller::buildPyramid()
+{
+	int width = WIDTH, height = HEIGHT;
+	for (size_t level = 1; level < levels.size(); level++)
+	{
+		const float* source = levels[level - 1].data();
+		float* target = levels[level].data();
+		int w = std::max(width / 2, 1), h = std::max(height / 2, 1);
+		for (int y = 0; y < h; y++)
+		{
+			int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+			for (int x = 0; x < w; x++)
+			{
+				int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+				target[y * w + x] = std::max(std::max(source[y0 * width + x0], source[y0 * width + x1]),
+					std::max(source[y1 * width + x0], source[y1 * width + x1]));
+			}
+		}
+		width = w;
+		height = h;
+	}
+}
+
+bool OcclusionCuller::isVisible(const Aabb& box) const
+{
+	if (levels.empty())
+		return true;
+	glm::vec3 screenMin(INFINITY), screenMax(-INFINITY);
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec3 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+		glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+		// reaching past the near plane: the camera may be inside it
+		if (clip.z < -clip.w)
+			return true;
+		glm::vec3 screen = toScreen(clip);
+		screenMin = glm::min(screenMin, screen);
+		screenMax = glm::max(screenMax, screen);
+	}
+	// off screen is the frustum test's business
+	if (screenMax.x < 0.0f || screenMax.y < 0.0f || screenMin.x >= WIDTH || screenMin.y >= HEIGHT)
+		return true;
+	int x0 = std::max(0, (int)screenMin.x), x1 = std::min(WIDTH - 1, (int)screenMax.x);
+	int y0 = std::max(0, (int)screenMin.y), y1 = std::min(HEIGHT - 1, (int)screenMax.y);
+
+	// the first level where the rectangle spans at most 2x2 texels
+	size_t level = 0;
+	while (level + 1 < levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+		level++;
+	int width = std::max(WIDTH >> level, 1);
+	const float* texels = levels[level].data();
+	for (int y = y0 >> level; y <= (y1 >> level); y++)
+		for (int x = x0 >> level; x <= (x1 >> level); x++)
+			if (screenMin.z <= texels[y * width + x])
+				return true;
+	return false;
+}
+
+void OcclusionCuller::filter(std::vector<uint32_t>& objects, const Aabb* worldBounds, ThreadPool& pool)
+{
+	Clock::time_point start = Clock::now();
+	std::vector<uint8_t> visible(objects.size());
+	unsigned int tasks = (unsigned int)((objects.size() + OBJECTS_PER_TASK - 1) / OBJECTS_PER_TASK);
+	pool.parallelFor(tasks, [&](unsigned int task) {
+		size_t end = std::min(objects.size(), (size_t)(task + 1) * OBJECTS_PER_TASK);
+		for (size_t i = task * OBJECTS_PER_TASK; i < end; i++)
+			visible[i] = isVisible(worldBounds[objects[i]]);
+	});
+	size_t kept = 0;
+	for (size_t i = 0; i < objects.size(); i++)
+		if (visible[i])
+			objects[kept++] = objects[i];
+	objects.resize(kept);
+	testMs = millisecondsSince(start);
+}
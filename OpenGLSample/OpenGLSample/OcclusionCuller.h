@@ -0,0 +1,76 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+struct Aabb;
+
+// Occlusion culling against a small depth buffer drawn on the CPU. A few large,
+// solid objects (walls, floors, stair blocks) are registered as occluders; every
+// frame their boxes are rasterized at low resolution, a max-depth pyramid is
+// built over the result, and object bounds are tested against it. An object
+// whose nearest point lies behind the farthest occluder depth over its whole
+// screen rectangle cannot be seen.
+//
+// Occluders are boxes: a local box and a world matrix, so they must really fill
+// that box. Cubes and planes do; spheres and cylinders should not be used.
+// The screen is split into bands rasterized in parallel, four pixels at a time
+// with SSE2 where available.
+class OcclusionCuller
+{
+public:
+	static const int WIDTH = 256;
+	static const int HEIGHT = 128;
+
+	void addOccluder(const Aabb& localBounds, const glm::mat4& world);
+	void clearOccluders();
+	size_t occluderCount() const { return occluders.size(); }
+
+	// transform, clip and rasterize the occluders, then build the depth pyramid
+	void render(const glm::mat4& viewProjection, ThreadPool& pool);
+
+	// false when the box is certainly hidden; needs render() first
+	bool isVisible(const Aabb& worldBox) const;
+	// drops the hidden objects from the list, keeping the order
+	void filter(std::vector<uint32_t>& objects, const Aabb* worldBounds, ThreadPool& pool);
+
+	// last frame's work, for the stats line
+	unsigned int triangleCount() const { return (unsigned int)triangles.size(); }
+	double setupMilliseconds() const { return setupMs; }
+	double rasterMilliseconds() const { return rasterMs; }
+	double testMilliseconds() const { return testMs; }
+
+	// depth in [0, 1] per pixel, row 0 at the bottom; 1 where no occluder was drawn
+	const float* depth() const { return levels.empty() ? nullptr : levels[0].data(); }
+
+	// screen-space triangle with depth as a plane over x and y
+	struct Triangle
+	{
+		float x[3];
+		float y[3];
+		float depthX, depthY, depthC;
+	};
+
+private:
+	struct Occluder
+	{
+		glm::vec3 corners[8];
+	};
+
+	void rasterizeBand(int firstRow, int endRow);
+	void buildPyramid();
+
+	std::vector<Occluder> occluders;
+	std::vector<std::vector<Triangle>> occluderTriangles;   // per occluder, from setup
+	std::vector<Triangle> triangles;
+	glm::mat4 viewProjection = glm::mat4(1.0f);
+
+	// levels[0] is the depth buffer; each later level holds the farthest depth of
+	// a 2x2 square of the one before, down to a single texel
+	std::vector<std::vector<float>> levels;
+
+	double setupMs = 0.0;
+	double rasterMs = 0.0;
+	double testMs = 0.0;
+};
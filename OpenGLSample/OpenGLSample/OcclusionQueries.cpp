@@ -0,0 +1,117 @@
+#include "OcclusionQueries.h"
+#include "RenderStats.h"
+#include "Scene.h"
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+	const Uniform<glm::mat4> MODEL_UNIFORM("model");
+
+	// boxes this close to the eye may be cut by the near plane and report no
+	// samples while the group is in plain view
+	const float NEAR_MARGIN = 0.2f;
+	// a group of flat objects still needs a box with volume to draw
+	const float BOX_PADDING = 0.01f;
+}
+
+OcclusionQueries::OcclusionQueries() :
+	frame(0)
+{
+}
+
+void OcclusionQueries::create(unsigned int groupCount)
+{
+	cleanup();
+	groups.resize(groupCount);
+	std::vector<GLuint> names(groupCount);
+	if (groupCount > 0)
+		glGenQueries(groupCount, names.data());
+	for (unsigned int i = 0; i < groupCount; i++)
+		groups[i].query = names[i];
+}
+
+void OcclusionQueries::setBounds(unsigned int group, const Aabb& bounds)
+{
+	groups[group].min = bounds.min - BOX_PADDING;
+	groups[group].max = bounds.max + BOX_PADDING;
+}
+
+void OcclusionQueries::beginFrame(const glm::vec3& eye)
+{
+	frame++;
+	for (Group& group : groups)
+	{
+		if (group.pending)
+		{
+			GLuint available = GL_FALSE;
+			glGetQueryObjectuiv(group.query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available)
+			{
+				GLuint samples = 0;
+				glGetQueryObjectuiv(group.query, GL_QUERY_RESULT, &samples);
+				group.pending = false;
+				group.visible = samples > 0;
+				if (group.visible)
+					group.visibleSamples = samples;
+				group.resultFrame = frame;
+				renderStats().queryResults++;
+				renderStats().queryLatencyFrames += frame - group.issuedFrame;
+			}
+		}
+
+		glm::vec3 low = group.min - NEAR_MARGIN, high = group.max + NEAR_MARGIN;
+		bool eyeInside = eye.x >= low.x && eye.y >= low.y && eye.z >= low.z
+			&& eye.x <= high.x && eye.y <= high.y && eye.z <= high.z;
+		if (eyeInside)
+		{
+			group.due = false;
+			group.conditional = false;
+			group.visible = true;
+			continue;
+		}
+		// one query in flight per group; occluded groups are re-queried as soon
+		// as their result is in, visible ones every few frames
+		unsigned int interval = group.visible ? VISIBLE_REQUERY_INTERVAL : 1;
+		group.due = !group.pending && (!group.everIssued || frame - group.resultFrame >= interval);
+		group.conditional = group.everIssued && !group.visible;
+		if (group.conditional)
+		{
+			renderStats().groupsConditional++;
+			renderStats().fragmentsAvoided += group.visibleSamples;
+		}
+	}
+}
+
+void OcclusionQueries::issue(const Shader& shader, const MeshDraw& box, const Aabb& boxBounds)
+{
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	glBindVertexArray(box.vao);
+	glm::vec3 boxSize = boxBounds.max - boxBounds.min;
+	for (Group& group : groups)
+	{
+		if (!group.due)
+			continue;
+		// boxBounds stretched onto the group's bounds
+		glm::vec3 scale = (group.max - group.min) / boxSize;
+		glm::mat4 model = glm::translate(glm::mat4(1.0f), group.min - boxBounds.min * scale);
+		shader.set(MODEL_UNIFORM, glm::scale(model, scale) * box.positionTransform());
+
+		glBeginQuery(GL_SAMPLES_PASSED, group.query);
+		glDrawElementsBaseVertex(GL_TRIANGLES, box.count, box.indexType, box.indices, box.baseVertex);
+		glEndQuery(GL_SAMPLES_PASSED);
+		group.pending = true;
+		group.everIssued = true;
+		group.issuedFrame = frame;
+		renderStats().queriesIssued++;
+	}
+	glDepthMask(GL_TRUE);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void OcclusionQueries::cleanup()
+{
+	for (Group& group : groups)
+		glDeleteQueries(1, &group.query);
+	groups.clear();
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "GeometryBuffer.h"
+#include "shader.h"
+
+struct Aabb;
+
+// GPU occlusion queries for groups of objects, such as one rail post or one
+// flight of stairs. After the opaque draws each group's bounding box is drawn
+// with color and depth writes off inside a GL_SAMPLES_PASSED query; the group's
+// draws of a later frame are wrapped in glBeginConditionalRender on that query,
+// so the GPU skips them when the box was hidden and the CPU never waits.
+//
+// Results are read back only once available, to drive the policy: a group
+// whose last result was visible is drawn unconditionally and checked again
+// every VISIBLE_REQUERY_INTERVAL frames; an occluded group is drawn on the
+// condition and queried again every frame, so it comes back one query latency
+// after it is uncovered. A group whose box holds the eye is always drawn.
+class OcclusionQueries
+{
+public:
+	static const unsigned int VISIBLE_REQUERY_INTERVAL = 4;
+
+	OcclusionQueries();
+
+	// one query object per group; call again to change the group count
+	void create(unsigned int groupCount);
+	void setBounds(unsigned int group, const Aabb& bounds);
+	unsigned int groupCount() const { return (unsigned int)groups.size(); }
+
+	// reads every result that is ready without waiting and decides which groups
+	// are queried and which are drawn on a condition this frame
+	void beginFrame(const glm::vec3& eye);
+
+	// query to make the group's draws conditional on this frame, 0 for none
+	GLuint condition(unsigned int group) const { return groups[group].conditional ? groups[group].query : 0; }
+
+	// draws the boxes of the groups due for a query. box is a shape in the
+	// geometry buffer with boxBounds as its own bounds; shader must be in use
+	// with view and projection set. Call after the opaque draws, so the depth
+	// buffer holds everything that can hide a group.
+	void issue(const Shader& shader, const MeshDraw& box, const Aabb& boxBounds);
+
+	void cleanup();
+
+private:
+	struct Group
+	{
+		GLuint query = 0;
+		glm::vec3 min = glm::vec3(0.0f);
+		glm::vec3 max = glm::vec3(0.0f);
+		bool pending = false;           // issued, result not read yet
+		bool everIssued = false;
+		unsigned int issuedFrame = 0;
+		unsigned int resultFrame = 0;
+		bool visible = true;            // last result read
+		GLuint visibleSamples = 0;      // box samples the last time it was visible
+		bool due = false;               // query this frame
+		bool conditional = false;       // draw on the query this frame
+	};
+
+	std::vector<Group> groups;
+	unsigned int frame;
+};
@@ -0,0 +1,202 @@
+#include "RenderQueue.h"
+#include "RenderStats.h"
+#include "NormalMatrix.h"
+#include <algorithm>
+
+namespace
+{
+	const Uniform<glm::mat4> MODEL_UNIFORM("model");
+	const Uniform<glm::mat3> NORMAL_MATRIX_UNIFORM("normalMatrix");
+
+	const int DEPTH_BITS = 24;
+	const uint64_t DEPTH_MAX = (1ull << DEPTH_BITS) - 1;
+}
+
+RenderQueue::RenderQueue() :
+	eye(0.0f), farPlane(100.0f), condition(0)
+{
+}
+
+void RenderQueue::begin(const glm::vec3& eye, float farPlane)
+{
+	this->eye = eye;
+	this->farPlane = farPlane;
+	condition = 0;
+	commands.clear();
+	items.clear();
+}
+
+void RenderQueue::submit(const Shader& shader, const MeshDraw& mesh, GLuint texture, const glm::mat4& model, bool translucent)
+{
+	submit(shader, mesh, texture, model, normalMatrix(model), translucent);
+}
+
+void RenderQueue::submit(const Shader& shader, const MeshDraw& mesh, GLuint texture, const glm::mat4& model, const glm::mat3& normal, bool translucent)
+{
+	// a compact shape's position box is folded into the model matrix; the normal
+	// matrix stays that of the world transform
+	Command command = { &shader, mesh, texture, nullptr, false, model * mesh.positionTransform(), normal, condition };
+	push(command, glm::vec3(model[3]), translucent);
+}
+
+void RenderQueue::submit(const Shader& shader, const MeshDraw& mesh, GLuint texture, const InstanceBatch& batch, bool translucent)
+{
+	if (batch.size() == 0)
+		return;
+	Command command = { &shader, mesh, texture, &batch, false, glm::mat4(1.0f), glm::mat3(1.0f), condition };
+	push(command, batch.center(), translucent);
+}
+
+void RenderQueue::submit(const Shader& shader, GLuint texture, const InstanceBatch& batch, bool translucent)
+{
+	if (batch.size() == 0)
+		return;
+	MeshDraw mesh = MeshDraw::elements(batch.vao(), 0, GL_UNSIGNED_SHORT, nullptr);
+	Command command = { &shader, mesh, texture, &batch, true, glm::mat4(1.0f), glm::mat3(1.0f), condition };
+	push(command, batch.center(), translucent);
+}
+
+void RenderQueue::push(const Command& command, const glm::vec3& position, bool translucent)
+{
+	SortItem item = { makeKey(command, position, translucent), (uint32_t)commands.size() };
+	commands.push_back(command);
+	items.push_back(item);
+}
+
+uint32_t RenderQueue::smallId(std::vector<GLuint>& names, GLuint name, uint32_t limit)
+{
+	auto it = std::find(names.begin(), names.end(), name);
+	if (it != names.end())
+		return (uint32_t)(it - names.begin());
+	if (names.size() >= limit)
+		return limit - 1; // out of ids: still correct, just sorted less tightly
+	names.push_back(name);
+	return (uint32_t)names.size() - 1;
+}
+
+uint64_t RenderQueue::makeKey(const Command& command, const glm::vec3& position, bool translucent)
+{
+	uint64_t program = smallId(programIds, command.shader->ID, 1u << 8);
+	uint64_t vao = smallId(vaoIds, command.mesh.vao, 1u << 8);
+	uint64_t material = smallId(materialIds, command.texture, 1u << 12);
+	float distance = glm::length(position - eye) / farPlane;
+	uint64_t depth = (uint64_t)(glm::clamp(distance, 0.0f, 1.0f) * DEPTH_MAX);
+
+	if (translucent)
+	{
+		// back-to-front: invert depth and sort on it before any state
+		return (1ull << 63) | ((DEPTH_MAX - depth) << 39) | (program << 31) | (vao << 23) | (material << 11);
+	}
+	return (program << 55) | (vao << 47) | (material << 35) | (depth << 11);
+}
+
+// LSD radix sort, one byte per pass. A pass is skipped when every key has the
+// same value in that byte, which is the common case for the state fields.
+void RenderQueue::radixSort()
+{
+	size_t n = items.size();
+	scratch.resize(n);
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		size_t counts[256] = {};
+		for (const SortItem& item : items)
+			counts[(item.key >> shift) & 0xFF]++;
+		if (counts[(items[0].key >> shift) & 0xFF] == n)
+			continue;
+		size_t offset = 0;
+		for (size_t& count : counts)
+		{
+			size_t c = count;
+			count = offset;
+			offset += c;
+		}
+		for (const SortItem& item : items)
+			scratch[counts[(item.key >> shift) & 0xFF]++] = item;
+		items.swap(scratch);
+	}
+}
+
+unsigned int RenderQueue::countStateChanges(const std::vector<SortItem>& order) const
+{
+	unsigned int changes = 0;
+	GLuint program = 0, vao = 0, texture = 0;
+	for (const SortItem& item : order)
+	{
+		const Command& command = commands[item.command];
+		changes += command.shader->ID != program;
+		changes += command.mesh.vao != vao;
+		changes += command.texture != texture;
+		program = command.shader->ID;
+		vao = command.mesh.vao;
+		texture = command.texture;
+	}
+	return changes;
+}
+
+void RenderQueue::flush()
+{
+	if (items.empty())
+		return;
+	unsigned int submittedChanges = countStateChanges(items);
+	radixSort();
+
+	const Shader* shader = nullptr;
+	GLuint vao = 0, texture = 0, query = 0;
+	unsigned int changes = 0;
+	for (const SortItem& item : items)
+	{
+		const Command& command = commands[item.command];
+		if (command.condition != query)
+		{
+			if (query != 0)
+				glEndConditionalRender();
+			query = command.condition;
+			if (query != 0)
+				glBeginConditionalRender(query, GL_QUERY_NO_WAIT);
+		}
+		if (command.shader != shader)
+		{
+			shader = command.shader;
+			glUseProgram(shader->ID);
+			changes++;
+		}
+		if (command.mesh.vao != vao)
+		{
+			vao = command.mesh.vao;
+			glBindVertexArray(vao);
+			changes++;
+		}
+		if (command.texture != texture)
+		{
+			texture = command.texture;
+			glBindTexture(GL_TEXTURE_2D, texture);
+			changes++;
+		}
+
+		const MeshDraw& mesh = command.mesh;
+		if (command.batch != nullptr)
+		{
+			if (command.multi)
+				command.batch->drawMulti(GL_TRIANGLES);
+			else if (mesh.indexed)
+				command.batch->drawElements(GL_TRIANGLES, mesh.count, mesh.indexType, mesh.indices, mesh.baseVertex);
+			else
+				command.batch->drawArrays(GL_TRIANGLES, mesh.first, mesh.count);
+			continue;
+		}
+		shader->set(MODEL_UNIFORM, command.model);
+		shader->set(NORMAL_MATRIX_UNIFORM, command.normal);
+		if (mesh.indexed)
+			glDrawElementsBaseVertex(GL_TRIANGLES, mesh.count, mesh.indexType, mesh.indices, mesh.baseVertex);
+		else
+			glDrawArrays(GL_TRIANGLES, mesh.first, mesh.count);
+		renderStats().drawCalls++;
+		renderStats().triangles += mesh.count / 3;
+	}
+	if (query != 0)
+		glEndConditionalRender();
+
+	renderStats().stateChanges += changes;
+	if (submittedChanges > changes)
+		renderStats().stateChangesRemoved += submittedChanges - changes;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "shader.h"
+#include "GeometryBuffer.h"
+#include "InstanceBatch.h"
+
+// Draws are not issued when they are submitted. Each one gets a 64-bit sort key,
+// the keys are radix sorted once per frame and the draws are replayed in key
+// order, so the program, VAO and texture only change when they have to.
+//
+// Key layout, most significant bits first:
+//   translucent (1) | program (8) | VAO (8) | material (12) | depth (24) | unused (11)
+// Opaque draws end up grouped by state and front-to-back inside each group, which
+// lets early-Z reject hidden fragments. Translucent draws sort after everything
+// else, back-to-front, with depth moved above the state bits.
+//
+// A draw can be made conditional on an occlusion query: it is wrapped in
+// glBeginConditionalRender when replayed and the GPU drops it if the query
+// found no samples. The condition does not take part in sorting.
+class RenderQueue
+{
+public:
+	RenderQueue();
+
+	// start a frame; depth in the keys is measured from the eye and scaled to farPlane
+	void begin(const glm::vec3& eye, float farPlane);
+
+	void submit(const Shader& shader, const MeshDraw& mesh, GLuint texture, const glm::mat4& model, bool translucent = false);
+	// with a precomputed normal matrix; the overload above works it out from model
+	void submit(const Shader& shader, const MeshDraw& mesh, GLuint texture, const glm::mat4& model, const glm::mat3& normal, bool translucent = false);
+	void submit(const Shader& shader, const MeshDraw& mesh, GLuint texture, const InstanceBatch& batch, bool translucent = false);
+	// a batch holding several shapes, drawn with InstanceBatch::drawMulti()
+	void submit(const Shader& shader, GLuint texture, const InstanceBatch& batch, bool translucent = false);
+
+	// draws submitted from now on are only drawn if the query passed, without
+	// waiting for its result; 0 makes them unconditional again. Reset by begin().
+	void setCondition(GLuint query) { condition = query; }
+
+	// sort and issue every submitted draw; view/projection must already be set on each program
+	void flush();
+
+	size_t size() const { return commands.size(); }
+
+private:
+	struct Command
+	{
+		const Shader* shader;
+		MeshDraw mesh;
+		GLuint texture;
+		const InstanceBatch* batch;   // null for a single object drawn with model
+		bool multi;                   // batch holds several shapes, mesh only names the VAO
+		glm::mat4 model;
+		glm::mat3 normal;
+		GLuint condition;             // occlusion query gating the draw, 0 for none
+	};
+
+	struct SortItem
+	{
+		uint64_t key;
+		uint32_t command;
+	};
+
+	void push(const Command& command, const glm::vec3& position, bool translucent);
+	uint64_t makeKey(const Command& command, const glm::vec3& position, bool translucent);
+	void radixSort();
+	// number of program + VAO + texture changes needed to draw the commands in this order
+	unsigned int countStateChanges(const std::vector<SortItem>& order) const;
+
+	// GL object names are mapped to small ids so they fit in the key
+	static uint32_t smallId(std::vector<GLuint>& names, GLuint name, uint32_t limit);
+
+	std::vector<Command> commands;
+	std::vector<SortItem> items;
+	std::vector<SortItem> scratch;
+	std::vector<GLuint> programIds, vaoIds, materialIds;
+	glm::vec3 eye;
+	float farPlane;
+	GLuint condition;
+};
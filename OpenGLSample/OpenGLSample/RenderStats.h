@@ -0,0 +1,68 @@
+#pragma once
+
+// Per-frame counters, reset at the top of the render loop and printed once a second
+// so the cost of each drawing path can be compared while the scene is running.
+struct RenderStats
+{
+	unsigned int drawCalls = 0;
+	unsigned int instances = 0;
+	unsigned int triangles = 0;
+
+	// Shader uniform table: lookups by name or handle, values actually sent to GL,
+	// and sets that were dropped because the program already held the value
+	unsigned int uniformLookups = 0;
+	unsigned int uniformUploads = 0;
+	unsigned int uniformUploadsSkipped = 0;
+
+	// light uniform buffer: glBufferSubData calls and bytes sent for dirty ranges
+	unsigned int lightUploads = 0;
+	unsigned int lightBytesUploaded = 0;
+
+	// render queue: program/VAO/texture binds issued, and binds saved by sorting
+	unsigned int stateChanges = 0;
+	unsigned int stateChangesRemoved = 0;
+
+	// scene: world matrices recomputed this frame (dynamic objects only), and
+	// those that moved to another cell of the loose octree
+	unsigned int transformsUpdated = 0;
+	unsigned int octreeRelinks = 0;
+
+	// frustum culling: scene objects kept and dropped
+	unsigned int objectsVisible = 0;
+	unsigned int objectsCulled = 0;
+
+	// occlusion culling: objects in the frustum but hidden behind the occluders,
+	// occluder triangles rasterized, and the CPU time of each stage
+	unsigned int objectsOccluded = 0;
+	unsigned int occluderTriangles = 0;
+	float occluderSetupMs = 0.0f;
+	float occluderRasterMs = 0.0f;
+	float occlusionTestMs = 0.0f;
+
+	// GPU occlusion queries: boxes drawn, results read back and the frames each
+	// waited in total, groups drawn on a condition after an occluded result, and
+	// the samples those groups' boxes covered when last visible, as an estimate
+	// of the fragments the condition saved
+	unsigned int queriesIssued = 0;
+	unsigned int queryResults = 0;
+	unsigned int queryLatencyFrames = 0;
+	unsigned int groupsConditional = 0;
+	unsigned int fragmentsAvoided = 0;
+
+	// level-of-detail: objects that switched to another level this frame
+	unsigned int lodChanges = 0;
+
+	// stream buffer: bytes written into the ring this frame
+	unsigned int streamBytes = 0;
+
+	void reset()
+	{
+		*this = RenderStats();
+	}
+};
+
+inline RenderStats& renderStats()
+{
+	static RenderStats stats;
+	return stats;
+}
@@ -0,0 +1,341 @@
+#include "Scene.h"
+#include "Lod.h"
+#include "RenderStats.h"
+#include "ThreadPool.h"
+#include "NormalMatrix.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+Aabb Aabb::fromShape(const ShapeData& shape)
+{
+	Aabb box = { glm::vec3(0.0f), glm::vec3(0.0f) };
+	if (shape.numVertices == 0)
+		return box;
+	box.min = box.max = shape.vertices[0].position;
+	for (GLuint i = 1; i < shape.numVertices; i++)
+	{
+		box.min = glm::min(box.min, shape.vertices[i].position);
+		box.max = glm::max(box.max, shape.vertices[i].position);
+	}
+	return box;
+}
+
+// Transforms the center and sums the absolute matrix columns against the extent,
+// which gives the tight box around the eight transformed corners.
+Aabb Aabb::transformed(const glm::mat4& world) const
+{
+	glm::vec3 c = glm::vec3(world * glm::vec4(center(), 1.0f));
+	glm::vec3 e = extent();
+	glm::vec3 r(0.0f);
+	for (int col = 0; col < 3; col++)
+		for (int row = 0; row < 3; row++)
+			r[row] += std::fabs(world[col][row]) * e[col];
+	Aabb box = { c - r, c + r };
+	return box;
+}
+
+unsigned int Scene::add(const MeshDraw& mesh, const Aabb& local, GLuint texture, const glm::mat4& world, const Aabb& bounds)
+{
+	worlds.push_back(world);
+	normals.push_back(glm::mat3(1.0f)); // filled in by bake()
+	worldBounds.push_back(bounds);
+	localBounds.push_back(local);
+	meshes.push_back(mesh);
+	textures.push_back(texture);
+	dynamicSlot.push_back(-1);
+	queryGroups.push_back(-1);
+	return (unsigned int)worlds.size() - 1;
+}
+
+unsigned int Scene::addStatic(const MeshDraw& mesh, const Aabb& local, GLuint texture, const glm::mat4& world)
+{
+	return add(mesh, local, texture, world, local.transformed(world));
+}
+
+unsigned int Scene::addStatic(const MeshDraw& mesh, const Aabb& local, GLuint texture, const glm::mat4& world, const Aabb& bounds)
+{
+	return add(mesh, local, texture, world, bounds);
+}
+
+unsigned int Scene::addDynamic(const MeshDraw& mesh, const Aabb& local, GLuint texture, TransformFunction transform)
+{
+	glm::mat4 world = transform(0.0f);
+	unsigned int object = add(mesh, local, texture, world, local.transformed(world));
+	dynamicSlot[object] = (int)dynamicObjects.size();
+	dynamicObjects.push_back(object);
+	dynamicTransforms.push_back(transform);
+	return object;
+}
+
+void Scene::bake()
+{
+	computeNormalMatrices(worlds.data(), normals.data(), worlds.size());
+
+	for (InstanceBatch& batch : batches)
+		batch.cleanup();
+	batches.clear();
+	batchTextures.clear();
+	batchGroups.clear();
+	batchSlot.assign(size(), -1);
+	batchedVisible.clear();
+
+	for (unsigned int i = 0; i < size(); i++)
+	{
+		if (isDynamic(i))
+			continue;
+		size_t slot = 0;
+		while (slot < batches.size() && (batchTextures[slot] != textures[i] || batchGroups[slot] != queryGroups[i]))
+			slot++;
+		if (slot == batches.size())
+		{
+			batchTextures.push_back(textures[i]);
+			batchGroups.push_back(queryGroups[i]);
+			batches.push_back(InstanceBatch());
+		}
+		batches[slot].add(meshes[i], worlds[i]);
+		batchSlot[i] = (int)slot;
+		batchedVisible.push_back(i);
+	}
+	for (InstanceBatch& batch : batches)
+		batch.upload();
+
+	culler.setBounds(worldBounds.data(), worldBounds.size());
+	bvh.build(worldBounds.data(), worldBounds.size());
+
+	// the octree starts out around everything; the static bounds limit how far
+	// the visibility cache has to widen its frustum
+	bool anyStatic = false;
+	for (unsigned int i = 0; i < size(); i++)
+	{
+		if (isDynamic(i))
+			continue;
+		if (!anyStatic)
+			staticBounds = worldBounds[i];
+		staticBounds.min = glm::min(staticBounds.min, worldBounds[i].min);
+		staticBounds.max = glm::max(staticBounds.max, worldBounds[i].max);
+		anyStatic = true;
+	}
+	if (size() > 0)
+	{
+		Aabb all = { bvh.root().min, bvh.root().max };
+		dynamicTree.create(all, size());
+	}
+	for (unsigned int object : dynamicObjects)
+		dynamicTree.insert(object, worldBounds[object]);
+	staticCache.invalidate();
+
+	int groupCount = queryGroups.empty() ? 0 : *std::max_element(queryGroups.begin(), queryGroups.end()) + 1;
+	queries.create(groupCount);
+	updateQueryBounds();
+	visible.resize(size());
+	std::iota(visible.begin(), visible.end(), 0);
+}
+
+void Scene::update(float time)
+{
+	for (size_t slot = 0; slot < dynamicObjects.size(); slot++)
+	{
+		unsigned int object = dynamicObjects[slot];
+		worlds[object] = dynamicTransforms[slot](time);
+		normals[object] = ::normalMatrix(worlds[object]);
+		worldBounds[object] = localBounds[object].transformed(worlds[object]);
+		dynamicTree.move(object, worldBounds[object]);
+		bvh.setBounds(object, worldBounds[object]);
+	}
+	bool groupsMoved = false;
+	for (unsigned int object : dynamicObjects)
+		groupsMoved |= queryGroups[object] >= 0;
+	if (groupsMoved)
+		updateQueryBounds();
+	renderStats().transformsUpdated += (unsigned int)dynamicObjects.size();
+}
+
+void Scene::setQueryGroup(unsigned int object, unsigned int group)
+{
+	queryGroups[object] = (int)group;
+}
+
+void Scene::updateQueryBounds()
+{
+	std::vector<bool> started(queries.groupCount(), false);
+	std::vector<Aabb> bounds(queries.groupCount());
+	for (unsigned int i = 0; i < size(); i++)
+	{
+		int group = queryGroups[i];
+		if (group < 0)
+			continue;
+		if (!started[group])
+			bounds[group] = worldBounds[i];
+		bounds[group].min = glm::min(bounds[group].min, worldBounds[i].min);
+		bounds[group].max = glm::max(bounds[group].max, worldBounds[i].max);
+		started[group] = true;
+	}
+	for (unsigned int group = 0; group < queries.groupCount(); group++)
+		queries.setBounds(group, bounds[group]);
+}
+
+void Scene::pollOcclusionQueries(const glm::vec3& eye)
+{
+	if (occlusionQueries)
+		queries.beginFrame(eye);
+}
+
+void Scene::issueOcclusionQueries(const Shader& shader, const MeshDraw& box, const Aabb& boxBounds)
+{
+	if (occlusionQueries)
+		queries.issue(shader, box, boxBounds);
+}
+
+void Scene::setLod(unsigned int object, const LodChain* chain)
+{
+	meshes[object] = chain->levels[0];
+	lodObjects.push_back(object);
+	lodChains.push_back(chain);
+	lodLevels.push_back(0);
+}
+
+void Scene::selectLods(const glm::vec3& eye, const glm::mat4& projection)
+{
+	for (size_t i = 0; i < lodObjects.size(); i++)
+	{
+		unsigned int object = lodObjects[i];
+		float screenSize = LodChain::screenSize(worldBounds[object], eye, projection);
+		unsigned int level = lodChains[i]->select(screenSize, lodLevels[i]);
+		if (level == lodLevels[i])
+			continue;
+		lodLevels[i] = level;
+		meshes[object] = lodChains[i]->levels[level];
+		// dynamic objects are submitted one by one and never enter a batch
+		if (!isDynamic(object))
+			batchesDirty = true;
+		renderStats().lodChanges++;
+	}
+}
+
+// The batches hold the visible static objects only, so whenever the static part
+// of the visible set differs from last frame's, or a static object changed LOD
+// level, they are refilled and uploaded again. Dynamic objects moving in and out
+// of view do not touch them, so a still camera costs nothing beyond the test
+// itself.
+//
+// The BVH and the flat test are only kept up to date for static objects; the
+// dynamic objects they hold are dropped from their result and taken from the
+// octree instead.
+void Scene::cull(const glm::mat4& projection, const glm::mat4& view)
+{
+	glm::mat4 viewProjection = projection * view;
+	Frustum frustum = Frustum::fromViewProjection(viewProjection);
+	if (!visibilityCaching)
+		staticCache.invalidate();
+	if (!visibilityCaching || !staticCache.lookup(projection, view))
+	{
+		Frustum staticFrustum = visibilityCaching ? staticCache.refresh(projection, view, staticBounds) : frustum;
+		if (hierarchicalCulling)
+			bvh.cull(staticFrustum, staticVisible);
+		else
+			culler.cull(staticFrustum, staticVisible);
+		if (!dynamicObjects.empty())
+			staticVisible.erase(std::remove_if(staticVisible.begin(), staticVisible.end(),
+				[this](uint32_t object) { return isDynamic(object); }), staticVisible.end());
+	}
+	dynamicVisible.clear();
+	dynamicTree.cull(frustum, dynamicVisible);
+	std::sort(dynamicVisible.begin(), dynamicVisible.end());
+	visible.resize(staticVisible.size() + dynamicVisible.size());
+	std::merge(staticVisible.begin(), staticVisible.end(), dynamicVisible.begin(), dynamicVisible.end(), visible.begin());
+	renderStats().objectsCulled += size() - (unsigned int)visible.size();
+
+	if (occlusionCulling && occlusion.occluderCount() > 0)
+	{
+		size_t inFrustum = visible.size();
+		occlusion.render(viewProjection, ThreadPool::shared());
+		occlusion.filter(visible, worldBounds.data(), ThreadPool::shared());
+		renderStats().objectsOccluded += (unsigned int)(inFrustum - visible.size());
+		renderStats().occluderTriangles += occlusion.triangleCount();
+		renderStats().occluderSetupMs += (float)occlusion.setupMilliseconds();
+		renderStats().occluderRasterMs += (float)occlusion.rasterMilliseconds();
+		renderStats().occlusionTestMs += (float)occlusion.testMilliseconds();
+	}
+	renderStats().objectsVisible += (unsigned int)visible.size();
+	visibleStatic.clear();
+	for (uint32_t object : visible)
+	{
+		if (!isDynamic(object))
+			visibleStatic.push_back(object);
+	}
+	if (visibleStatic == batchedVisible && !batchesDirty)
+		return;
+	batchesDirty = false;
+	batchedVisible.swap(visibleStatic);
+
+	for (InstanceBatch& batch : batches)
+		batch.clear();
+	for (uint32_t object : batchedVisible)
+		batches[batchSlot[object]].add(meshes[object], worlds[object]);
+	for (InstanceBatch& batch : batches)
+		batch.upload();
+}
+
+void Scene::submitObjects(RenderQueue& queue, const Shader& shader) const
+{
+	for (uint32_t i : visible)
+	{
+		queue.setCondition(condition(queryGroups[i]));
+		queue.submit(shader, meshes[i], textures[i], worlds[i], normals[i]);
+	}
+	queue.setCondition(0);
+}
+
+void Scene::submitBatches(RenderQueue& queue, const Shader& instancedShader, const Shader& objectShader) const
+{
+	for (size_t slot = 0; slot < batches.size(); slot++)
+	{
+		if (batches[slot].size() == 0)
+			continue;
+		queue.setCondition(condition(batchGroups[slot]));
+		queue.submit(instancedShader, batchTextures[slot], batches[slot]);
+	}
+	for (uint32_t object : visible)
+	{
+		if (!isDynamic(object))
+			continue;
+		queue.setCondition(condition(queryGroups[object]));
+		queue.submit(objectShader, meshes[object], textures[object], worlds[object], normals[object]);
+	}
+	queue.setCondition(0);
+}
+
+void Scene::cleanup()
+{
+	for (InstanceBatch& batch : batches)
+		batch.cleanup();
+	batches.clear();
+	batchTextures.clear();
+	batchGroups.clear();
+	worlds.clear();
+	normals.clear();
+	worldBounds.clear();
+	localBounds.clear();
+	meshes.clear();
+	textures.clear();
+	dynamicSlot.clear();
+	dynamicObjects.clear();
+	dynamicTransforms.clear();
+	batchSlot.clear();
+	queryGroups.clear();
+	queries.cleanup();
+	lodObjects.clear();
+	lodChains.clear();
+	lodLevels.clear();
+	visible.clear();
+	visibleStatic.clear();
+	batchedVisible.clear();
+	culler.resize(0);
+	bvh.clear();
+	dynamicTree.clear();
+	staticCache.invalidate();
+	staticVisible.clear();
+	dynamicVisible.clear();
+	occlusion.clearOccluders();
+}
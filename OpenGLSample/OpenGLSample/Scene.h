@@ -0,0 +1,159 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Bvh.h"
+#include "FrustumCuller.h"
+#include "GeometryBuffer.h"
+#include "InstanceBatch.h"
+#include "LooseOctree.h"
+#include "OcclusionCuller.h"
+#include "OcclusionQueries.h"
+#include "RenderQueue.h"
+#include "ShapeData.h"
+#include "VisibilityCache.h"
+#include "shader.h"
+
+// Axis-aligned bounding box.
+struct Aabb
+{
+	glm::vec3 min;
+	glm::vec3 max;
+
+	glm::vec3 center() const { return (min + max) * 0.5f; }
+	glm::vec3 extent() const { return (max - min) * 0.5f; }
+
+	// bounds of a shape's vertices in its own space
+	static Aabb fromShape(const ShapeData& shape);
+	// smallest box holding this one after transforming it by world
+	Aabb transformed(const glm::mat4& world) const;
+};
+
+struct LodChain;
+
+// Every object of the stairwell with its world matrix and world-space bounds.
+// Static objects are evaluated once when they are added and never touched again;
+// only objects added as dynamic have their transform re-evaluated by update(),
+// which moves them through a loose octree rather than refitting the BVH.
+// The data is kept in parallel arrays so a pass over matrices or bounds walks
+// contiguous memory.
+class Scene
+{
+public:
+	typedef std::function<glm::mat4(float time)> TransformFunction;
+
+	unsigned int addStatic(const MeshDraw& mesh, const Aabb& localBounds, GLuint texture, const glm::mat4& world);
+	// with the world bounds already known, e.g. read from a scene file
+	unsigned int addStatic(const MeshDraw& mesh, const Aabb& localBounds, GLuint texture, const glm::mat4& world, const Aabb& worldBounds);
+	unsigned int addDynamic(const MeshDraw& mesh, const Aabb& localBounds, GLuint texture, TransformFunction transform);
+
+	// call once after the last addStatic(): computes every normal matrix in one
+	// batched pass, then groups the static objects by texture into instance
+	// batches and uploads them
+	void bake();
+
+	// re-evaluate the dynamic objects only
+	void update(float time);
+
+	// draw the object with one level of chain, picked by selectLods(); the chain
+	// must outlive the scene. Call before bake().
+	void setLod(unsigned int object, const LodChain* chain);
+	// pick each LOD object's level from its size on screen; the batches are
+	// rebuilt by the next cull() when any level changed
+	void selectLods(const glm::vec3& eye, const glm::mat4& projection);
+
+	// keep only the objects whose bounds touch the view frustum and are not
+	// hidden by an occluder for the submit calls below; the instance batches are
+	// rebuilt when that set changes. Until the first call everything is drawn.
+	// The static objects come from the BVH or the flat test, or from the
+	// visibility cache while the camera stays close to where they were last
+	// tested; the dynamic ones come from the loose octree every frame.
+	void cull(const glm::mat4& projection, const glm::mat4& view);
+	// walk the BVH, dropping whole groups of objects at once, instead of testing
+	// every box with the SIMD culler
+	void setHierarchicalCulling(bool enable) { hierarchicalCulling = enable; }
+	bool isHierarchicalCulling() const { return hierarchicalCulling; }
+	void setVisibilityCaching(bool enable) { visibilityCaching = enable; }
+	const VisibilityCache& visibilityCache() const { return staticCache; }
+
+	// a solid box that hides what is behind it, usually a wall, floor or stair
+	// block also added as an object; see OcclusionCuller
+	void addOccluder(const Aabb& localBounds, const glm::mat4& world) { occlusion.addOccluder(localBounds, world); }
+	void setOcclusionCulling(bool enable) { occlusionCulling = enable; }
+
+	// GPU occlusion queries per group of objects, e.g. one rail post; objects
+	// without a group are always drawn. Groups are numbered from 0 and must be
+	// set before bake(), which gives each group and texture its own batch.
+	void setQueryGroup(unsigned int object, unsigned int group);
+	void setOcclusionQueries(bool enable) { occlusionQueries = enable; }
+	// reads the finished queries and picks this frame's conditional groups;
+	// call before the submit calls
+	void pollOcclusionQueries(const glm::vec3& eye);
+	// draws the bounding boxes of the groups due for a query; call after the
+	// opaque draws. See OcclusionQueries::issue().
+	void issueOcclusionQueries(const Shader& shader, const MeshDraw& box, const Aabb& boxBounds);
+
+	// queue every object as its own draw with the baked matrices
+	void submitObjects(RenderQueue& queue, const Shader& shader) const;
+	// queue the static batches, one per texture, plus the dynamic objects one by one
+	void submitBatches(RenderQueue& queue, const Shader& instancedShader, const Shader& objectShader) const;
+
+	unsigned int size() const { return (unsigned int)worlds.size(); }
+	const glm::mat4& world(unsigned int i) const { return worlds[i]; }
+	const glm::mat3& normalMatrix(unsigned int i) const { return normals[i]; }
+	const Aabb& bounds(unsigned int i) const { return worldBounds[i]; }
+	bool isDynamic(unsigned int i) const { return dynamicSlot[i] >= 0; }
+	// world bounds of every object, for ray and box queries; valid after bake().
+	// The dynamic objects' moves are applied here, only when asked for.
+	const Bvh& hierarchy() { bvh.refit(); return bvh; }
+
+	void cleanup();
+
+private:
+	unsigned int add(const MeshDraw& mesh, const Aabb& localBounds, GLuint texture, const glm::mat4& world, const Aabb& worldBounds);
+
+	std::vector<glm::mat4> worlds;
+	std::vector<glm::mat3> normals;
+	std::vector<Aabb> worldBounds;
+	std::vector<Aabb> localBounds;
+	std::vector<MeshDraw> meshes;
+	std::vector<GLuint> textures;
+	std::vector<int> dynamicSlot;       // index into dynamicObjects, -1 for static objects
+
+	std::vector<unsigned int> dynamicObjects;
+	std::vector<TransformFunction> dynamicTransforms;
+
+	std::vector<GLuint> batchTextures;
+	std::vector<int> batchGroups;       // query group of each batch, -1 for none
+	std::vector<InstanceBatch> batches;
+	std::vector<int> batchSlot;         // batch of each static object
+	bool batchesDirty = false;
+
+	std::vector<unsigned int> lodObjects;
+	std::vector<const LodChain*> lodChains;   // per entry of lodObjects
+	std::vector<unsigned int> lodLevels;
+
+	FrustumCuller culler;
+	Bvh bvh;
+	bool hierarchicalCulling = true;
+	LooseOctree dynamicTree;
+	VisibilityCache staticCache;
+	bool visibilityCaching = true;
+	Aabb staticBounds = { glm::vec3(0.0f), glm::vec3(0.0f) };
+	std::vector<uint32_t> staticVisible;    // ascending, may hold more than is in view
+	std::vector<uint32_t> dynamicVisible;
+	OcclusionCuller occlusion;
+	bool occlusionCulling = true;
+
+	std::vector<int> queryGroups;       // per object, -1 for none
+	OcclusionQueries queries;
+	bool occlusionQueries = true;
+	GLuint condition(int group) const { return occlusionQueries && group >= 0 ? queries.condition(group) : 0; }
+	void updateQueryBounds();
+	std::vector<uint32_t> visible;      // ascending object indices
+	std::vector<uint32_t> visibleStatic;     // static part of visible, this frame
+	std::vector<uint32_t> batchedVisible;    // what the batches hold, ascending
+};
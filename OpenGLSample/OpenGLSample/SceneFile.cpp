@@ -0,0 +1,377 @@
+#include "SceneFile.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+
+
+namespace
+{
+	const char MAGIC[4] = { 'S', 'C', 'N', 'B' };
+
+	// every array starts on a 16-byte boundary
+	uint64_t align(uint64_t offset)
+	{
+		return (offset + 15) & ~(uint64_t)15;
+	}
+
+	void copyName(char* destination, size_t size, const std::string& name)
+	{
+		memset(destination, 0, size);
+		strncpy(destination, name.c_str(), size - 1);
+	}
+
+	template <typename T>
+	void writeArray(std::vector<char>& file, uint64_t offset, const std::vector<T>& array)
+	{
+		if (!array.empty())
+			memcpy(file.data() + offset, array.data(), array.size() * sizeof(T));
+	}
+
+	template <typename T>
+	bool arrayFits(uint64_t offset, uint64_t count, uint64_t fileSize)
+	{
+		return offset % 16 == 0 && offset <= fileSize && count * sizeof(T) <= fileSize - offset;
+	}
+
+	// applies "translate <x> <y> <z>", "rotate <degrees> <x> <y> <z>" or
+	// "scale <x> [<y> <z>]" to transform, reading the arguments after the keyword
+	bool readTransform(const std::string& keyword, std::istringstream& line, glm::mat4& transform)
+	{
+		if (keyword == "translate")
+		{
+			glm::vec3 offset;
+			if (!(line >> offset.x >> offset.y >> offset.z))
+				return false;
+			transform = glm::translate(transform, offset);
+			return true;
+		}
+		if (keyword == "rotate")
+		{
+			float degrees;
+			glm::vec3 axis;
+			if (!(line >> degrees >> axis.x >> axis.y >> axis.z))
+				return false;
+			transform = glm::rotate(transform, glm::radians(degrees), axis);
+			return true;
+		}
+		if (keyword == "scale")
+		{
+			glm::vec3 factor;
+			if (!(line >> factor.x))
+				return false;
+			if (line >> factor.y)
+			{
+				if (!(line >> factor.z))
+					return false;
+			}
+			else
+			{
+				factor.y = factor.z = factor.x;
+				line.clear();
+			}
+			transform = glm::scale(transform, factor);
+			return true;
+		}
+		return false;
+	}
+
+	bool isWhole(const glm::vec3& position)
+	{
+		return std::floor(position.x) == position.x && std::floor(position.y) == position.y && std::floor(position.z) == position.z;
+	}
+}
+
+// SceneFileWriter
+// ---------------
+uint16_t SceneFileWriter::addMaterial(const std::string& name, const std::string& texture)
+{
+	int found = findMaterial(name);
+	if (found >= 0)
+		return (uint16_t)found;
+	SceneFileMaterial material;
+	copyName(material.name, sizeof(material.name), name);
+	copyName(material.texture, sizeof(material.texture), texture);
+	materials.push_back(material);
+	return (uint16_t)(materials.size() - 1);
+}
+
+uint16_t SceneFileWriter::addMesh(const std::string& name, const Aabb& localBounds)
+{
+	int found = findMesh(name);
+	if (found >= 0)
+		return (uint16_t)found;
+	SceneFileMesh mesh;
+	copyName(mesh.name, sizeof(mesh.name), name);
+	meshes.push_back(mesh);
+	meshBounds.push_back(localBounds);
+	return (uint16_t)(meshes.size() - 1);
+}
+
+uint16_t SceneFileWriter::addGroup(const std::string& name, const glm::mat4& transform)
+{
+	SceneFileGroup group;
+	copyName(group.name, sizeof(group.name), name);
+	group.transform = transform;
+	groups.push_back(group);
+	return (uint16_t)(groups.size() - 1);
+}
+
+void SceneFileWriter::addObject(uint16_t mesh, uint16_t material, const glm::vec3& position, const glm::mat4& model, uint16_t flags)
+{
+	if (groups.empty())
+		addGroup("default", glm::mat4(1.0f));
+	glm::mat4 world = groups.back().transform * glm::translate(glm::mat4(1.0f), position) * model;
+
+	SceneFileObject object;
+	object.group = (uint16_t)(groups.size() - 1);
+	object.mesh = mesh;
+	object.material = material;
+	object.flags = flags;
+
+	worlds.push_back(world);
+	bounds.push_back(meshBounds[mesh].transformed(world));
+	positions.push_back(position);
+	objects.push_back(object);
+}
+
+int SceneFileWriter::findMaterial(const std::string& name) const
+{
+	for (size_t i = 0; i < materials.size(); i++)
+		if (name == materials[i].name)
+			return (int)i;
+	return -1;
+}
+
+int SceneFileWriter::findMesh(const std::string& name) const
+{
+	for (size_t i = 0; i < meshes.size(); i++)
+		if (name == meshes[i].name)
+			return (int)i;
+	return -1;
+}
+
+bool SceneFileWriter::write(const char* path) const
+{
+	SceneFileHeader header = {};
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = SCENE_FILE_VERSION;
+	header.objectCount = (uint32_t)objects.size();
+	header.groupCount = (uint32_t)groups.size();
+	header.meshCount = (uint32_t)meshes.size();
+	header.materialCount = (uint32_t)materials.size();
+	header.meshBoundsHash = meshBoundsHash;
+
+	uint64_t offset = align(sizeof(SceneFileHeader));
+	header.worldsOffset = offset;
+	offset = align(offset + worlds.size() * sizeof(glm::mat4));
+	header.boundsOffset = offset;
+	offset = align(offset + bounds.size() * sizeof(Aabb));
+	header.positionsOffset = offset;
+	offset = align(offset + positions.size() * sizeof(glm::vec3));
+	header.objectsOffset = offset;
+	offset = align(offset + objects.size() * sizeof(SceneFileObject));
+	header.groupsOffset = offset;
+	offset = align(offset + groups.size() * sizeof(SceneFileGroup));
+	header.meshesOffset = offset;
+	offset = align(offset + meshes.size() * sizeof(SceneFileMesh));
+	header.materialsOffset = offset;
+	offset = align(offset + materials.size() * sizeof(SceneFileMaterial));
+	header.fileSize = offset;
+
+	std::vector<char> file((size_t)header.fileSize, 0);
+	memcpy(file.data(), &header, sizeof(header));
+	writeArray(file, header.worldsOffset, worlds);
+	writeArray(file, header.boundsOffset, bounds);
+	writeArray(file, header.positionsOffset, positions);
+	writeArray(file, header.objectsOffset, objects);
+	writeArray(file, header.groupsOffset, groups);
+	writeArray(file, header.meshesOffset, meshes);
+	writeArray(file, header.materialsOffset, materials);
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write(file.data(), file.size());
+	if (!out)
+	{
+		std::cout << "ERROR::SCENEFILE::WRITE_FAILED: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// SceneFile
+// ---------
+bool SceneFile::open(const char* path)
+{
+	close();
+	if (!mapped.open(path))
+		return false;
+	size_t mappingSize = mapped.size();
+
+	// validate the header and that every array lies inside the file; nothing else is read
+	const char* base = (const char*)mapped.data();
+	header = (const SceneFileHeader*)base;
+	if (mappingSize < sizeof(SceneFileHeader) || memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0
+		|| header->version != SCENE_FILE_VERSION || header->fileSize != mappingSize
+		|| !arrayFits<glm::mat4>(header->worldsOffset, header->objectCount, mappingSize)
+		|| !arrayFits<Aabb>(header->boundsOffset, header->objectCount, mappingSize)
+		|| !arrayFits<glm::vec3>(header->positionsOffset, header->objectCount, mappingSize)
+		|| !arrayFits<SceneFileObject>(header->objectsOffset, header->objectCount, mappingSize)
+		|| !arrayFits<SceneFileGroup>(header->groupsOffset, header->groupCount, mappingSize)
+		|| !arrayFits<SceneFileMesh>(header->meshesOffset, header->meshCount, mappingSize)
+		|| !arrayFits<SceneFileMaterial>(header->materialsOffset, header->materialCount, mappingSize))
+	{
+		std::cout << "ERROR::SCENEFILE::INVALID_FILE: " << path << std::endl;
+		close();
+		return false;
+	}
+	worldArray = (const glm::mat4*)(base + header->worldsOffset);
+	boundsArray = (const Aabb*)(base + header->boundsOffset);
+	positionArray = (const glm::vec3*)(base + header->positionsOffset);
+	objectArray = (const SceneFileObject*)(base + header->objectsOffset);
+	groupArray = (const SceneFileGroup*)(base + header->groupsOffset);
+	meshArray = (const SceneFileMesh*)(base + header->meshesOffset);
+	materialArray = (const SceneFileMaterial*)(base + header->materialsOffset);
+	return true;
+}
+
+void SceneFile::close()
+{
+	mapped.close();
+	header = nullptr;
+}
+
+bool SceneFile::needsConvert(const char* textPath, const char* binaryPath, const std::map<std::string, Aabb>& meshBounds)
+{
+	struct stat text, binary;
+	if (stat(binaryPath, &binary) != 0)
+		return true;
+	if (stat(textPath, &text) == 0 && text.st_mtime > binary.st_mtime)
+		return true;
+
+	// only the header is read; open() checks the rest
+	SceneFileHeader header;
+	std::ifstream in(binaryPath, std::ios::binary);
+	if (!in.read((char*)&header, sizeof(header)))
+		return true;
+	return memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != SCENE_FILE_VERSION
+		|| header.meshBoundsHash != hashMeshBounds(meshBounds);
+}
+
+uint64_t SceneFile::hashMeshBounds(const std::map<std::string, Aabb>& meshBounds)
+{
+	uint64_t hash = 14695981039346656037ull;
+	auto add = [&hash](const void* data, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= ((const unsigned char*)data)[i];
+			hash *= 1099511628211ull;
+		}
+	};
+	for (const auto& entry : meshBounds)
+	{
+		add(entry.first.c_str(), entry.first.size() + 1);
+		add(&entry.second.min, sizeof(glm::vec3));
+		add(&entry.second.max, sizeof(glm::vec3));
+	}
+	return hash;
+}
+
+bool SceneFile::convert(const char* textPath, const char* binaryPath, const std::map<std::string, Aabb>& meshBounds)
+{
+	std::ifstream in(textPath);
+	if (!in)
+	{
+		std::cout << "ERROR::SCENEFILE::OPEN_FAILED: " << textPath << std::endl;
+		return false;
+	}
+
+	// a group is added to the file when its first object appears, so every
+	// transform line has to come before the objects
+	SceneFileWriter writer;
+	writer.setMeshBoundsHash(hashMeshBounds(meshBounds));
+	std::string groupName = "default";
+	glm::mat4 groupTransform = glm::mat4(1.0f);
+	bool groupAdded = false;
+	std::string text;
+	for (int lineNumber = 1; std::getline(in, text); lineNumber++)
+	{
+		size_t comment = text.find('#');
+		if (comment != std::string::npos)
+			text.erase(comment);
+		std::istringstream line(text);
+		std::string keyword;
+		if (!(line >> keyword))
+			continue;
+
+		bool ok = true;
+		if (keyword == "material")
+		{
+			std::string name, texture;
+			ok = (bool)(line >> name >> texture);
+			if (ok)
+				writer.addMaterial(name, texture);
+		}
+		else if (keyword == "group")
+		{
+			ok = (bool)(line >> groupName);
+			groupTransform = glm::mat4(1.0f);
+			groupAdded = false;
+		}
+		else if (keyword == "translate" || keyword == "rotate" || keyword == "scale")
+			ok = !groupAdded && readTransform(keyword, line, groupTransform);
+		else if (keyword == "object")
+		{
+			std::string meshName, materialName;
+			glm::vec3 position;
+			ok = (bool)(line >> meshName >> materialName >> position.x >> position.y >> position.z);
+			auto bounds = meshBounds.find(meshName);
+			int material = writer.findMaterial(materialName);
+			if (ok && (bounds == meshBounds.end() || material < 0))
+			{
+				std::cout << "ERROR::SCENEFILE::UNKNOWN_NAME: " << textPath << ":" << lineNumber << ": "
+					<< (material < 0 ? materialName : meshName) << std::endl;
+				return false;
+			}
+			glm::mat4 model = glm::mat4(1.0f);
+			bool transformed = false;
+			uint16_t flags = 0;
+			std::string option;
+			while (ok && line >> option)
+			{
+				if (option == "occluder")
+				{
+					flags |= SCENE_OBJECT_OCCLUDER;
+					continue;
+				}
+				ok = readTransform(option, line, model);
+				transformed = true;
+			}
+			if (!transformed && isWhole(position))
+				flags |= SCENE_OBJECT_CELL;
+			if (ok)
+			{
+				if (!groupAdded)
+				{
+					writer.addGroup(groupName, groupTransform);
+					groupAdded = true;
+				}
+				uint16_t mesh = writer.addMesh(meshName, bounds->second);
+				writer.addObject(mesh, (uint16_t)material, position, model, flags);
+			}
+		}
+		else
+			ok = false;
+
+		if (!ok)
+		{
+			std::cout << "ERROR::SCENEFILE::PARSE: " << textPath << ":" << lineNumber << ": " << text << std::endl;
+			return false;
+		}
+	}
+	return writer.write(binaryPath);
+}
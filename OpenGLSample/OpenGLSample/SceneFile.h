@@ -0,0 +1,151 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Scene.h"
+
+// Binary scene layout, loaded by mapping the file into memory: the header holds
+// the byte offset of every array, so opening a scene is a few pointer fixups and
+// no parsing, however many objects it has. Per-object data is kept in parallel
+// arrays like Scene's, with the world matrices and bounds already evaluated.
+//
+// A text description (see scenefiles/stairwell.txt) is turned into this format
+// by SceneFile::convert().
+
+const uint32_t SCENE_FILE_VERSION = 2;
+const int SCENE_FILE_NAME_LENGTH = 32;
+
+struct SceneFileHeader
+{
+	char magic[4];              // "SCNB"
+	uint32_t version;
+	uint32_t objectCount;
+	uint32_t groupCount;
+	uint32_t meshCount;
+	uint32_t materialCount;
+	uint64_t meshBoundsHash;    // SceneFile::hashMeshBounds() of the bounds it was converted with
+	uint64_t worldsOffset;      // glm::mat4[objectCount]
+	uint64_t boundsOffset;      // Aabb[objectCount], world space
+	uint64_t positionsOffset;   // glm::vec3[objectCount], in the object's group space
+	uint64_t objectsOffset;     // SceneFileObject[objectCount]
+	uint64_t groupsOffset;      // SceneFileGroup[groupCount]
+	uint64_t meshesOffset;      // SceneFileMesh[meshCount]
+	uint64_t materialsOffset;   // SceneFileMaterial[materialCount]
+	uint64_t fileSize;
+};
+
+// object flags
+const uint16_t SCENE_OBJECT_CELL = 1;      // placed only by a whole-number translation: a lattice cell of its group
+const uint16_t SCENE_OBJECT_OCCLUDER = 2;  // solid enough to hide what is behind it, for occlusion culling
+
+struct SceneFileObject
+{
+	uint16_t group;
+	uint16_t mesh;
+	uint16_t material;
+	uint16_t flags;
+};
+
+struct SceneFileGroup
+{
+	char name[SCENE_FILE_NAME_LENGTH];
+	glm::mat4 transform;
+};
+
+struct SceneFileMesh
+{
+	char name[SCENE_FILE_NAME_LENGTH];
+};
+
+struct SceneFileMaterial
+{
+	char name[SCENE_FILE_NAME_LENGTH];
+	char texture[64];
+};
+
+// Collects a scene and writes it in the binary layout.
+class SceneFileWriter
+{
+public:
+	// both return the index objects refer to; adding a name twice returns the first
+	uint16_t addMaterial(const std::string& name, const std::string& texture);
+	uint16_t addMesh(const std::string& name, const Aabb& localBounds);
+	// later objects are placed in this group until the next one is added
+	uint16_t addGroup(const std::string& name, const glm::mat4& transform);
+
+	// an object at position in the current group's space; model is its own
+	// transform after the translation (rotation and scale)
+	void addObject(uint16_t mesh, uint16_t material, const glm::vec3& position, const glm::mat4& model, uint16_t flags);
+
+	int findMaterial(const std::string& name) const;
+	int findMesh(const std::string& name) const;
+	unsigned int objectCount() const { return (unsigned int)objects.size(); }
+	void setMeshBoundsHash(uint64_t hash) { meshBoundsHash = hash; }
+
+	bool write(const char* path) const;
+
+private:
+	uint64_t meshBoundsHash = 0;
+	std::vector<SceneFileGroup> groups;
+	std::vector<SceneFileMesh> meshes;
+	std::vector<Aabb> meshBounds;
+	std::vector<SceneFileMaterial> materials;
+
+	std::vector<glm::mat4> worlds;
+	std::vector<Aabb> bounds;
+	std::vector<glm::vec3> positions;
+	std::vector<SceneFileObject> objects;
+};
+
+// A mapped binary scene. The arrays point straight into the mapping and stay
+// valid until close().
+class SceneFile
+{
+public:
+	SceneFile() = default;
+	SceneFile(const SceneFile&) = delete;
+	SceneFile& operator=(const SceneFile&) = delete;
+	~SceneFile() { close(); }
+
+	bool open(const char* path);
+	void close();
+
+	// text description to binary; meshBounds gives the local bounds of every
+	// mesh name the text may use
+	static bool convert(const char* textPath, const char* binaryPath, const std::map<std::string, Aabb>& meshBounds);
+	// true when binaryPath is missing, older than textPath, written by another
+	// version or converted with other mesh bounds, whose world bounds it would
+	// still hold
+	static bool needsConvert(const char* textPath, const char* binaryPath, const std::map<std::string, Aabb>& meshBounds);
+	// FNV-1a over every name and its bounds
+	static uint64_t hashMeshBounds(const std::map<std::string, Aabb>& meshBounds);
+
+	uint32_t objectCount() const { return header->objectCount; }
+	const glm::mat4* worlds() const { return worldArray; }
+	const Aabb* bounds() const { return boundsArray; }
+	const glm::vec3* positions() const { return positionArray; }
+	const SceneFileObject* objects() const { return objectArray; }
+
+	uint32_t groupCount() const { return header->groupCount; }
+	const SceneFileGroup& group(uint32_t i) const { return groupArray[i]; }
+	uint32_t meshCount() const { return header->meshCount; }
+	const SceneFileMesh& mesh(uint32_t i) const { return meshArray[i]; }
+	uint32_t materialCount() const { return header->materialCount; }
+	const SceneFileMaterial& material(uint32_t i) const { return materialArray[i]; }
+
+private:
+	MappedFile mapped;
+
+	const SceneFileHeader* header = nullptr;
+	const glm::mat4* worldArray = nullptr;
+	const Aabb* boundsArray = nullptr;
+	const glm::vec3* positionArray = nullptr;
+	const SceneFileObject* objectArray = nullptr;
+	const SceneFileGroup* groupArray = nullptr;
+	const SceneFileMesh* meshArray = nullptr;
+	const SceneFileMaterial* materialArray = nullptr;
+};
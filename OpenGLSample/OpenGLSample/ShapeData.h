@@ -6,22 +6,31 @@
 
 
 
+// Indices are generated as 32-bit so no generator can overflow them; the GPU copy
+// uses the narrowest type that can address the shape's vertices.
 struct ShapeData
 {
+	// vertices a 16-bit index can address
+	static const GLuint MAX_SHORT_VERTICES = 65536;
+
 	ShapeData() :
 		vertices(0), numVertices(0),
 		indices(0), numIndices(0) {}
 	Vertex* vertices;
 	GLuint numVertices;
-	GLushort* indices;
+	GLuint* indices;
 	GLuint numIndices;
+	GLenum indexType() const
+	{
+		return numVertices <= MAX_SHORT_VERTICES ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	}
 	GLsizeiptr vertexBufferSize() const
 	{
 		return numVertices * sizeof(Vertex);
 	}
 	GLsizeiptr indexBufferSize() const
 	{
-		return numIndices * sizeof(GLushort);
+		return numIndices * (indexType() == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint));
 	}
 	void cleanup()
 	{
@@ -1,6 +1,10 @@
 #include "ShapeData.h"
 #include "ShapeGenerator.h"
+#include "ThreadPool.h"
 #include "Vertex.h"
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
 #include <vector>
 
 #define PI 3.14159265359
@@ -9,65 +13,156 @@ using glm::mat4;
 using glm::mat3;
 #define NUM_ARRAY_ELEMENTS(a) sizeof(a) / sizeof(*a)
 
-glm::vec3 randomColor()
+namespace
 {
-	glm::vec3 ret;
-	ret.x = rand() / (float)RAND_MAX;
-	ret.y = rand() / (float)RAND_MAX;
-	ret.z = rand() / (float)RAND_MAX;
-	return ret;
+	// Counter-based random numbers: the value for a counter is a hash of it (the
+	// SplitMix64 finalizer), so any thread can produce any vertex's color without
+	// shared state, unlike rand().
+	uint64_t mix(uint64_t x)
+	{
+		x += 0x9E3779B97F4A7C15ull;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+		return x ^ (x >> 31);
+	}
+
+	// three 21-bit channels of one hash
+	glm::vec3 randomColor(uint64_t counter)
+	{
+		uint64_t bits = mix(counter);
+		const float SCALE = 1.0f / 0x1FFFFF;
+		return glm::vec3((bits & 0x1FFFFF) * SCALE, ((bits >> 21) & 0x1FFFFF) * SCALE, ((bits >> 42) & 0x1FFFFF) * SCALE);
+	}
+
+	void forEachRow(uint rows, ThreadPool* pool, const std::function<void(unsigned int)>& row)
+	{
+		if (pool != nullptr)
+		{
+			pool->parallelFor(rows, row);
+			return;
+		}
+		for (uint i = 0; i < rows; i++)
+			row(i);
+	}
 }
 
 
-ShapeData ShapeGenerator::makePlaneVerts(uint dimensions)
+ShapeData ShapeGenerator::makePlaneVerts(uint dimensions, ThreadPool* pool)
 {
 	ShapeData ret;
 	ret.numVertices = dimensions * dimensions;
 	int half = dimensions / 2;
 	ret.vertices = new Vertex[ret.numVertices];
-	for (int i = 0; i < dimensions; i++)
-	{
-		for (int j = 0; j < dimensions; j++)
+	forEachRow(dimensions, pool, [&](unsigned int i) {
+		for (uint j = 0; j < dimensions; j++)
 		{
 			Vertex& thisVert = ret.vertices[i * dimensions + j];
-			thisVert.position.x = j - half;
-			thisVert.position.z = i - half;
+			thisVert.position.x = (float)((int)j - half);
+			thisVert.position.z = (float)((int)i - half);
 			thisVert.position.y = 0;
 			thisVert.normal = glm::vec3(0.0f, 1.0f, 0.0f);
-			thisVert.color = randomColor();
+			thisVert.color = randomColor(i * dimensions + j);
+			thisVert.texCoord = glm::vec2(j / float(dimensions - 1), i / float(dimensions - 1));
 		}
-	}
+	});
 	return ret;
 }
 
-ShapeData ShapeGenerator::makePlaneIndices(uint dimensions)
+ShapeData ShapeGenerator::makePlaneIndices(uint dimensions, ThreadPool* pool)
 {
 	ShapeData ret;
 	ret.numIndices = (dimensions - 1) * (dimensions - 1) * 2 * 3; // 2 triangles per square, 3 indices per triangle
-	ret.indices = new unsigned short[ret.numIndices];
-	int runner = 0;
-	for (int row = 0; row < dimensions - 1; row++)
-	{
-		for (int col = 0; col < dimensions - 1; col++)
+	ret.indices = new GLuint[ret.numIndices];
+	forEachRow(dimensions - 1, pool, [&](unsigned int row) {
+		GLuint* index = ret.indices + row * (dimensions - 1) * 6;
+		for (uint col = 0; col < dimensions - 1; col++)
 		{
-			ret.indices[runner++] = dimensions * row + col;
-			ret.indices[runner++] = dimensions * row + col + dimensions;
-			ret.indices[runner++] = dimensions * row + col + dimensions + 1;
+			*index++ = dimensions * row + col;
+			*index++ = dimensions * row + col + dimensions;
+			*index++ = dimensions * row + col + dimensions + 1;
 
-			ret.indices[runner++] = dimensions * row + col;
-			ret.indices[runner++] = dimensions * row + col + dimensions + 1;
-			ret.indices[runner++] = dimensions * row + col + 1;
+			*index++ = dimensions * row + col;
+			*index++ = dimensions * row + col + dimensions + 1;
+			*index++ = dimensions * row + col + 1;
 		}
-	}
-	assert(runner = ret.numIndices);
+	});
 	return ret;
 }
 
 
+ShapeData ShapeGenerator::makeCube()
+{
+	// 4 corners per face so every face gets its own normal and texture coordinates
+	static const float faces[6][4][8] = {
+		// positions            // normals            // texture coords
+		{ { -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f },
+		  {  0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f },
+		  {  0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f },
+		  { -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f } },
+		{ { -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f, 0.0f },
+		  {  0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f, 0.0f },
+		  {  0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f },
+		  { -0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f, 1.0f } },
+		{ { -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f },
+		  { -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 1.0f },
+		  { -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f },
+		  { -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 0.0f } },
+		{ {  0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f },
+		  {  0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f },
+		  {  0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f },
+		  {  0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f } },
+		{ { -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f },
+		  {  0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f },
+		  {  0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f },
+		  { -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f } },
+		{ { -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f },
+		  {  0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 1.0f },
+		  {  0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f },
+		  { -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f } },
+	};
+
+	ShapeData ret;
+	ret.numVertices = 24;
+	ret.vertices = new Vertex[ret.numVertices];
+	ret.numIndices = 36;
+	ret.indices = new GLuint[ret.numIndices];
+	for (uint face = 0; face < 6; face++)
+	{
+		for (uint corner = 0; corner < 4; corner++)
+		{
+			const float* v = faces[face][corner];
+			Vertex& thisVert = ret.vertices[face * 4 + corner];
+			thisVert.position = glm::vec3(v[0], v[1], v[2]);
+			thisVert.normal = glm::vec3(v[3], v[4], v[5]);
+			thisVert.texCoord = glm::vec2(v[6], v[7]);
+			thisVert.color = randomColor(face * 4 + corner);
+		}
+		// same winding as the old 36-vertex cube: corners 0-1-2 and 2-3-0
+		GLuint* index = ret.indices + face * 6;
+		GLuint base = face * 4;
+		index[0] = base;
+		index[1] = base + 1;
+		index[2] = base + 2;
+		index[3] = base + 2;
+		index[4] = base + 3;
+		index[5] = base;
+	}
+	return ret;
+}
+
 ShapeData ShapeGenerator::makePlane(uint dimensions)
 {
-	ShapeData ret = makePlaneVerts(dimensions);
-	ShapeData ret2 = makePlaneIndices(dimensions);
+	ShapeData ret = makePlaneVerts(dimensions, nullptr);
+	ShapeData ret2 = makePlaneIndices(dimensions, nullptr);
+	ret.numIndices = ret2.numIndices;
+	ret.indices = ret2.indices;
+	return ret;
+}
+
+ShapeData ShapeGenerator::makePlane(uint dimensions, ThreadPool& pool)
+{
+	ShapeData ret = makePlaneVerts(dimensions, &pool);
+	ShapeData ret2 = makePlaneIndices(dimensions, &pool);
 	ret.numIndices = ret2.numIndices;
 	ret.indices = ret2.indices;
 	return ret;
@@ -75,8 +170,18 @@ ShapeData ShapeGenerator::makePlane(uint dimensions)
 
 ShapeData ShapeGenerator::makeSphere(uint tesselation)
 {
-	ShapeData ret = makePlaneVerts(tesselation);
-	ShapeData ret2 = makePlaneIndices(tesselation);
+	return makeSphere(tesselation, nullptr);
+}
+
+ShapeData ShapeGenerator::makeSphere(uint tesselation, ThreadPool& pool)
+{
+	return makeSphere(tesselation, &pool);
+}
+
+ShapeData ShapeGenerator::makeSphere(uint tesselation, ThreadPool* pool)
+{
+	ShapeData ret = makePlaneVerts(tesselation, pool);
+	ShapeData ret2 = makePlaneIndices(tesselation, pool);
 	ret.indices = ret2.indices;
 	ret.numIndices = ret2.numIndices;
 
@@ -84,20 +189,30 @@ ShapeData ShapeGenerator::makeSphere(uint tesselation)
 	const float RADIUS = 1.0f;
 	const double CIRCLE = PI * 2;
 	const double SLICE_ANGLE = CIRCLE / (dimensions - 1);
-	for (size_t col = 0; col < dimensions; col++)
+	// phi only changes with the column and theta with the row, so their sines and
+	// cosines are tabulated once instead of evaluated for every vertex
+	std::vector<double> sinPhi(dimensions), cosPhi(dimensions), sinTheta(dimensions), cosTheta(dimensions);
+	for (uint i = 0; i < dimensions; i++)
 	{
-		double phi = -SLICE_ANGLE * col;
-		for (size_t row = 0; row < dimensions; row++)
+		double phi = -SLICE_ANGLE * i;
+		double theta = -(SLICE_ANGLE / 2.0) * i;
+		sinPhi[i] = sin(phi);
+		cosPhi[i] = cos(phi);
+		sinTheta[i] = sin(theta);
+		cosTheta[i] = cos(theta);
+	}
+	forEachRow(dimensions, pool, [&](unsigned int col) {
+		for (uint row = 0; row < dimensions; row++)
 		{
-			double theta = -(SLICE_ANGLE / 2.0) * row;
-			size_t vertIndex = col * dimensions + row;
+			size_t vertIndex = (size_t)col * dimensions + row;
 			Vertex& v = ret.vertices[vertIndex];
-			v.position.x = RADIUS * cos(phi) * sin(theta);
-			v.position.y = RADIUS * sin(phi) * sin(theta);
-			v.position.z = RADIUS * cos(theta);
+			v.position.x = RADIUS * cosPhi[col] * sinTheta[row];
+			v.position.y = RADIUS * sinPhi[col] * sinTheta[row];
+			v.position.z = RADIUS * cosTheta[row];
 			v.normal = glm::normalize(v.position);
+			v.texCoord = glm::vec2(col / float(dimensions - 1), row / float(dimensions - 1));
 		}
-	}
+	});
 	return ret;
 }
 
@@ -111,7 +226,7 @@ ShapeData ShapeGenerator::makeCylinder(uint dimensions)
 
 	// Calculate the number of indices
 	ret.numIndices = dimensions * 12; // Each segment has 2 triangles for the side and 1 for top and bottom caps
-	ret.indices = new GLushort[ret.numIndices];
+	ret.indices = new GLuint[ret.numIndices];
 
 	// Check if memory allocation succeeded
 	if (!ret.vertices || !ret.indices) {
@@ -136,17 +251,19 @@ ShapeData ShapeGenerator::makeCylinder(uint dimensions)
 		// Bottom vertex
 		ret.vertices[i * 2].position = glm::vec3(x, -HEIGHT / 2.0f, z);
 		ret.vertices[i * 2].normal = glm::normalize(glm::vec3(x, 0, z));
-		ret.vertices[i * 2].color = randomColor();
+		ret.vertices[i * 2].color = randomColor(i * 2);
+		ret.vertices[i * 2].texCoord = glm::vec2(i / float(dimensions), 0.0f);
 
 		// Top vertex
 		ret.vertices[i * 2 + 1].position = glm::vec3(x, HEIGHT / 2.0f, z);
 		ret.vertices[i * 2 + 1].normal = glm::normalize(glm::vec3(x, 0, z));
-		ret.vertices[i * 2 + 1].color = randomColor();
+		ret.vertices[i * 2 + 1].color = randomColor(i * 2 + 1);
+		ret.vertices[i * 2 + 1].texCoord = glm::vec2(i / float(dimensions), 1.0f);
 	}
 
 	// Add vertices for the top and bottom center points
-	ret.vertices[dimensions * 2] = { glm::vec3(0.0f, -HEIGHT / 2.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), randomColor() };
-	ret.vertices[dimensions * 2 + 1] = { glm::vec3(0.0f, HEIGHT / 2.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), randomColor() };
+	ret.vertices[dimensions * 2] = { glm::vec3(0.0f, -HEIGHT / 2.0f, 0.0f), randomColor(dimensions * 2), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec2(0.5f, 0.0f) };
+	ret.vertices[dimensions * 2 + 1] = { glm::vec3(0.0f, HEIGHT / 2.0f, 0.0f), randomColor(dimensions * 2 + 1), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(0.5f, 1.0f) };
 
 	// Generate indices for the side of the cylinder
 	for (uint i = 0; i < dimensions; ++i)
@@ -174,7 +291,229 @@ ShapeData ShapeGenerator::makeCylinder(uint dimensions)
 	return ret;
 }
 
+ShapeData ShapeGenerator::makeIcosphere(uint subdivisions)
+{
+	const float T = (1.0f + std::sqrt(5.0f)) / 2.0f;
+	std::vector<glm::vec3> positions = {
+		{ -1, T, 0 }, { 1, T, 0 }, { -1, -T, 0 }, { 1, -T, 0 },
+		{ 0, -1, T }, { 0, 1, T }, { 0, -1, -T }, { 0, 1, -T },
+		{ T, 0, -1 }, { T, 0, 1 }, { -T, 0, -1 }, { -T, 0, 1 },
+	};
+	// counter-clockwise seen from outside
+	std::vector<GLuint> triangles = {
+		0, 11, 5,  0, 5, 1,  0, 1, 7,  0, 7, 10,  0, 10, 11,
+		1, 5, 9,  5, 11, 4,  11, 10, 2,  10, 7, 6,  7, 1, 8,
+		3, 9, 4,  3, 4, 2,  3, 2, 6,  3, 6, 8,  3, 8, 9,
+		4, 9, 5,  2, 4, 11,  6, 2, 10,  8, 6, 7,  9, 8, 1,
+	};
+	for (glm::vec3& position : positions)
+		position = glm::normalize(position);
 
+	for (uint level = 0; level < subdivisions; level++)
+	{
+		// the midpoint of each edge, keyed by its two ends in either order
+		std::unordered_map<uint64_t, GLuint> midpoints;
+		midpoints.reserve(triangles.size() / 2);
+		auto midpoint = [&](GLuint a, GLuint b) {
+			uint64_t key = ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+			auto found = midpoints.find(key);
+			if (found != midpoints.end())
+				return found->second;
+			GLuint index = (GLuint)positions.size();
+			positions.push_back(glm::normalize(positions[a] + positions[b]));
+			midpoints.emplace(key, index);
+			return index;
+		};
+		std::vector<GLuint> finer;
+		finer.reserve(triangles.size() * 4);
+		for (size_t t = 0; t < triangles.size(); t += 3)
+		{
+			GLuint a = triangles[t], b = triangles[t + 1], c = triangles[t + 2];
+			GLuint ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+			GLuint pieces[12] = { a, ab, ca,  b, bc, ab,  c, ca, bc,  ab, bc, ca };
+			finer.insert(finer.end(), pieces, pieces + 12);
+		}
+		triangles.swap(finer);
+	}
+
+	// longitude and latitude as makeSphere() lays them out: z is the polar axis
+	const float TWO_PI = (float)(PI * 2);
+	std::vector<glm::vec2> texCoords(positions.size());
+	std::vector<bool> pole(positions.size());
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		const glm::vec3& p = positions[i];
+		float u = ((float)PI - std::atan2(p.y, p.x)) / TWO_PI;
+		texCoords[i] = glm::vec2(u - std::floor(u), std::acos(glm::clamp(p.z, -1.0f, 1.0f)) / (float)PI);
+		pole[i] = p.x * p.x + p.y * p.y < 1e-12f;
+	}
+	// A triangle across the seam gets copies of its vertices near u = 0 moved to
+	// u + 1, so it does not stretch back over the whole texture. A pole has no
+	// longitude of its own and takes the average of the triangle's other two.
+	std::vector<GLuint> wrapped(positions.size(), 0);
+	for (size_t t = 0; t < triangles.size(); t += 3)
+	{
+		GLuint* corner = &triangles[t];
+		float lowest = 1.0f, highest = 0.0f;
+		for (int k = 0; k < 3; k++)
+		{
+			if (pole[corner[k]])
+				continue;
+			lowest = std::min(lowest, texCoords[corner[k]].x);
+			highest = std::max(highest, texCoords[corner[k]].x);
+		}
+		if (highest - lowest > 0.5f)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				GLuint v = corner[k];
+				if (pole[v] || texCoords[v].x >= 0.5f)
+					continue;
+				if (wrapped[v] == 0)
+				{
+					wrapped[v] = (GLuint)positions.size();
+					positions.push_back(positions[v]);
+					texCoords.push_back(texCoords[v] + glm::vec2(1.0f, 0.0f));
+					pole.push_back(false);
+				}
+				corner[k] = wrapped[v];
+			}
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			GLuint v = corner[k];
+			if (!pole[v])
+				continue;
+			glm::vec2 texCoord = texCoords[v];
+			texCoord.x = (texCoords[corner[(k + 1) % 3]].x + texCoords[corner[(k + 2) % 3]].x) / 2.0f;
+			corner[k] = (GLuint)positions.size();
+			positions.push_back(positions[v]);
+			texCoords.push_back(texCoord);
+			pole.push_back(false);
+		}
+	}
+
+	ShapeData ret;
+	ret.numVertices = (GLuint)positions.size();
+	ret.vertices = new Vertex[ret.numVertices];
+	for (GLuint i = 0; i < ret.numVertices; i++)
+	{
+		Vertex& v = ret.vertices[i];
+		v.position = positions[i];
+		v.normal = positions[i];
+		v.texCoord = texCoords[i];
+		v.color = randomColor(i);
+	}
+	ret.numIndices = (GLuint)triangles.size();
+	ret.indices = new GLuint[ret.numIndices];
+	std::copy(triangles.begin(), triangles.end(), ret.indices);
+	return ret;
+}
+
+ShapeData ShapeGenerator::makeCubeSphere(uint n)
+{
+	// per face: its normal and two axes along the face with u x v = normal
+	static const float faces[6][3][3] = {
+		{ {  1, 0, 0 }, { 0, 0, -1 }, { 0, 1,  0 } },
+		{ { -1, 0, 0 }, { 0, 0,  1 }, { 0, 1,  0 } },
+		{ { 0,  1, 0 }, { 1, 0,  0 }, { 0, 0, -1 } },
+		{ { 0, -1, 0 }, { 1, 0,  0 }, { 0, 0,  1 } },
+		{ { 0, 0,  1 }, { 1, 0,  0 }, { 0, 1,  0 } },
+		{ { 0, 0, -1 }, { -1, 0, 0 }, { 0, 1,  0 } },
+	};
+	n = std::max(n, 1u);
+	uint side = n + 1;
 
+	// equal steps in angle rather than along the face, which keeps the cells
+	// near the face corners from shrinking
+	std::vector<float> offsets(side);
+	for (uint i = 0; i < side; i++)
+		offsets[i] = std::tan(((float)i / n * 2.0f - 1.0f) * (float)(PI / 4));
 
+	ShapeData ret;
+	ret.numVertices = 6 * side * side;
+	ret.vertices = new Vertex[ret.numVertices];
+	ret.numIndices = 6 * n * n * 6;
+	ret.indices = new GLuint[ret.numIndices];
+	GLuint* index = ret.indices;
+	for (uint face = 0; face < 6; face++)
+	{
+		glm::vec3 normal(faces[face][0][0], faces[face][0][1], faces[face][0][2]);
+		glm::vec3 u(faces[face][1][0], faces[face][1][1], faces[face][1][2]);
+		glm::vec3 v(faces[face][2][0], faces[face][2][1], faces[face][2][2]);
+		GLuint base = face * side * side;
+		for (uint j = 0; j < side; j++)
+		{
+			for (uint i = 0; i < side; i++)
+			{
+				Vertex& vertex = ret.vertices[base + j * side + i];
+				vertex.position = glm::normalize(normal + u * offsets[i] + v * offsets[j]);
+				vertex.normal = vertex.position;
+				vertex.texCoord = glm::vec2((float)i / n, (float)j / n);
+				vertex.color = randomColor(base + j * side + i);
+			}
+		}
+		for (uint j = 0; j < n; j++)
+		{
+			for (uint i = 0; i < n; i++)
+			{
+				GLuint a = base + j * side + i;
+				GLuint b = a + 1, c = a + side + 1, d = a + side;
+				*index++ = a; *index++ = b; *index++ = c;
+				*index++ = a; *index++ = c; *index++ = d;
+			}
+		}
+	}
+	return ret;
+}
 
+std::vector<ShapeData> ShapeGenerator::split(const ShapeData& shape, GLuint maxVertices)
+{
+	std::vector<ShapeData> pieces;
+	// where each vertex went in the current piece; stale entries are told apart
+	// by the piece they were written for
+	std::vector<GLuint> remap(shape.numVertices, 0);
+	std::vector<size_t> remapPiece(shape.numVertices, (size_t)-1);
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+
+	auto finishPiece = [&]() {
+		ShapeData piece;
+		piece.numVertices = (GLuint)vertices.size();
+		piece.vertices = new Vertex[piece.numVertices];
+		std::copy(vertices.begin(), vertices.end(), piece.vertices);
+		piece.numIndices = (GLuint)indices.size();
+		piece.indices = new GLuint[piece.numIndices];
+		std::copy(indices.begin(), indices.end(), piece.indices);
+		pieces.push_back(piece);
+		vertices.clear();
+		indices.clear();
+	};
+
+	for (GLuint t = 0; t + 2 < shape.numIndices; t += 3)
+	{
+		size_t piece = pieces.size();
+		GLuint added = 0;
+		for (int k = 0; k < 3; k++)
+			added += remapPiece[shape.indices[t + k]] == piece ? 0 : 1;
+		if (vertices.size() + added > maxVertices)
+		{
+			finishPiece();
+			piece++;
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			GLuint v = shape.indices[t + k];
+			if (remapPiece[v] != piece)
+			{
+				remapPiece[v] = piece;
+				remap[v] = (GLuint)vertices.size();
+				vertices.push_back(shape.vertices[v]);
+			}
+			indices.push_back(remap[v]);
+		}
+	}
+	if (!indices.empty())
+		finishPiece();
+	return pieces;
+}
@@ -1,21 +1,49 @@
 #pragma once
 #include <glm/glm.hpp>
 #include <cmath>
+#include <vector>
 #include "ShapeData.h"
 #include "Vertex.h"
 
 
 typedef unsigned int uint;
 
+class ThreadPool;
+
 class ShapeGenerator
 {
 private:
-    static ShapeData makePlaneVerts(uint dimensions);
-    static ShapeData makePlaneIndices(uint dimensions);
+    // pool may be null to fill the rows on the calling thread
+    static ShapeData makePlaneVerts(uint dimensions, ThreadPool* pool);
+    static ShapeData makePlaneIndices(uint dimensions, ThreadPool* pool);
+    static ShapeData makeSphere(uint tesselation, ThreadPool* pool);
 
 public:
+    static ShapeData makeCube();
     static ShapeData makePlane(uint dimensions = 10);
     static ShapeData makeSphere(uint tesselation = 20);
+    // Batch versions for large grids: the rows are filled in parallel on pool.
+    // Vertex colors come from a counter-based generator keyed by the vertex index,
+    // so the result is the same whatever the pool's thread count.
+    static ShapeData makePlane(uint dimensions, ThreadPool& pool);
+    static ShapeData makeSphere(uint tesselation, ThreadPool& pool);
     static ShapeData makeCylinder(uint dimensions = 10); // New method for creating a cylinder
+
+    // Unit spheres without poles full of slivers, for the same radius as
+    // makeSphere(). The icosphere splits every triangle of an icosahedron into
+    // four per subdivision, sharing each new edge midpoint between the two
+    // triangles on that edge; texture coordinates are the same longitude and
+    // latitude as makeSphere(), with vertices doubled along the seam. The cube
+    // sphere pushes an n x n grid on each face of a cube out onto the sphere,
+    // spaced by equal angles, and maps each face to the whole texture like
+    // makeCube().
+    static ShapeData makeIcosphere(uint subdivisions = 2);
+    static ShapeData makeCubeSphere(uint n = 8);
+
+    // Cuts a shape into pieces of consecutive triangles that each use at most
+    // maxVertices vertices, so every piece can be drawn with 16-bit indices.
+    // Vertices on a cut are copied into both pieces. Run the vertex cache pass
+    // first: its order keeps each piece compact and the cuts short.
+    static std::vector<ShapeData> split(const ShapeData& shape, GLuint maxVertices = ShapeData::MAX_SHORT_VERTICES);
 };
 
@@ -2,6 +2,19 @@
 #include <GLFW/glfw3.h>
 #include "ShapeGenerator.h"
 #include "ShapeData.h"
+#include "GeometryBuffer.h"
+#include "InstanceBatch.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "RenderStats.h"
+#include "LightBuffer.h"
+#include "RenderQueue.h"
+#include "StreamBuffer.h"
+#include "Scene.h"
+#include "Lod.h"
+#include "VoxelMesher.h"
+#include "SceneFile.h"
+#include "Benchmark.h"
 
 
 
@@ -11,6 +24,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <cstring>
+#include <map>
+#include <string>
 #include <vector>
 
 #include "shader.h"
@@ -44,22 +60,6 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-const uint NUM_VERTICES_PER_TRI = 3;
-const uint NUM_FLOATS_PER_VERTICE = 9;
-const uint VERTEX_BYTE_SIZE = NUM_FLOATS_PER_VERTICE * sizeof(float);
-
-GLuint sphereNumIndices;
-GLuint sphereVertexArrayObjectID;
-GLuint sphereIndexByteOffset;
-
-GLuint cylNumIndices;
-GLuint cylVertexArrayObjectID;
-GLuint cylIndexByteOffset;
-
-GLuint planeNumIndices;
-GLuint planeVertexArrayObjectID;
-GLuint planeIndexByteOffset;
-
 // projection matrix
 glm::mat4 projection;
 bool useOrthogonal = false;
@@ -68,9 +68,39 @@ float aspectRatio = (float)SCR_WIDTH / (float)SCR_HEIGHT;
 // lighting
 glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
 
-
-
-int main()
+// draw every static object through instanced batches (toggle with I)
+bool useInstancing = true;
+bool instancingKeyDown = false;
+// draw the unit-cube stacks as greedy-meshed voxel meshes instead of one cube each (toggle with V)
+bool useVoxelMeshes = true;
+bool voxelKeyDown = false;
+// cull through the scene's BVH rather than the flat SIMD test (toggle with B)
+bool useHierarchicalCulling = true;
+bool cullingKeyDown = false;
+// print the object straight ahead of the camera (F)
+bool pickRequested = false;
+bool pickKeyDown = false;
+// skip objects hidden behind the stairs, floor and wall (toggle with O)
+bool useOcclusionCulling = true;
+bool occlusionKeyDown = false;
+// draw each group of the scene file on the GPU result of last frame's bounding
+// box query (toggle with G)
+bool useOcclusionQueries = true;
+bool queriesKeyDown = false;
+// reuse the static objects' frustum test while the camera barely moves (toggle with C)
+bool useVisibilityCache = true;
+bool cacheKeyDown = false;
+float lastStatsReport = 0.0f;
+
+// uniforms set every frame or every draw, hashed at compile time
+constexpr Uniform<glm::mat4> VIEW_UNIFORM("view");
+constexpr Uniform<glm::mat4> PROJECTION_UNIFORM("projection");
+constexpr Uniform<glm::vec3> VIEW_POS_UNIFORM("viewPos");
+constexpr Uniform<float> SHININESS_UNIFORM("material.shininess");
+
+
+
+int main(int argc, char* argv[])
 {
 	// glfw: initialize and configure
 	// ------------------------------
@@ -112,458 +142,269 @@ int main()
 	// -----------------------------
 	glEnable(GL_DEPTH_TEST);
 
+	// measurements instead of the scene
+	if (argc > 1 && std::string(argv[1]) == "--benchmark")
+	{
+		benchmarkNormalMatrices();
+		benchmarkSceneFile();
+		benchmarkFrustumCulling();
+		benchmarkBvh();
+		benchmarkLooseOctree();
+		benchmarkMeshOptimizer();
+		benchmarkVertexFormats();
+		benchmarkIndexWidths();
+		benchmarkShapeGeneration();
+		benchmarkSphereGenerators();
+		benchmarkMeshCache();
+		benchmarkMeshlets();
+		benchmarkSimplifier();
+		benchmarkMeshFile();
+		glfwTerminate();
+		return 0;
+	}
+
 	// build and compile our shader zprogram
 	// ------------------------------------
-	Shader lightingShader("shaderfiles/6.multiple_lights.vs", "shaderfiles/6.multiple_lights.fs");
+	Shader lightingShader("shaderfiles/6.multiple_lights_normal.vs", "shaderfiles/6.multiple_lights.fs");
+	Shader instancedShader("shaderfiles/6.multiple_lights_instanced_normal.vs", "shaderfiles/6.multiple_lights.fs");
 	Shader lightCubeShader("shaderfiles/6.light_cube.vs", "shaderfiles/6.light_cube.fs");
+	// bounding boxes for the GPU occlusion queries, never seen on screen
+	Shader occlusionBoxShader("shaderfiles/occlusion_box.vs", "shaderfiles/occlusion_box.fs");
 
 	// set up vertex data (and buffer(s)) and configure vertex attributes
 	// ------------------------------------------------------------------
-	float verticesCube[] = {
-		// positions          // normals           // texture coords
-		-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
-		 0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  0.0f,
-		 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
-		 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
-		-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  1.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
-
-		-0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
-		 0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  0.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
-		-0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  1.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
-
-		-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-		-0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
-		-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-		-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-		-0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
-		-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-
-		 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-		 0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
-		 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-		 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-		 0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
-		 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-
-		-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
-		 0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  1.0f,
-		 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
-		 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
-		-0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  0.0f,
-		-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
-
-		-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f,
-		 0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  1.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
-		 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
-		-0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  0.0f,
-		-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f
-	};
-	// positions all containers
-	glm::vec3 cubePositions[] = {
-		//Left Side Stairs
-		glm::vec3(-5.0f, 5.0f,  0.0f),
-		glm::vec3(-4.0f, 4.0f, 0.0f),
-		glm::vec3(-3.0f, 3.0f, 0.0f),
-		glm::vec3(-2.0f, 2.0f, 0.0f),
-		glm::vec3(-1.0f, 1.0f, 0.0f),
-		glm::vec3(0.0f, 0.0f, 0.0f),
-
-		//Center Stairs
-		glm::vec3(-5.0f, 5.0f,  1.0f),
-		glm::vec3(-4.0f, 4.0f, 1.0f),
-		glm::vec3(-3.0f, 3.0f, 1.0f),
-		glm::vec3(-2.0f, 2.0f, 1.0f),
-		glm::vec3(-1.0f, 1.0f, 1.0f),
-		glm::vec3(0.0f, 0.0f, 1.0f),
-
-		//Right Side Stairs
-		glm::vec3(-5.0f, 5.0f,  2.0f),
-		glm::vec3(-4.0f, 4.0f, 2.0f),
-		glm::vec3(-3.0f, 3.0f, 2.0f),
-		glm::vec3(-2.0f, 2.0f, 2.0f),
-		glm::vec3(-1.0f, 1.0f, 2.0f),
-		glm::vec3(0.0f, 0.0f, 2.0f)
-	};
-	auto numCubes = std::size(cubePositions);
-
-	//Banister Cubes
-	glm::vec3 bannCubePositions[] = {
-		glm::vec3(1.0f, 0.0f, 8.0f),
-		glm::vec3(1.0f, 1.0f, 8.0f),
-		glm::vec3(1.0f, 2.0f, 8.0f),
-		glm::vec3(1.0f, 3.0f, 8.0f),
-		glm::vec3(1.0f, 4.0f, 8.0f),
-		glm::vec3(1.0f, 5.0f, 8.0f),
-		glm::vec3(1.0f, 6.0f, 8.0f),
-		glm::vec3(1.0f, 7.0f, 8.0f),
-
-	};
-	auto numSmallCubes = std::size(bannCubePositions);
-
-	//Railing Cubes
-	glm::vec3 railCubePositions[] = {
-		glm::vec3(7.0f, 6.0f, 12.0f),
-		glm::vec3(7.0f, 7.0f, 12.0f),
-		glm::vec3(7.0f, 8.0f, 12.0f),
-		glm::vec3(7.0f, 9.0f, 12.0f),
-		glm::vec3(7.0f, 10.0f, 12.0f),
-		glm::vec3(7.0f, 11.0f, 12.0f),
-		glm::vec3(7.0f, 12.0f, 12.0f),
-		glm::vec3(7.0f, 13.0f, 12.0f),
-		glm::vec3(7.0f, 14.0f, 12.0f),
-		glm::vec3(7.0f, 15.0f, 12.0f),
-		glm::vec3(7.0f, 16.0f, 12.0f),
-		glm::vec3(7.0f, 17.0f, 12.0f),
-		glm::vec3(7.0f, 18.0f, 12.0f),
-		glm::vec3(7.0f, 19.0f, 12.0f),
-		glm::vec3(7.0f, 20.0f, 12.0f),
-		glm::vec3(7.0f, 21.0f, 12.0f),
-		glm::vec3(7.0f, 22.0f, 12.0f),
-		glm::vec3(7.0f, 23.0f, 12.0f),
-		glm::vec3(7.0f, 24.0f, 12.0f),
-		glm::vec3(7.0f, 25.0f, 12.0f),
-		glm::vec3(7.0f, 26.0f, 12.0f),
-		glm::vec3(7.0f, 27.0f, 12.0f),
-		glm::vec3(7.0f, 28.0f, 12.0f),
-		glm::vec3(7.0f, 29.0f, 12.0f),
-		glm::vec3(7.0f, 30.0f, 12.0f),
-		glm::vec3(7.0f, 31.0f, 12.0f),
-		glm::vec3(7.0f, 32.0f, 12.0f),
-		glm::vec3(7.0f, 33.0f, 12.0f),
-		glm::vec3(7.0f, 34.0f, 12.0f),
-		glm::vec3(7.0f, 35.0f, 12.0f),
-		glm::vec3(7.0f, 36.0f, 12.0f),
-		glm::vec3(7.0f, 37.0f, 12.0f),
-		glm::vec3(7.0f, 38.0f, 12.0f),
-		glm::vec3(7.0f, 39.0f, 12.0f),
-		glm::vec3(7.0f, 40.0f, 12.0f),
-		glm::vec3(7.0f, 41.0f, 12.0f),
-
-	};
-	auto numRailCubes = std::size(railCubePositions);
-
-	glm::vec3 vertRailPositions[] = {
-		//First Post
-		glm::vec3(-2.0f, 5.0f, 24.0f),
-		glm::vec3(-2.0f, 6.0f, 24.0f),
-		glm::vec3(-2.0f, 7.0f, 24.0f),
-		glm::vec3(-2.0f, 8.0f, 24.0f),
-		glm::vec3(-2.0f, 9.0f, 24.0f),
-		glm::vec3(-2.0f, 10.0f, 24.0f),
-		glm::vec3(-2.0f, 11.0f, 24.0f),
-		glm::vec3(-2.0f, 12.0f, 24.0f),
-		glm::vec3(-2.0f, 13.0f, 24.0f),
-		glm::vec3(-2.0f, 14.0f, 24.0f),
-		glm::vec3(-2.0f, 15.0f, 24.0f),
-		glm::vec3(-2.0f, 16.0f, 24.0f),
-		glm::vec3(-2.0f, 17.0f, 24.0f),
-		glm::vec3(-2.0f, 18.0f, 24.0f),
-		glm::vec3(-2.0f, 19.0f, 24.0f),
-		glm::vec3(-2.0f, 20.0f, 24.0f),
-		glm::vec3(-2.0f, 21.0f, 24.0f),
-		glm::vec3(-2.0f, 22.0f, 24.0f),
-
-		//Second Post
-		glm::vec3(-7.0f, 9.0f, 24.0f),
-		glm::vec3(-7.0f, 10.0f, 24.0f),
-		glm::vec3(-7.0f, 11.0f, 24.0f),
-		glm::vec3(-7.0f, 12.0f, 24.0f),
-		glm::vec3(-7.0f, 13.0f, 24.0f),
-		glm::vec3(-7.0f, 14.0f, 24.0f),
-		glm::vec3(-7.0f, 15.0f, 24.0f),
-		glm::vec3(-7.0f, 16.0f, 24.0f),
-		glm::vec3(-7.0f, 17.0f, 24.0f),
-		glm::vec3(-7.0f, 18.0f, 24.0f),
-		glm::vec3(-7.0f, 19.0f, 24.0f),
-		glm::vec3(-7.0f, 20.0f, 24.0f),
-		glm::vec3(-7.0f, 21.0f, 24.0f),
-		glm::vec3(-7.0f, 22.0f, 24.0f),
-		glm::vec3(-7.0f, 23.0f, 24.0f),
-		glm::vec3(-7.0f, 24.0f, 24.0f),
-		glm::vec3(-7.0f, 25.0f, 24.0f),
-		glm::vec3(-7.0f, 26.0f, 24.0f),
-
-		//Third Post
-		glm::vec3(-12.0f, 13.0f, 24.0f),
-		glm::vec3(-12.0f, 14.0f, 24.0f),
-		glm::vec3(-12.0f, 15.0f, 24.0f),
-		glm::vec3(-12.0f, 16.0f, 24.0f),
-		glm::vec3(-12.0f, 17.0f, 24.0f),
-		glm::vec3(-12.0f, 18.0f, 24.0f),
-		glm::vec3(-12.0f, 19.0f, 24.0f),
-		glm::vec3(-12.0f, 20.0f, 24.0f),
-		glm::vec3(-12.0f, 21.0f, 24.0f),
-		glm::vec3(-12.0f, 22.0f, 24.0f),
-		glm::vec3(-12.0f, 23.0f, 24.0f),
-		glm::vec3(-12.0f, 24.0f, 24.0f),
-		glm::vec3(-12.0f, 25.0f, 24.0f),
-		glm::vec3(-12.0f, 26.0f, 24.0f),
-		glm::vec3(-12.0f, 27.0f, 24.0f),
-		glm::vec3(-12.0f, 28.0f, 24.0f),
-		glm::vec3(-12.0f, 29.0f, 24.0f),
-		glm::vec3(-12.0f, 30.0f, 24.0f),
-		glm::vec3(-12.0f, 31.0f, 24.0f),
-
-		//Fourth Post
-		glm::vec3(-17.0f, 18.0f, 24.0f),
-		glm::vec3(-17.0f, 19.0f, 24.0f),
-		glm::vec3(-17.0f, 20.0f, 24.0f),
-		glm::vec3(-17.0f, 21.0f, 24.0f),
-		glm::vec3(-17.0f, 22.0f, 24.0f),
-		glm::vec3(-17.0f, 23.0f, 24.0f),
-		glm::vec3(-17.0f, 24.0f, 24.0f),
-		glm::vec3(-17.0f, 25.0f, 24.0f),
-		glm::vec3(-17.0f, 26.0f, 24.0f),
-		glm::vec3(-17.0f, 27.0f, 24.0f),
-		glm::vec3(-17.0f, 28.0f, 24.0f),
-		glm::vec3(-17.0f, 29.0f, 24.0f),
-		glm::vec3(-17.0f, 30.0f, 24.0f),
-		glm::vec3(-17.0f, 31.0f, 24.0f),
-		glm::vec3(-17.0f, 32.0f, 24.0f),
-		glm::vec3(-17.0f, 33.0f, 24.0f),
-		glm::vec3(-17.0f, 34.0f, 24.0f),
-		glm::vec3(-17.0f, 35.0f, 24.0f),
-		glm::vec3(-17.0f, 36.0f, 24.0f),
-
-		//Fifth Post
-		glm::vec3(-22.0f, 23.0f, 24.0f),
-		glm::vec3(-22.0f, 24.0f, 24.0f),
-		glm::vec3(-22.0f, 25.0f, 24.0f),
-		glm::vec3(-22.0f, 26.0f, 24.0f),
-		glm::vec3(-22.0f, 27.0f, 24.0f),
-		glm::vec3(-22.0f, 28.0f, 24.0f),
-		glm::vec3(-22.0f, 29.0f, 24.0f),
-		glm::vec3(-22.0f, 30.0f, 24.0f),
-		glm::vec3(-22.0f, 31.0f, 24.0f),
-		glm::vec3(-22.0f, 32.0f, 24.0f),
-		glm::vec3(-22.0f, 33.0f, 24.0f),
-		glm::vec3(-22.0f, 34.0f, 24.0f),
-		glm::vec3(-22.0f, 35.0f, 24.0f),
-		glm::vec3(-22.0f, 36.0f, 24.0f),
-		glm::vec3(-22.0f, 37.0f, 24.0f),
-		glm::vec3(-22.0f, 38.0f, 24.0f),
-		glm::vec3(-22.0f, 39.0f, 24.0f),
-		glm::vec3(-22.0f, 40.0f, 24.0f),
-		glm::vec3(-22.0f, 41.0f, 24.0f),
-
-		//Fifth Post
-		glm::vec3(-27.0f, 28.0f, 24.0f),
-		glm::vec3(-27.0f, 29.0f, 24.0f),
-		glm::vec3(-27.0f, 30.0f, 24.0f),
-		glm::vec3(-27.0f, 31.0f, 24.0f),
-		glm::vec3(-27.0f, 32.0f, 24.0f),
-		glm::vec3(-27.0f, 33.0f, 24.0f),
-		glm::vec3(-27.0f, 34.0f, 24.0f),
-		glm::vec3(-27.0f, 35.0f, 24.0f),
-		glm::vec3(-27.0f, 36.0f, 24.0f),
-		glm::vec3(-27.0f, 37.0f, 24.0f),
-		glm::vec3(-27.0f, 38.0f, 24.0f),
-		glm::vec3(-27.0f, 39.0f, 24.0f),
-		glm::vec3(-27.0f, 40.0f, 24.0f),
-		glm::vec3(-27.0f, 41.0f, 24.0f),
-		glm::vec3(-27.0f, 42.0f, 24.0f),
-		glm::vec3(-27.0f, 43.0f, 24.0f),
-		glm::vec3(-27.0f, 44.0f, 24.0f),
-		glm::vec3(-27.0f, 45.0f, 24.0f),
-		glm::vec3(-27.0f, 46.0f, 24.0f),
-
-		// Sixth Post
-		glm::vec3(-32.0f, 33.0f, 24.0f),
-		glm::vec3(-32.0f, 34.0f, 24.0f),
-		glm::vec3(-32.0f, 35.0f, 24.0f),
-		glm::vec3(-32.0f, 36.0f, 24.0f),
-		glm::vec3(-32.0f, 37.0f, 24.0f),
-		glm::vec3(-32.0f, 38.0f, 24.0f),
-		glm::vec3(-32.0f, 39.0f, 24.0f),
-		glm::vec3(-32.0f, 40.0f, 24.0f),
-		glm::vec3(-32.0f, 41.0f, 24.0f),
-		glm::vec3(-32.0f, 42.0f, 24.0f),
-		glm::vec3(-32.0f, 43.0f, 24.0f),
-		glm::vec3(-32.0f, 44.0f, 24.0f),
-		glm::vec3(-32.0f, 45.0f, 24.0f),
-		glm::vec3(-32.0f, 46.0f, 24.0f),
-		glm::vec3(-32.0f, 47.0f, 24.0f),
-		glm::vec3(-32.0f, 48.0f, 24.0f),
-		glm::vec3(-32.0f, 49.0f, 24.0f),
-		glm::vec3(-32.0f, 50.0f, 24.0f),
-		glm::vec3(-32.0f, 51.0f, 24.0f),
-
-		// Seventh Post
-		glm::vec3(-37.0f, 38.0f, 24.0f),
-		glm::vec3(-37.0f, 39.0f, 24.0f),
-		glm::vec3(-37.0f, 40.0f, 24.0f),
-		glm::vec3(-37.0f, 41.0f, 24.0f),
-		glm::vec3(-37.0f, 42.0f, 24.0f),
-		glm::vec3(-37.0f, 43.0f, 24.0f),
-		glm::vec3(-37.0f, 44.0f, 24.0f),
-		glm::vec3(-37.0f, 45.0f, 24.0f),
-		glm::vec3(-37.0f, 46.0f, 24.0f),
-		glm::vec3(-37.0f, 47.0f, 24.0f),
-		glm::vec3(-37.0f, 48.0f, 24.0f),
-		glm::vec3(-37.0f, 49.0f, 24.0f),
-		glm::vec3(-37.0f, 50.0f, 24.0f),
-		glm::vec3(-37.0f, 51.0f, 24.0f),
-		glm::vec3(-37.0f, 52.0f, 24.0f),
-		glm::vec3(-37.0f, 53.0f, 24.0f),
-		glm::vec3(-37.0f, 54.0f, 24.0f),
-		glm::vec3(-37.0f, 55.0f, 24.0f),
-		glm::vec3(-37.0f, 56.0f, 24.0f),
-
-		// Eighth Post
-		glm::vec3(-42.0f, 43.0f, 24.0f),
-		glm::vec3(-42.0f, 44.0f, 24.0f),
-		glm::vec3(-42.0f, 45.0f, 24.0f),
-		glm::vec3(-42.0f, 46.0f, 24.0f),
-		glm::vec3(-42.0f, 47.0f, 24.0f),
-		glm::vec3(-42.0f, 48.0f, 24.0f),
-		glm::vec3(-42.0f, 49.0f, 24.0f),
-		glm::vec3(-42.0f, 50.0f, 24.0f),
-		glm::vec3(-42.0f, 51.0f, 24.0f),
-		glm::vec3(-42.0f, 52.0f, 24.0f),
-		glm::vec3(-42.0f, 53.0f, 24.0f),
-		glm::vec3(-42.0f, 54.0f, 24.0f),
-		glm::vec3(-42.0f, 55.0f, 24.0f),
-		glm::vec3(-42.0f, 56.0f, 24.0f),
-		glm::vec3(-42.0f, 57.0f, 24.0f),
-		glm::vec3(-42.0f, 58.0f, 24.0f),
-		glm::vec3(-42.0f, 59.0f, 24.0f),
-		glm::vec3(-42.0f, 60.0f, 24.0f),
-		glm::vec3(-42.0f, 61.0f, 24.0f),
-
-		// Ninth Post
-		glm::vec3(-47.0f, 48.0f, 24.0f),
-		glm::vec3(-47.0f, 49.0f, 24.0f),
-		glm::vec3(-47.0f, 50.0f, 24.0f),
-		glm::vec3(-47.0f, 51.0f, 24.0f),
-		glm::vec3(-47.0f, 52.0f, 24.0f),
-		glm::vec3(-47.0f, 53.0f, 24.0f),
-		glm::vec3(-47.0f, 54.0f, 24.0f),
-		glm::vec3(-47.0f, 55.0f, 24.0f),
-		glm::vec3(-47.0f, 56.0f, 24.0f),
-		glm::vec3(-47.0f, 57.0f, 24.0f),
-		glm::vec3(-47.0f, 58.0f, 24.0f),
-		glm::vec3(-47.0f, 59.0f, 24.0f),
-		glm::vec3(-47.0f, 60.0f, 24.0f),
-		glm::vec3(-47.0f, 61.0f, 24.0f),
-		glm::vec3(-47.0f, 62.0f, 24.0f),
-		glm::vec3(-47.0f, 63.0f, 24.0f),
-		glm::vec3(-47.0f, 64.0f, 24.0f),
-		glm::vec3(-47.0f, 65.0f, 24.0f),
-		glm::vec3(-47.0f, 66.0f, 24.0f)
-	};
-	auto numVertRails = std::size(vertRailPositions);
-	
 	glm::vec3 pointLightPositions[] = {
 		glm::vec3(-0.7f,  10.0f,  2.0f),
 		glm::vec3(-2.3f, 10.0f, -4.0f),
 		glm::vec3(-4.0f,  10.0f, -12.0f),
 		glm::vec3(-7.0f,  10.0f, -3.0f)
 	};
-	// first, configure the cube's VAO (and VBO)
-	unsigned int VBO, cubeVAO;
-	glGenVertexArrays(1, &cubeVAO);
-	glGenBuffers(1, &VBO);
-
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verticesCube), verticesCube, GL_STATIC_DRAW);
-
-	glBindVertexArray(cubeVAO);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-
-	// second, configure the light's VAO (VBO stays the same; the vertices are the same for the light object which is also a 3D cube)
-	unsigned int lightCubeVAO;
-	glGenVertexArrays(1, &lightCubeVAO);
-	glBindVertexArray(lightCubeVAO);
-
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	// note that we update the lamp's position attribute's stride to reflect the updated buffer data
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	ShapeData sphere = ShapeGenerator::makeSphere();
-
-	GLsizeiptr currentOffset = 0;
-	unsigned int sphereVBO{}, sphereVAO;
-	glGenVertexArrays(1, &sphereVAO);
-	glGenBuffers(1, &sphereVBO);
-	glBindVertexArray(sphereVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
-	glBufferData(GL_ARRAY_BUFFER, sphere.vertexBufferSize() + sphere.indexBufferSize(), 0, GL_STATIC_DRAW);
-	currentOffset = 0;
-	glBufferSubData(GL_ARRAY_BUFFER, currentOffset, sphere.vertexBufferSize(), sphere.vertices);
-	currentOffset += sphere.vertexBufferSize();
-	sphereIndexByteOffset = currentOffset;
-	glBufferSubData(GL_ARRAY_BUFFER, currentOffset, sphere.indexBufferSize(), sphere.indices);
-	sphereNumIndices = sphere.numIndices;
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTE_SIZE, (void*)0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTE_SIZE, (void*)(sizeof(float) * 3));
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTE_SIZE, (void*)(sizeof(float) * 6));
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereVBO);
-
-	ShapeData cyl = ShapeGenerator::makeCylinder();
-
-	unsigned int cylVBO{}, cylVAO;
-	glGenVertexArrays(1, &cylVAO);
-	glGenBuffers(1, &cylVBO);
-	glBindVertexArray(cylVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, cylVBO);
-	glBufferData(GL_ARRAY_BUFFER, cyl.vertexBufferSize() + cyl.indexBufferSize(), 0, GL_STATIC_DRAW);
-	currentOffset = 0;
-	glBufferSubData(GL_ARRAY_BUFFER, currentOffset, cyl.vertexBufferSize(), cyl.vertices);
-	currentOffset += cyl.vertexBufferSize();
-	cylIndexByteOffset = currentOffset;
-	glBufferSubData(GL_ARRAY_BUFFER, currentOffset, cyl.indexBufferSize(), cyl.indices);
-	cylNumIndices = cyl.numIndices;
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTE_SIZE, (void*)0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTE_SIZE, (void*)(sizeof(float) * 3));
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTE_SIZE, (void*)(sizeof(float) * 6));
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cylVBO);
-
-
-	ShapeData plane = ShapeGenerator::makePlane();
-
-	unsigned int planeVBO{}, planeVAO;
-	glGenVertexArrays(1, &planeVAO);
-	glGenBuffers(1, &planeVBO);
-	glBindVertexArray(planeVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-	glBufferData(GL_ARRAY_BUFFER, plane.vertexBufferSize() + plane.indexBufferSize(), 0, GL_STATIC_DRAW);
-	currentOffset = 0;
-	glBufferSubData(GL_ARRAY_BUFFER, currentOffset, plane.vertexBufferSize(), plane.vertices);
-	currentOffset += plane.vertexBufferSize();
-	planeIndexByteOffset = currentOffset;
-	glBufferSubData(GL_ARRAY_BUFFER, currentOffset, plane.indexBufferSize(), plane.indices);
-	planeNumIndices = plane.numIndices;
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTE_SIZE, (void*)0);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTE_SIZE, (void*)(sizeof(float) * 3));
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTE_SIZE, (void*)(sizeof(float) * 6));
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, planeVBO);
+	// every shape lives in one shared vertex/index buffer behind a single VAO,
+	// stored in the 20-byte compact layout. Each one's triangles are reordered for
+	// the vertex cache, then to draw its outward-facing parts first, before it is
+	// added. Generated shapes come from the mesh cache, so each is made once.
+	// -----------------------------------------------------------------------
+	GeometryBuffer geometry(GeometryBuffer::COMPACT_VERTICES);
+	MeshCache meshes(geometry);
+	std::vector<MeshHandle> meshHandles;
+	meshHandles.push_back(meshes.get({ MeshKey::CUBE, 0 }));
+	meshHandles.push_back(meshes.get({ MeshKey::PLANE, 10 }));
+	MeshDraw cubeMesh = meshHandles[0].draw();
+	MeshDraw planeMesh = meshHandles[1].draw();
+
+	Aabb cubeBounds = meshHandles[0].bounds();
+	Aabb planeBounds = meshHandles[1].bounds();
+
+	// spheres and cylinders at a few tessellations each, the default one first;
+	// every object picks a level from its size on screen. The coarser counts are
+	// chosen so their vertices stay inside the finest level's bounds.
+	struct LodLevel { uint tessellation; float minScreenSize; };
+	const LodLevel sphereLevels[] = { { 20, 0.15f }, { 12, 0.06f }, { 8, 0.025f }, { 6, 0.0f } };
+	const LodLevel cylinderLevels[] = { { 10, 0.1f }, { 6, 0.03f }, { 5, 0.0f } };
+	LodChain sphereLod, cylinderLod;
+	for (const LodLevel& level : sphereLevels) {
+		meshHandles.push_back(meshes.get({ MeshKey::SPHERE, level.tessellation }));
+		sphereLod.addLevel(meshHandles.back().draw(), meshHandles.back().bounds(), level.minScreenSize);
+	}
+	for (const LodLevel& level : cylinderLevels) {
+		meshHandles.push_back(meshes.get({ MeshKey::CYLINDER, level.tessellation }));
+		cylinderLod.addLevel(meshHandles.back().draw(), meshHandles.back().bounds(), level.minScreenSize);
+	}
+
+	// the stairwell layout, mapped from its binary scene file; the file is rebuilt
+	// from the text description first whenever that has been edited
+	// -----------------------------------------------------------------------------
+	const char* sceneText = "scenefiles/stairwell.txt";
+	const char* sceneBinary = "scenefiles/stairwell.scn";
+	struct NamedShape { const char* name; MeshDraw mesh; Aabb bounds; const LodChain* lod; };
+	const NamedShape shapes[] = {
+		{ "cube", cubeMesh, cubeBounds, nullptr },
+		{ "sphere", sphereLod.levels[0], sphereLod.bounds, &sphereLod },
+		{ "cylinder", cylinderLod.levels[0], cylinderLod.bounds, &cylinderLod },
+		{ "plane", planeMesh, planeBounds, nullptr }
+	};
+	std::map<std::string, Aabb> shapeBounds;
+	for (const NamedShape& shape : shapes)
+		shapeBounds[shape.name] = shape.bounds;
+	if (SceneFile::needsConvert(sceneText, sceneBinary, shapeBounds))
+		SceneFile::convert(sceneText, sceneBinary, shapeBounds);
+	SceneFile layout;
+	// the binary is only a cache of the text: a damaged one is converted again
+	if (!layout.open(sceneBinary) && !(SceneFile::convert(sceneText, sceneBinary, shapeBounds) && layout.open(sceneBinary)))
+	{
+		glfwTerminate();
+		return -1;
+	}
+
+	// the file's mesh names resolved to shapes in the geometry buffer
+	std::vector<MeshDraw> layoutMeshes(layout.meshCount(), cubeMesh);
+	std::vector<const LodChain*> layoutLods(layout.meshCount(), nullptr);
+	std::vector<Aabb> layoutBounds(layout.meshCount(), cubeBounds);
+	std::vector<bool> layoutCubes(layout.meshCount(), false);
+	for (uint32_t i = 0; i < layout.meshCount(); i++) {
+		bool found = false;
+		for (const NamedShape& shape : shapes) {
+			if (strcmp(layout.mesh(i).name, shape.name) == 0) {
+				layoutMeshes[i] = shape.mesh;
+				layoutBounds[i] = shape.bounds;
+				layoutLods[i] = shape.lod;
+				found = true;
+			}
+		}
+		layoutCubes[i] = strcmp(layout.mesh(i).name, "cube") == 0;
+		if (!found)
+			std::cout << "ERROR::SCENE::UNKNOWN_MESH: " << layout.mesh(i).name << std::endl;
+	}
+
+	// the cubes placed on a group's lattice are also voxels of that lattice:
+	// interior faces are dropped and coplanar faces merged, giving one mesh per
+	// material
+	VoxelMesher voxels;
+	std::vector<int> groupVolumes(layout.groupCount(), -1);
+	std::vector<bool> voxelCells(layout.objectCount(), false);
+	for (uint32_t i = 0; i < layout.objectCount(); i++) {
+		const SceneFileObject& object = layout.objects()[i];
+		if (!(object.flags & SCENE_OBJECT_CELL) || !layoutCubes[object.mesh])
+			continue;
+		if (groupVolumes[object.group] < 0)
+			groupVolumes[object.group] = (int)voxels.addVolume(layout.group(object.group).transform);
+		voxels.setVoxel(groupVolumes[object.group], glm::ivec3(layout.positions()[i]), (uint8_t)(object.material + 1));
+		voxelCells[i] = true;
+	}
+	voxels.update();
+	std::vector<MeshDraw> voxelMeshes;
+	std::vector<Aabb> voxelBounds;
+	std::vector<uint32_t> voxelMaterials;
+	for (uint32_t material = 0; material < layout.materialCount(); material++) {
+		ShapeData mesh = voxels.buildMesh((uint8_t)(material + 1));
+		if (mesh.numVertices > 0) {
+			MeshOptimizer::optimize(mesh);
+			voxelMeshes.push_back(geometry.add(mesh));
+			voxelBounds.push_back(Aabb::fromShape(mesh));
+			voxelMaterials.push_back(material);
+		}
+		mesh.cleanup();
+	}
+	std::cout << "voxel meshing: " << voxels.cubeCount() << " cubes, triangles " << voxels.cubeCount() * cubeMesh.count / 3
+		<< " -> " << voxels.triangleCount() << ", per-object draws " << voxels.cubeCount()
+		<< " -> " << voxelMeshes.size() << std::endl;
+
+	geometry.upload();
+	geometry.configure(lightingShader);
+	geometry.configure(instancedShader);
+	std::cout << "geometry: " << geometry.numVertices() << " vertices, " << geometry.vertexBufferSize() / 1024 << " KB of vertex data ("
+		<< geometry.numVertices() * sizeof(Vertex) / 1024 << " KB as floats)" << std::endl;
+	std::cout << "mesh cache:" << std::endl;
+	meshes.report(std::cout);
 
 	// load textures
 	// -----------------------------------------------------------------------------
-	unsigned int textureWood0 = loadTexture("wood.jpg");
-	unsigned int textureCarpet1 = loadTexture("carpet.jpg");
-	unsigned int textureWood2 = loadTexture("banWood.jpg");
-	unsigned int textureWall3 = loadTexture("wall.jpg");
+	std::vector<GLuint> materialTextures(layout.materialCount());
+	for (uint32_t i = 0; i < layout.materialCount(); i++)
+		materialTextures[i] = loadTexture(layout.material(i).texture);
+
+	// lights: one uniform buffer shared by the lighting programs and the lamp program
+	// -------------------------------------------------------------------------------
+	LightBuffer lights;
+	lights.create();
+	lights.bindTo(lightingShader);
+	lights.bindTo(instancedShader);
+
+	// directional light
+	DirLight dirLight = {};
+	dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+	dirLight.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+	dirLight.diffuse = glm::vec3(0.4f, 0.4f, 0.4f);
+	lights.setDirLight(dirLight);
+
+	// point lights
+	glm::vec3 pointLightAmbient[] = {
+		glm::vec3(0.1f, 0.05f, 0.05f),
+		glm::vec3(0.05f, 0.05f, 0.05f),
+		glm::vec3(0.1f, 0.05f, 0.1f),
+		glm::vec3(0.05f, 0.05f, 0.05f)
+	};
+	glm::vec3 pointLightDiffuse[] = {
+		glm::vec3(1.0f, 1.0f, 1.0f),
+		glm::vec3(0.8f, 0.8f, 0.8f),
+		glm::vec3(0.8f, 0.8f, 0.8f),
+		glm::vec3(0.8f, 0.8f, 0.8f)
+	};
+	for (unsigned int i = 0; i < std::size(pointLightPositions); i++) {
+		PointLight pointLight = {};
+		pointLight.position = pointLightPositions[i];
+		pointLight.ambient = pointLightAmbient[i];
+		pointLight.diffuse = pointLightDiffuse[i];
+		pointLight.constant = 1.0f;
+		pointLight.linear = 0.09f;
+		pointLight.quadratic = 0.032f;
+		lights.addPointLight(pointLight);
+	}
+
+	// spotLight, moved with the camera in the render loop
+	SpotLight spotLight = {};
+	spotLight.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+	spotLight.constant = 1.0f;
+	spotLight.linear = 0.09f;
+	spotLight.quadratic = 0.032f;
+	spotLight.cutOff = glm::cos(glm::radians(12.5f));
+	spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
+
+	RenderQueue renderQueue;
+
+	// per-frame data written straight into GPU memory: the lamp transforms for now
+	StreamBuffer frameData;
+	frameData.create(GL_ARRAY_BUFFER, LightBuffer::MAX_POINT_LIGHTS * sizeof(glm::mat4), (GLADloadproc)glfwGetProcAddress);
+
+	// the stairwell: every world matrix and bounding box is computed once here.
+	// The stairwell itself never moves, so its objects are static and are also
+	// baked into instance batches, one per texture, that are uploaded once. It is
+	// built twice: once with a cube per position, once with the voxel meshes in
+	// their place. A few props float around the stairs as dynamic objects.
+	// -----------------------------------------------------------------------------
+	Scene scene;
+	Scene voxelScene;
+	for (Scene* target : { &scene, &voxelScene }) {
+		bool cubes = target == &scene;
+		// each group of the file is one GPU occlusion query group, and each voxel
+		// mesh one more after those
+		if (!cubes) {
+			for (size_t i = 0; i < voxelMeshes.size(); i++) {
+				unsigned int added = target->addStatic(voxelMeshes[i], voxelBounds[i], materialTextures[voxelMaterials[i]], glm::mat4(1.0f));
+				target->setQueryGroup(added, layout.groupCount() + (unsigned int)i);
+			}
+		}
+		for (uint32_t i = 0; i < layout.objectCount(); i++) {
+			if (voxelCells[i] && !cubes)
+				continue;
+			const SceneFileObject& object = layout.objects()[i];
+			unsigned int added = target->addStatic(layoutMeshes[object.mesh], layoutBounds[object.mesh], materialTextures[object.material],
+				layout.worlds()[i], layout.bounds()[i]);
+			if (layoutLods[object.mesh])
+				target->setLod(added, layoutLods[object.mesh]);
+			target->setQueryGroup(added, object.group);
+		}
+		// occluders come from the file either way; with voxel meshes they still
+		// describe the solid cubes the meshes were built from
+		for (uint32_t i = 0; i < layout.objectCount(); i++) {
+			const SceneFileObject& object = layout.objects()[i];
+			if (object.flags & SCENE_OBJECT_OCCLUDER)
+				target->addOccluder(layoutBounds[object.mesh], layout.worlds()[i]);
+		}
+		// spheres circling above the stairs, moved every frame through the
+		// scene's loose octree
+		const int PROP_COUNT = 6;
+		for (int i = 0; i < PROP_COUNT; i++) {
+			unsigned int added = target->addDynamic(sphereLod.levels[0], sphereLod.bounds, materialTextures[0], [i](float time) {
+				float angle = time * 0.5f + i * 6.2831853f / PROP_COUNT;
+				glm::vec3 position(-2.5f + 4.0f * cos(angle), 6.5f + 0.5f * sin(time * 1.3f + i), 1.0f + 4.0f * sin(angle));
+				return glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.3f));
+			});
+			target->setLod(added, &sphereLod);
+		}
+		target->bake();
+	}
+	layout.close();
 
 	// render loop
 	// -----------
@@ -575,6 +416,35 @@ int main()
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
+		// report last frame's draw calls once a second, then start counting this frame
+		if (currentFrame - lastStatsReport >= 1.0f)
+		{
+			const VisibilityCache& cache = (useVoxelMeshes ? voxelScene : scene).visibilityCache();
+			std::cout << (useInstancing ? "instanced" : "per-object") << (useVoxelMeshes ? ", voxel meshes" : ", cubes")
+				<< " draw calls: " << renderStats().drawCalls
+				<< ", instances: " << renderStats().instances << ", triangles: " << renderStats().triangles
+				<< " | uniform lookups: " << renderStats().uniformLookups << ", uploads: " << renderStats().uniformUploads
+				<< ", skipped: " << renderStats().uniformUploadsSkipped
+				<< " | light uploads: " << renderStats().lightUploads << " (" << renderStats().lightBytesUploaded << " bytes)"
+				<< " | state changes: " << renderStats().stateChanges << ", removed by sorting: " << renderStats().stateChangesRemoved
+				<< " | transforms updated: " << renderStats().transformsUpdated << " (" << renderStats().octreeRelinks
+				<< " changed octree cell), LOD changes: " << renderStats().lodChanges
+				<< " | visible: " << renderStats().objectsVisible << ", culled: " << renderStats().objectsCulled
+				<< " (" << (useHierarchicalCulling ? "BVH" : FrustumCuller::pathName(FrustumCuller::bestPath())) << ")"
+				<< ", visibility cache hits: " << cache.hitCount() << "/" << cache.lookupCount()
+				<< " (" << (cache.lookupCount() > 0 ? 100.0 * cache.hitCount() / cache.lookupCount() : 0.0) << "%)"
+				<< ", occluded: " << renderStats().objectsOccluded << " (" << renderStats().occluderTriangles << " occluder triangles, setup "
+				<< renderStats().occluderSetupMs << " ms, raster " << renderStats().occluderRasterMs << " ms, test "
+				<< renderStats().occlusionTestMs << " ms)"
+				<< " | GPU queries: " << renderStats().queriesIssued << ", latency: "
+				<< (renderStats().queryResults > 0 ? (float)renderStats().queryLatencyFrames / renderStats().queryResults : 0.0f)
+				<< " frames, groups skipped on condition: " << renderStats().groupsConditional
+				<< " (~" << renderStats().fragmentsAvoided << " fragments avoided)"
+				<< " | streamed: " << renderStats().streamBytes << " bytes, stalls: " << frameData.stallCount() << std::endl;
+			lastStatsReport = currentFrame;
+		}
+		renderStats().reset();
+
 		// input
 		// -----
 		processInput(window);
@@ -584,66 +454,11 @@ int main()
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// be sure to activate shader when setting uniforms/drawing objects
-		lightingShader.use();
-		lightingShader.setVec3("viewPos", camera.Position);
-		lightingShader.setFloat("material.shininess", 32.0f);
-
-		/*
-		   Here we set all the uniforms for the 5/6 types of lights we have. We have to set them manually and index
-		   the proper PointLight struct in the array to set each uniform variable. This can be done more code-friendly
-		   by defining light types as classes and set their values in there, or by using a more efficient uniform approach
-		   by using 'Uniform buffer objects', but that is something we'll discuss in the 'Advanced GLSL' tutorial.
-		*/
-		// directional light
-		lightingShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-		lightingShader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-		lightingShader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-
-		// point light 1
-		lightingShader.setVec3("pointLights[0].position", pointLightPositions[0]);
-		lightingShader.setVec3("pointLights[0].ambient", 0.1f, 0.05f, 0.05f);
-		lightingShader.setVec3("pointLights[0].diffuse", 1.0f, 1.0f, 1.0f);
-
-		lightingShader.setFloat("pointLights[0].constant", 1.0f);
-		lightingShader.setFloat("pointLights[0].linear", 0.09);
-		lightingShader.setFloat("pointLights[0].quadratic", 0.032);
-		// point light 2
-		lightingShader.setVec3("pointLights[1].position", pointLightPositions[1]);
-		lightingShader.setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-		lightingShader.setVec3("pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
-
-		lightingShader.setFloat("pointLights[1].constant", 1.0f);
-		lightingShader.setFloat("pointLights[1].linear", 0.09);
-		lightingShader.setFloat("pointLights[1].quadratic", 0.032);
-		// point light 3
-		lightingShader.setVec3("pointLights[2].position", pointLightPositions[2]);
-		lightingShader.setVec3("pointLights[2].ambient", 0.1f, 0.05f, 0.1f);
-		lightingShader.setVec3("pointLights[2].diffuse", 0.8f, 0.8f, 0.8f);
-
-		lightingShader.setFloat("pointLights[2].constant", 1.0f);
-		lightingShader.setFloat("pointLights[2].linear", 0.09);
-		lightingShader.setFloat("pointLights[2].quadratic", 0.032);
-		// point light 4
-		lightingShader.setVec3("pointLights[3].position", pointLightPositions[3]);
-		lightingShader.setVec3("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-		lightingShader.setVec3("pointLights[3].diffuse", 0.8f, 0.8f, 0.8f);
-		lightingShader.setVec3("pointLights[3].objectColor", 0.8f, 0.8f, 0.8f);
-
-		lightingShader.setFloat("pointLights[3].constant", 1.0f);
-		lightingShader.setFloat("pointLights[3].linear", 0.09);
-		lightingShader.setFloat("pointLights[3].quadratic", 0.032);
-		// spotLight
-		lightingShader.setVec3("spotLight.position", camera.Position);
-		lightingShader.setVec3("spotLight.direction", camera.Front);
-		lightingShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-		lightingShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-
-		lightingShader.setFloat("spotLight.constant", 1.0f);
-		lightingShader.setFloat("spotLight.linear", 0.09);
-		lightingShader.setFloat("spotLight.quadratic", 0.032);
-		lightingShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-		lightingShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
+		// only the spotlight follows the camera; the light buffer uploads it only when it moved
+		spotLight.position = camera.Position;
+		spotLight.direction = camera.Front;
+		lights.setSpotLight(spotLight);
+		lights.flush();
 
 		//Perspective vs Orthogonal view
 		if (useOrthogonal) {
@@ -655,342 +470,83 @@ int main()
 		}
 		
 		glm::mat4 view = camera.GetViewMatrix();
-		lightingShader.setMat4("projection", projection);
-		lightingShader.setMat4("view", view);
-
-		// world transformation
-		glm::mat4 model = glm::mat4(0.5f);
-		lightingShader.setMat4("model", model);
-
-		// render containers
-		glBindVertexArray(cubeVAO);
-		lightingShader.setInt("textureCarpet1", 1); 
-		glBindTexture(GL_TEXTURE_2D, textureCarpet1); 
-
-
-		//Stairs Loop
-		for (unsigned int i = 0; i < numCubes; i++)
-		{
-			
-			glm::mat4 model = glm::mat4(1.0f);
-			lightingShader.use();
-			
-
-			model = glm::translate(model, cubePositions[i]);
-			lightingShader.setMat4("model", model);
 
-			glDrawArrays(GL_TRIANGLES, 0, 36);
-			
+		// both lighting programs can be used in one frame (dynamic objects are never
+		// batched); values that did not change are skipped by the uniform table
+		for (Shader* shader : { &lightingShader, &instancedShader }) {
+			shader->use();
+			shader->set(VIEW_POS_UNIFORM, camera.Position);
+			shader->set(SHININESS_UNIFORM, 32.0f);
+			shader->set(PROJECTION_UNIFORM, projection);
+			shader->set(VIEW_UNIFORM, view);
 		}
-		glBindVertexArray(0);
-		glBindVertexArray(cubeVAO);
-		//Banister Loop
-		for (unsigned int i = 0; i < numSmallCubes; i++)
+
+		// only dynamic objects are re-evaluated; the static stairwell costs nothing here
+		Scene& stairwell = useVoxelMeshes ? voxelScene : scene;
+		stairwell.update(currentFrame);
+		// spheres and cylinders drop to coarser tessellations as they shrink on screen
+		stairwell.selectLods(camera.Position, projection);
+
+		// only objects whose bounds touch the view frustum and are not hidden behind
+		// an occluder are queued below
+		stairwell.setHierarchicalCulling(useHierarchicalCulling);
+		stairwell.setOcclusionCulling(useOcclusionCulling);
+		stairwell.setVisibilityCaching(useVisibilityCache);
+		stairwell.cull(projection, view);
+		// last frame's query results decide which groups are drawn on a condition
+		stairwell.setOcclusionQueries(useOcclusionQueries);
+		stairwell.pollOcclusionQueries(camera.Position);
+
+		if (pickRequested)
 		{
-			lightingShader.use();
-
-			// Bind our uniform sampler to use texture unit
-			lightingShader.setInt("textureWood2", 2); 
-			glBindTexture(GL_TEXTURE_2D, textureWood2);
-			if (i < 3 || i > 5) {
-				glBindVertexArray(cubeVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.3, 0.3, 0.3));
-				model = glm::translate(model, bannCubePositions[i]);
-
-				lightingShader.setMat4("model", model);
-				glDrawArrays(GL_TRIANGLES, 0, 36);
-			}
-			else {
-				glBindVertexArray(cylVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.3f, 0.3f, 0.3f));
-				model = glm::translate(model, bannCubePositions[i]);
-				lightingShader.setMat4("model", model);
-				glDrawElements(GL_TRIANGLES, cylNumIndices, GL_UNSIGNED_SHORT, (void*)cylIndexByteOffset);
-			}
+			uint32_t object;
+			float distance;
+			if (stairwell.hierarchy().raycast(camera.Position, camera.Front, 100.0f, object, distance))
+				std::cout << "picked object " << object << " at " << distance << std::endl;
+			else
+				std::cout << "picked nothing" << std::endl;
+			pickRequested = false;
 		}
-		//Railing Loop
-		for (unsigned int i = 0; i < numRailCubes; i++) {
-			glBindVertexArray(cubeVAO);
-			model = glm::mat4(1.0f);
-			model = glm::rotate(model, glm::radians(45.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-			model = glm::scale(model, glm::vec3(0.2, 0.2, 0.2));
-
-			model = glm::translate(model, railCubePositions[i]);
 
-
-			lightingShader.setMat4("model", model);
-			glDrawArrays(GL_TRIANGLES, 0, 36);
-		}
-		glBindVertexArray(sphereVAO);
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(0.3f, 2.35f, 2.4f));
-		model = glm::scale(model, glm::vec3(0.1f)); // Make it a smaller sphere
-
-		lightingShader.setMat4("model", model);
-
-		// draw sphere
-		glDrawElements(GL_TRIANGLES, sphereNumIndices, GL_UNSIGNED_SHORT, (void*)sphereIndexByteOffset);
-		//Vertical Rail Loop
-		lightingShader.use();
-
-		// Bind our uniform sampler to use texture unit
-		lightingShader.setInt("textureWood0", 0);
-		glBindTexture(GL_TEXTURE_2D, textureWood0);
-		for (unsigned int i = 0; i < numVertRails; i++) {
-			if (i < 2) {
-				glBindVertexArray(cubeVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1, 0.1, 0.1));
-				model = glm::translate(model, vertRailPositions[i]);
-				lightingShader.setMat4("model", model);
-				glDrawArrays(GL_TRIANGLES, 0, 36);
-				
-			}
-			if (i == 2) {
-				glBindVertexArray(sphereVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1f));
-				model = glm::translate(model, vertRailPositions[i]);
-				model = glm::scale(model, glm::vec3(0.5f));
-				lightingShader.setMat4("model", model);
-				glDrawElements(GL_TRIANGLES, sphereNumIndices, GL_UNSIGNED_SHORT, (void*)sphereIndexByteOffset);
-			}
-			if (i > 2 && i < 17) {
-				glBindVertexArray(cylVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));
-				model = glm::translate(model, vertRailPositions[i]);
-				lightingShader.setMat4("model", model);
-				glDrawElements(GL_TRIANGLES, cylNumIndices, GL_UNSIGNED_SHORT, (void*)cylIndexByteOffset);
-			}
-			if (i > 17 && i < 26) {
-				glBindVertexArray(cubeVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1, 0.1, 0.1));
-				model = glm::translate(model, vertRailPositions[i]);
-				lightingShader.setMat4("model", model);
-				glDrawArrays(GL_TRIANGLES, 0, 36);
-			}
-			if (i == 26) {
-				glBindVertexArray(sphereVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1f));
-				model = glm::translate(model, vertRailPositions[i]);
-				model = glm::scale(model, glm::vec3(0.5f));
-				lightingShader.setMat4("model", model);
-				glDrawElements(GL_TRIANGLES, sphereNumIndices, GL_UNSIGNED_SHORT, (void*)sphereIndexByteOffset);
-			}
-			if (i > 26 && i < 36) {
-				glBindVertexArray(cylVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));
-				model = glm::translate(model, vertRailPositions[i]);
-				lightingShader.setMat4("model", model);
-				glDrawElements(GL_TRIANGLES, cylNumIndices, GL_UNSIGNED_SHORT, (void*)cylIndexByteOffset);
-			}
-			if (i > 36 && i < 40) {
-				glBindVertexArray(cubeVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1, 0.1, 0.1));
-				model = glm::translate(model, vertRailPositions[i]);
-				lightingShader.setMat4("model", model);
-				glDrawArrays(GL_TRIANGLES, 0, 36);
-			}
-			if (i == 40) {
-				glBindVertexArray(sphereVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1f));
-				model = glm::translate(model, vertRailPositions[i]);
-				model = glm::scale(model, glm::vec3(0.5f));
-				lightingShader.setMat4("model", model);
-				glDrawElements(GL_TRIANGLES, sphereNumIndices, GL_UNSIGNED_SHORT, (void*)sphereIndexByteOffset);
-			}
-			if (i > 40 && i < 54) {
-				glBindVertexArray(cylVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));
-				model = glm::translate(model, vertRailPositions[i]);
-				lightingShader.setMat4("model", model);
-				glDrawElements(GL_TRIANGLES, cylNumIndices, GL_UNSIGNED_SHORT, (void*)cylIndexByteOffset);
-			}
-			if (i > 54 && i < 64) {
-				glBindVertexArray(cubeVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1, 0.1, 0.1));
-				model = glm::translate(model, vertRailPositions[i]);
-				lightingShader.setMat4("model", model);
-				glDrawArrays(GL_TRIANGLES, 0, 36);
-			}
-			if (i == 64) {
-				glBindVertexArray(sphereVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1f));
-				model = glm::translate(model, vertRailPositions[i]);
-				model = glm::scale(model, glm::vec3(0.5f));
-				lightingShader.setMat4("model", model);
-				glDrawElements(GL_TRIANGLES, sphereNumIndices, GL_UNSIGNED_SHORT, (void*)sphereIndexByteOffset);
-			}
-			if (i > 64 && i < 75) {
-				glBindVertexArray(cylVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));
-				model = glm::translate(model, vertRailPositions[i]);
-				lightingShader.setMat4("model", model);
-				glDrawElements(GL_TRIANGLES, cylNumIndices, GL_UNSIGNED_SHORT, (void*)cylIndexByteOffset);
-			}
-			if (i > 75 && i < 78) {
-				glBindVertexArray(cubeVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1, 0.1, 0.1));
-				model = glm::translate(model, vertRailPositions[i]);
-				lightingShader.setMat4("model", model);
-				glDrawArrays(GL_TRIANGLES, 0, 36);
-			}
-			if (i == 78) {
-				glBindVertexArray(sphereVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1f));
-				model = glm::translate(model, vertRailPositions[i]);
-				model = glm::scale(model, glm::vec3(0.5f));
-				lightingShader.setMat4("model", model);
-				glDrawElements(GL_TRIANGLES, sphereNumIndices, GL_UNSIGNED_SHORT, (void*)sphereIndexByteOffset);
-			}
-			if (i > 78 && i < 93) {
-				glBindVertexArray(cylVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));
-				model = glm::translate(model, vertRailPositions[i]);
-				lightingShader.setMat4("model", model);
-				glDrawElements(GL_TRIANGLES, cylNumIndices, GL_UNSIGNED_SHORT, (void*)cylIndexByteOffset);
-			}
-			if (i > 96 && i < 102) {
-				glBindVertexArray(cubeVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1, 0.1, 0.1));
-				model = glm::translate(model, vertRailPositions[i]);
-				lightingShader.setMat4("model", model);
-				glDrawArrays(GL_TRIANGLES, 0, 36);
-			}
-			if (i == 102) {
-				glBindVertexArray(sphereVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1f));
-				model = glm::translate(model, vertRailPositions[i]);
-				model = glm::scale(model, glm::vec3(0.5f));
-				lightingShader.setMat4("model", model);
-				glDrawElements(GL_TRIANGLES, sphereNumIndices, GL_UNSIGNED_SHORT, (void*)sphereIndexByteOffset);
-			}
-			if (i > 102 && i < 111) {
-				glBindVertexArray(cylVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));
-				model = glm::translate(model, vertRailPositions[i]);
-				lightingShader.setMat4("model", model);
-				glDrawElements(GL_TRIANGLES, cylNumIndices, GL_UNSIGNED_SHORT, (void*)cylIndexByteOffset);
-			}
-			if (i > 111 && i < 116) {
-				glBindVertexArray(cubeVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1, 0.1, 0.1));
-				model = glm::translate(model, vertRailPositions[i]);
-				lightingShader.setMat4("model", model);
-				glDrawArrays(GL_TRIANGLES, 0, 36);
-			}
-			if (i == 116) {
-				glBindVertexArray(sphereVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1f));
-				model = glm::translate(model, vertRailPositions[i]);
-				model = glm::scale(model, glm::vec3(0.5f));
-				lightingShader.setMat4("model", model);
-				glDrawElements(GL_TRIANGLES, sphereNumIndices, GL_UNSIGNED_SHORT, (void*)sphereIndexByteOffset);
-			}
-			if (i > 116 && i < 130) {
-				glBindVertexArray(cylVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));
-				model = glm::translate(model, vertRailPositions[i]);
-				lightingShader.setMat4("model", model);
-				glDrawElements(GL_TRIANGLES, cylNumIndices, GL_UNSIGNED_SHORT, (void*)cylIndexByteOffset);
-			}
-			if (i > 130 && i < 140) {
-				glBindVertexArray(cubeVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1, 0.1, 0.1));
-				model = glm::translate(model, vertRailPositions[i]);
-				lightingShader.setMat4("model", model);
-				glDrawArrays(GL_TRIANGLES, 0, 36);
-			}
-			if (i == 140) {
-				glBindVertexArray(sphereVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1f));
-				model = glm::translate(model, vertRailPositions[i]);
-				model = glm::scale(model, glm::vec3(0.5f));
-				lightingShader.setMat4("model", model);
-				glDrawElements(GL_TRIANGLES, sphereNumIndices, GL_UNSIGNED_SHORT, (void*)sphereIndexByteOffset);
-			}
-			if (i > 140 && i < 151) {
-				glBindVertexArray(cylVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));
-				model = glm::translate(model, vertRailPositions[i]);
-				lightingShader.setMat4("model", model);
-				glDrawElements(GL_TRIANGLES, cylNumIndices, GL_UNSIGNED_SHORT, (void*)cylIndexByteOffset);
-			}
-			if (i > 151 && i < 154) {
-				glBindVertexArray(cubeVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1, 0.1, 0.1));
-				model = glm::translate(model, vertRailPositions[i]);
-				lightingShader.setMat4("model", model);
-				glDrawArrays(GL_TRIANGLES, 0, 36);
-			}
-			if (i == 154) {
-				glBindVertexArray(sphereVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1f));
-				model = glm::translate(model, vertRailPositions[i]);
-				model = glm::scale(model, glm::vec3(0.5f));
-				lightingShader.setMat4("model", model);
-				glDrawElements(GL_TRIANGLES, sphereNumIndices, GL_UNSIGNED_SHORT, (void*)sphereIndexByteOffset);
-			}
-			if (i > 154 && i < 170) {
-				glBindVertexArray(cylVAO);
-				model = glm::mat4(1.0f);
-				model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));
-				model = glm::translate(model, vertRailPositions[i]);
-				lightingShader.setMat4("model", model);
-				glDrawElements(GL_TRIANGLES, cylNumIndices, GL_UNSIGNED_SHORT, (void*)cylIndexByteOffset);
+		// everything goes through the render queue, which sorts by program, VAO and
+		// texture and then front-to-back, and issues each bind only when it changes
+		renderQueue.begin(camera.Position, 100.0f);
+		if (useInstancing)
+			stairwell.submitBatches(renderQueue, instancedShader, lightingShader); // one multi-draw per texture
+		else
+			stairwell.submitObjects(renderQueue, lightingShader);
+		renderQueue.flush();
+
+		// with the stairwell in the depth buffer, query the groups' boxes for next frame
+		occlusionBoxShader.use();
+		occlusionBoxShader.set(PROJECTION_UNIFORM, projection);
+		occlusionBoxShader.set(VIEW_UNIFORM, view);
+		stairwell.issueOcclusionQueries(occlusionBoxShader, cubeMesh, cubeBounds);
+
+		// lamps, colored by their own entry in the light buffer; the transforms are
+		// written into this frame's region of the stream buffer and drawn in one call
+		frameData.beginFrame();
+		GLintptr lampOffset = 0;
+		glm::mat4* lampModels = frameData.allocate<glm::mat4>(lights.pointLightCount(), lampOffset);
+		if (lampModels != nullptr) {
+			for (int i = 0; i < lights.pointLightCount(); i++) {
+				glm::mat4 model = glm::mat4(1.0f);
+				model = glm::translate(model, lights.pointLight(i).position);
+				lampModels[i] = glm::scale(model, glm::vec3(0.2f)) * cubeMesh.positionTransform(); // a smaller cube
 			}
+			frameData.flush();
+			lightCubeShader.use();
+			lightCubeShader.set(PROJECTION_UNIFORM, projection);
+			lightCubeShader.set(VIEW_UNIFORM, view);
+			glBindVertexArray(geometry.vao());
+			InstanceBatch::bindModelAttribute(frameData.buffer(), lampOffset);
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, cubeMesh.count, cubeMesh.indexType, cubeMesh.indices,
+				lights.pointLightCount(), cubeMesh.baseVertex);
+			renderStats().drawCalls++;
+			renderStats().instances += lights.pointLightCount();
+			renderStats().triangles += cubeMesh.count / 3 * lights.pointLightCount();
 		}
-
-		
-		//Floor
-		glBindVertexArray(planeVAO);
-		// Bind our uniform sampler to use texture unit
-		lightingShader.use();
-		lightingShader.setInt("textureWall3", 3);
-		glBindTexture(GL_TEXTURE_2D, textureWall3);
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-3.5f, -0.5001f, 4.5f));
-		lightingShader.setMat4("model", model);
-
-		// draw
-		glDrawElements(GL_TRIANGLES, planeNumIndices, GL_UNSIGNED_SHORT, (void*)planeIndexByteOffset);
-		
-		//Wall
-		glBindVertexArray(planeVAO);
-		
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(-3.5f, 3.5f, -0.5001f));
-		model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-		lightingShader.setMat4("model", model);
-
-		// draw
-		glDrawElements(GL_TRIANGLES, planeNumIndices, GL_UNSIGNED_SHORT, (void*)planeIndexByteOffset);
+		frameData.endFrame();
 
 		glfwSwapBuffers(window);
 		glfwPollEvents();
@@ -998,11 +554,11 @@ int main()
 
 	// optional: de-allocate all resources once they've outlived their purpose:
 	// ------------------------------------------------------------------------
-	glDeleteVertexArrays(1, &cubeVAO);
-	glDeleteVertexArrays(1, &lightCubeVAO);
-	glDeleteBuffers(1, &VBO);
-	glDeleteBuffers(1, &cylVBO);
-	glDeleteBuffers(1, &planeVBO);
+	geometry.cleanup();
+	frameData.cleanup();
+	scene.cleanup();
+	voxelScene.cleanup();
+	lights.cleanup();
 
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
@@ -1035,6 +591,47 @@ void processInput(GLFWwindow *window)
 	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS) {
 		useOrthogonal = !useOrthogonal; // Toggle between projections
 	}
+
+	// toggle instanced drawing once per key press
+	bool instancingKey = glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS;
+	if (instancingKey && !instancingKeyDown)
+		useInstancing = !useInstancing;
+	instancingKeyDown = instancingKey;
+
+	// toggle the voxel meshes once per key press
+	bool voxelKey = glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS;
+	if (voxelKey && !voxelKeyDown)
+		useVoxelMeshes = !useVoxelMeshes;
+	voxelKeyDown = voxelKey;
+
+	// toggle BVH culling once per key press
+	bool cullingKey = glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS;
+	if (cullingKey && !cullingKeyDown)
+		useHierarchicalCulling = !useHierarchicalCulling;
+	cullingKeyDown = cullingKey;
+
+	bool pickKey = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+	if (pickKey && !pickKeyDown)
+		pickRequested = true;
+	pickKeyDown = pickKey;
+
+	// toggle occlusion culling once per key press
+	bool occlusionKey = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+	if (occlusionKey && !occlusionKeyDown)
+		useOcclusionCulling = !useOcclusionCulling;
+	occlusionKeyDown = occlusionKey;
+
+	// toggle the GPU occlusion queries once per key press
+	bool queriesKey = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+	if (queriesKey && !queriesKeyDown)
+		useOcclusionQueries = !useOcclusionQueries;
+	queriesKeyDown = queriesKey;
+
+	// toggle the visibility cache once per key press
+	bool cacheKey = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+	if (cacheKey && !cacheKeyDown)
+		useVisibilityCache = !useVisibilityCache;
+	cacheKeyDown = cacheKey;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -0,0 +1,170 @@
+#include "StreamBuffer.h"
+#include "RenderStats.h"
+#include <cstring>
+#include <iostream>
+
+// ARB_buffer_storage is newer than the GL 4.3 glad was generated for
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+namespace
+{
+	typedef void (APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+	bool hasBufferStorage()
+	{
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		if (major > 4 || (major == 4 && minor >= 4))
+			return true;
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++)
+		{
+			const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (name != nullptr && strcmp(name, "GL_ARB_buffer_storage") == 0)
+				return true;
+		}
+		return false;
+	}
+}
+
+StreamBuffer::StreamBuffer() :
+	target(GL_ARRAY_BUFFER), id(0), frameSize(0), persistentMapping(false), base(nullptr),
+	mappedOffset(0), frame(0), head(0), fences(), stalls(0)
+{
+}
+
+void StreamBuffer::create(GLenum target, GLsizeiptr bytesPerFrame, GLADloadproc load)
+{
+	this->target = target;
+	frameSize = bytesPerFrame;
+	glGenBuffers(1, &id);
+	glBindBuffer(target, id);
+
+	BufferStorageProc bufferStorage = hasBufferStorage() ? (BufferStorageProc)load("glBufferStorage") : nullptr;
+	if (bufferStorage != nullptr)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		bufferStorage(target, frameSize * FRAMES_IN_FLIGHT, nullptr, flags);
+		base = (char*)glMapBufferRange(target, 0, frameSize * FRAMES_IN_FLIGHT, flags);
+		persistentMapping = base != nullptr;
+		if (!persistentMapping)
+		{
+			// immutable storage cannot be re-specified, start over with a plain buffer
+			std::cout << "ERROR::STREAMBUFFER::PERSISTENT_MAP_FAILED" << std::endl;
+			glDeleteBuffers(1, &id);
+			glGenBuffers(1, &id);
+			glBindBuffer(target, id);
+		}
+	}
+	if (!persistentMapping)
+		glBufferData(target, frameSize, nullptr, GL_STREAM_DRAW);
+}
+
+void StreamBuffer::beginFrame()
+{
+	head = 0;
+	if (!persistentMapping)
+	{
+		// orphan: the driver hands out fresh storage while the GPU finishes with the old
+		glBindBuffer(target, id);
+		glBufferData(target, frameSize, nullptr, GL_STREAM_DRAW);
+		return;
+	}
+
+	GLsync& fence = fences[frame];
+	if (fence == nullptr)
+		return;
+	if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+	{
+		// the GPU is still reading this region
+		stalls++;
+		while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+			;
+	}
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+void* StreamBuffer::allocateBytes(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset)
+{
+	GLsizeiptr start = (head + alignment - 1) / alignment * alignment;
+	if (start + size > frameSize)
+	{
+		std::cout << "ERROR::STREAMBUFFER::FRAME_FULL" << std::endl;
+		return nullptr;
+	}
+	head = start + size;
+	renderStats().streamBytes += (unsigned int)size;
+
+	if (persistentMapping)
+	{
+		offset = frame * frameSize + start;
+		return base + offset;
+	}
+	if (base == nullptr)
+	{
+		mappedOffset = start;
+		mapFallback();
+		if (base == nullptr)
+			return nullptr;
+	}
+	offset = start;
+	return base + (start - mappedOffset);
+}
+
+// maps the rest of the frame; the buffer was orphaned, so nothing pending can be overwritten
+void StreamBuffer::mapFallback()
+{
+	glBindBuffer(target, id);
+	base = (char*)glMapBufferRange(target, mappedOffset, frameSize - mappedOffset,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (base == nullptr)
+		std::cout << "ERROR::STREAMBUFFER::MAP_FAILED" << std::endl;
+}
+
+void StreamBuffer::flush()
+{
+	if (persistentMapping || base == nullptr)
+		return;
+	glBindBuffer(target, id);
+	glUnmapBuffer(target);
+	base = nullptr;
+}
+
+void StreamBuffer::endFrame()
+{
+	if (!persistentMapping)
+	{
+		flush();
+		return;
+	}
+	fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	frame = (frame + 1) % FRAMES_IN_FLIGHT;
+}
+
+void StreamBuffer::cleanup()
+{
+	for (GLsync& fence : fences)
+	{
+		if (fence != nullptr)
+			glDeleteSync(fence);
+		fence = nullptr;
+	}
+	if (id != 0)
+	{
+		glBindBuffer(target, id);
+		if (base != nullptr)
+			glUnmapBuffer(target);
+		glDeleteBuffers(1, &id);
+	}
+	id = 0;
+	base = nullptr;
+	persistentMapping = false;
+}
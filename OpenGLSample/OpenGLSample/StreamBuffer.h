@@ -0,0 +1,60 @@
+#pragma once
+#include <glad/glad.h>
+
+// A ring buffer for data that is rewritten every frame. The buffer is split into
+// FRAMES_IN_FLIGHT regions; each frame writes into its own region while the GPU
+// may still be reading the previous ones, and a fence per region keeps the CPU
+// from overwriting data that has not been consumed yet.
+//
+// With ARB_buffer_storage (GL 4.4) the buffer is mapped once, persistently and
+// coherently, and allocate() hands out pointers straight into GPU-visible memory.
+// Without it the buffer is orphaned every frame and mapped with glMapBufferRange,
+// in which case flush() has to be called before drawing from what was written.
+class StreamBuffer
+{
+public:
+	static const int FRAMES_IN_FLIGHT = 3;
+
+	StreamBuffer();
+
+	// bytesPerFrame is the most one frame may allocate; load is used for the
+	// glBufferStorage entry point, which the generated glad does not include
+	void create(GLenum target, GLsizeiptr bytesPerFrame, GLADloadproc load);
+
+	// waits for the GPU to release this frame's region; call once before allocate()
+	void beginFrame();
+	// count objects of type T, written in place. offset receives the byte offset in
+	// buffer() for attribute pointers or glBindBufferRange. Null when the frame is full.
+	template<typename T>
+	T* allocate(GLsizeiptr count, GLintptr& offset)
+	{
+		return static_cast<T*>(allocateBytes(count * sizeof(T), alignof(T), offset));
+	}
+	void* allocateBytes(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset);
+	// makes everything allocated so far visible to GL; a no-op on the persistent path
+	void flush();
+	// fences this frame's region; call after the last draw that reads from it
+	void endFrame();
+
+	GLuint buffer() const { return id; }
+	bool persistent() const { return persistentMapping; }
+	// frames that found their region still in use by the GPU, since create();
+	// a steady climb means FRAMES_IN_FLIGHT is too small for the driver's latency
+	unsigned int stallCount() const { return stalls; }
+
+	void cleanup();
+
+private:
+	void mapFallback();
+
+	GLenum target;
+	GLuint id;
+	GLsizeiptr frameSize;
+	bool persistentMapping;
+	char* base;            // whole buffer when persistent, mapped range otherwise
+	GLintptr mappedOffset; // buffer offset of base on the fallback path
+	int frame;             // region being written
+	GLsizeiptr head;       // bytes used in the region
+	GLsync fences[FRAMES_IN_FLIGHT];
+	unsigned int stalls;
+};
@@ -0,0 +1,82 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int workers)
+	: nextIndex(0)
+{
+	for (unsigned int i = 0; i < workers; i++)
+		threads.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+unsigned int ThreadPool::defaultWorkers()
+{
+	unsigned int hardware = std::thread::hardware_concurrency();
+	return hardware > 1 ? hardware - 1 : 0;
+}
+
+ThreadPool& ThreadPool::shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+// indices are claimed one at a time, so uneven pieces still balance out
+void ThreadPool::runTasks()
+{
+	for (unsigned int i = nextIndex++; i < taskCount; i = nextIndex++)
+		(*task)(i);
+}
+
+void ThreadPool::parallelFor(unsigned int count, const std::function<void(unsigned int)>& function)
+{
+	if (threads.empty() || count <= 1)
+	{
+		for (unsigned int i = 0; i < count; i++)
+			function(i);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		task = &function;
+		taskCount = count;
+		nextIndex = 0;
+		busyWorkers = (unsigned int)threads.size();
+		generation++;
+	}
+	wake.notify_all();
+	runTasks();
+
+	// the task must outlive every worker still inside it
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return busyWorkers == 0; });
+	task = nullptr;
+}
+
+void ThreadPool::workerLoop()
+{
+	unsigned int seen = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return stopping || generation != seen; });
+			if (stopping)
+				return;
+			seen = generation;
+		}
+		runTasks();
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--busyWorkers == 0)
+			done.notify_one();
+	}
+}
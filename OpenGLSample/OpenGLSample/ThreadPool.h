@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads for splitting one job into independent pieces.
+// parallelFor() hands out indices to the workers and the calling thread alike and
+// returns once every piece has run, so callers never deal with threads themselves.
+// With one hardware thread there are no workers and everything runs inline.
+class ThreadPool
+{
+public:
+	// workers: threads besides the caller; by default one less than the CPU has
+	explicit ThreadPool(unsigned int workers = defaultWorkers());
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// task(i) for every i in [0, count), in no particular order or thread
+	void parallelFor(unsigned int count, const std::function<void(unsigned int)>& task);
+
+	// threads taking part in parallelFor(), the caller included
+	unsigned int threadCount() const { return (unsigned int)threads.size() + 1; }
+
+	static unsigned int defaultWorkers();
+	// one pool for the whole program, started on first use
+	static ThreadPool& shared();
+
+private:
+	void workerLoop();
+	void runTasks();
+
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	bool stopping = false;
+	unsigned int generation = 0;        // bumped for every parallelFor()
+
+	const std::function<void(unsigned int)>* task = nullptr;
+	unsigned int taskCount = 0;
+	std::atomic<unsigned int> nextIndex;
+	unsigned int busyWorkers = 0;
+};
@@ -6,4 +6,5 @@ struct Vertex
 	glm::vec3 position;
 	glm::vec3 color;
 	glm::vec3 normal;
+	glm::vec2 texCoord;
 };
\ No newline at end of file
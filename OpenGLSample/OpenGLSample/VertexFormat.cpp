@@ -0,0 +1,148 @@
+#include "VertexFormat.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+	const float UNORM16_MAX = 65535.0f;
+
+	float signNotZero(float value)
+	{
+		return value >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	GLuint packSnorm10(float value)
+	{
+		int packed = (int)std::lround(glm::clamp(value, -1.0f, 1.0f) * 511.0f);
+		return (GLuint)packed & 0x3FF;
+	}
+}
+
+PositionQuantization PositionQuantization::fromBounds(const glm::vec3& min, const glm::vec3& max)
+{
+	// one step for all three axes, the smallest power of two that still spans the
+	// largest extent once the offset has been rounded down onto the step
+	glm::vec3 size = max - min;
+	float extent = std::max(size.x, std::max(size.y, size.z));
+	if (extent <= 0.0f)
+		extent = 1.0f;
+	float step = std::ldexp(1.0f, (int)std::ceil(std::log2(extent / (UNORM16_MAX - 1.0f))));
+
+	PositionQuantization quantization;
+	quantization.scale = glm::vec3(step * UNORM16_MAX);
+	quantization.offset = glm::vec3(std::floor(min.x / step), std::floor(min.y / step), std::floor(min.z / step)) * step;
+	return quantization;
+}
+
+void PositionQuantization::encode(const glm::vec3& position, GLushort out[4]) const
+{
+	glm::vec3 unit = (position - offset) / scale;
+	for (int axis = 0; axis < 3; axis++)
+		out[axis] = (GLushort)std::lround(glm::clamp(unit[axis], 0.0f, 1.0f) * UNORM16_MAX);
+	out[3] = 0;
+}
+
+glm::vec3 PositionQuantization::decode(const GLushort in[4]) const
+{
+	return glm::vec3(in[0], in[1], in[2]) / UNORM16_MAX * scale + offset;
+}
+
+GLshort VertexFormat::packSnorm16(float value)
+{
+	return (GLshort)std::lround(glm::clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+// the GL 4.2 rule; older drivers map the range slightly differently, which the
+// shader's normalize() hides
+float VertexFormat::unpackSnorm16(GLshort value)
+{
+	return std::max(value / 32767.0f, -1.0f);
+}
+
+GLubyte VertexFormat::packUnorm8(float value)
+{
+	return (GLubyte)std::lround(glm::clamp(value, 0.0f, 1.0f) * 255.0f);
+}
+
+GLhalf VertexFormat::packHalf(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+	uint32_t mantissa = bits & 0x7FFFFF;
+
+	if (((bits >> 23) & 0xFF) == 0xFF)
+		return (GLhalf)(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));   // infinity or NaN
+	if (exponent >= 31)
+		return (GLhalf)(sign | 0x7C00);
+	if (exponent <= 0)
+	{
+		// subnormal half, or zero
+		if (exponent < -10)
+			return (GLhalf)sign;
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1)))
+			half++;
+		return (GLhalf)(sign | half);
+	}
+	// a carry out of the mantissa correctly bumps the exponent
+	uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1FFF;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		half++;
+	return (GLhalf)(sign | half);
+}
+
+float VertexFormat::unpackHalf(GLhalf value)
+{
+	uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1F;
+	uint32_t mantissa = value & 0x3FF;
+	if (exponent == 0)
+	{
+		float magnitude = std::ldexp((float)mantissa, -24);
+		return sign != 0 ? -magnitude : magnitude;
+	}
+	uint32_t bits = exponent == 31
+		? sign | 0x7F800000 | (mantissa << 13)
+		: sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	float result;
+	std::memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+glm::vec2 VertexFormat::encodeOctahedral(const glm::vec3& normal)
+{
+	float length = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+	if (length <= 0.0f)
+		return glm::vec2(0.0f);
+	glm::vec3 v = normal / length;
+	if (v.z >= 0.0f)
+		return glm::vec2(v.x, v.y);
+	return glm::vec2((1.0f - std::fabs(v.y)) * signNotZero(v.x), (1.0f - std::fabs(v.x)) * signNotZero(v.y));
+}
+
+glm::vec3 VertexFormat::decodeOctahedral(const glm::vec2& encoded)
+{
+	glm::vec3 v(encoded.x, encoded.y, 1.0f - std::fabs(encoded.x) - std::fabs(encoded.y));
+	if (v.z < 0.0f)
+	{
+		float x = v.x;
+		v.x = (1.0f - std::fabs(v.y)) * signNotZero(x);
+		v.y = (1.0f - std::fabs(x)) * signNotZero(v.y);
+	}
+	return glm::normalize(v);
+}
+
+GLuint VertexFormat::packTangent(const glm::vec3& tangent, float handedness)
+{
+	GLuint w = handedness < 0.0f ? 3u : 1u;   // two's complement -1 or +1
+	return packSnorm10(tangent.x) | (packSnorm10(tangent.y) << 10) | (packSnorm10(tangent.z) << 20) | (w << 30);
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Compressed vertex layout for GeometryBuffer, 20 bytes per vertex against 44 for
+// Vertex. All attributes are read with fixed-function conversions except the
+// normal, which the vertex shader unfolds itself (decodeNormal() in the lighting
+// shaders).
+struct CompactVertex
+{
+	GLushort position[4];   // unorm16 inside the shape's quantization box; w is padding
+	GLshort normal[2];      // snorm16 octahedral
+	GLhalf texCoord[2];
+	GLubyte color[4];       // unorm8, alpha always 255
+};
+
+// Mesh's Vertex packed into 20 bytes instead of 56, the layout of compact meshes
+// and of mesh files. shaderfiles/mesh.vs rebuilds the normal from its
+// octahedral pair and the bitangent as cross(normal, tangent.xyz) * tangent.w.
+struct CompactMeshVertex {
+	// unorm16 inside the mesh's quantization box, w unused
+	GLushort Position[4];
+	// snorm16 octahedral
+	GLshort Normal[2];
+	GLhalf TexCoords[2];
+	// 10-10-10-2: tangent and the bitangent's handedness
+	GLuint Tangent;
+};
+
+// Box a shape's positions are quantized in: a stored unorm16 value u in [0, 1]
+// decodes to u * scale + offset. The step between representable values is a
+// power of two and the offset a multiple of it, so points on a coarser
+// power-of-two grid (every voxel corner) come back exactly, and shapes sharing
+// such a border quantize it the same way.
+struct PositionQuantization
+{
+	glm::vec3 scale = glm::vec3(1.0f);
+	glm::vec3 offset = glm::vec3(0.0f);
+
+	static PositionQuantization fromBounds(const glm::vec3& min, const glm::vec3& max);
+	void encode(const glm::vec3& position, GLushort out[4]) const;
+	glm::vec3 decode(const GLushort in[4]) const;
+};
+
+// Scalar packing helpers shared by GeometryBuffer, Mesh and the benchmark
+class VertexFormat
+{
+public:
+	static GLshort packSnorm16(float value);
+	static float unpackSnorm16(GLshort value);
+	static GLubyte packUnorm8(float value);
+	// IEEE half, round to nearest even
+	static GLhalf packHalf(float value);
+	static float unpackHalf(GLhalf value);
+
+	// unit vector -> point of the square [-1, 1]^2: projected onto the octahedron
+	// |x| + |y| + |z| = 1, whose lower half is folded out over the corners
+	static glm::vec2 encodeOctahedral(const glm::vec3& normal);
+	static glm::vec3 decodeOctahedral(const glm::vec2& encoded);
+
+	// GL_INT_2_10_10_10_REV with the bitangent's handedness (+1 or -1) in w
+	static GLuint packTangent(const glm::vec3& tangent, float handedness);
+};
@@ -0,0 +1,59 @@
+#include "VisibilityCache.h"
+#include "Scene.h"
+#include <algorithm>
+#include <cmath>
+
+// a slow walk or a small turn of the mouse keeps the set for several frames
+const float VisibilityCache::POSITION_THRESHOLD = 0.1f;
+const float VisibilityCache::ANGLE_THRESHOLD = 0.02f;
+
+namespace
+{
+	// the eye of a rigid view matrix: minus its translation, rotated back
+	glm::vec3 eyeOf(const glm::mat4& view)
+	{
+		glm::vec3 t(view[3]);
+		return -glm::vec3(glm::dot(glm::vec3(view[0][0], view[0][1], view[0][2]), t),
+			glm::dot(glm::vec3(view[1][0], view[1][1], view[1][2]), t),
+			glm::dot(glm::vec3(view[2][0], view[2][1], view[2][2]), t));
+	}
+
+	// view axis: a row of the rotation
+	glm::vec3 axisOf(const glm::mat4& view, int axis)
+	{
+		return glm::vec3(view[0][axis], view[1][axis], view[2][axis]);
+	}
+}
+
+bool VisibilityCache::lookup(const glm::mat4& currentProjection, const glm::mat4& currentView)
+{
+	lookups++;
+	if (!valid || currentProjection != projection)
+		return false;
+	if (glm::length(eyeOf(currentView) - eyeOf(view)) > POSITION_THRESHOLD)
+		return false;
+	// the distance between the axis tips bounds the angle each one turned
+	for (int axis = 0; axis < 3; axis++)
+		if (glm::length(axisOf(currentView, axis) - axisOf(view, axis)) > ANGLE_THRESHOLD)
+			return false;
+	hits++;
+	return true;
+}
+
+// Seen from a camera within the thresholds, a point at distance r from its eye
+// lies within POSITION_THRESHOLD + sqrt(3) * ANGLE_THRESHOLD * r of where the
+// recorded camera sees it: the eye moves by the first, and a rotation whose
+// three axes each move by at most ANGLE_THRESHOLD moves any unit vector by at
+// most sqrt(3) times that. r is bounded by the farthest corner of objectBounds.
+Frustum VisibilityCache::refresh(const glm::mat4& currentProjection, const glm::mat4& currentView, const Aabb& objectBounds)
+{
+	projection = currentProjection;
+	view = currentView;
+	valid = true;
+
+	glm::vec3 eye = eyeOf(view);
+	glm::vec3 farthest = glm::max(glm::abs(objectBounds.min - eye), glm::abs(objectBounds.max - eye));
+	float reach = glm::length(farthest) + POSITION_THRESHOLD;
+	float margin = POSITION_THRESHOLD + std::sqrt(3.0f) * ANGLE_THRESHOLD * reach;
+	return Frustum::fromViewProjection(projection * view).expanded(margin);
+}
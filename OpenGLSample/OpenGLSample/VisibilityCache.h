@@ -0,0 +1,40 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include "FrustumCuller.h"
+
+struct Aabb;
+
+// Lets a frustum test be reused across frames while the camera barely moves.
+// A refresh records the camera and hands out its frustum pushed outwards by the
+// farthest any visible point can shift when the eye moves by up to
+// POSITION_THRESHOLD and each view axis turns by up to ANGLE_THRESHOLD. The set
+// culled against that frustum covers every camera within those thresholds, so
+// lookup() accepts it until the camera leaves them or the projection changes.
+//
+// Only objects that do not move can be cached this way; the caller tests the
+// moving ones every frame.
+class VisibilityCache
+{
+public:
+	static const float POSITION_THRESHOLD;   // world units
+	static const float ANGLE_THRESHOLD;      // radians
+
+	// true when the set of the last refresh() still holds for this camera
+	bool lookup(const glm::mat4& projection, const glm::mat4& view);
+	// records this camera and returns the frustum to cull the set against;
+	// objectBounds holds every object that can be in the set
+	Frustum refresh(const glm::mat4& projection, const glm::mat4& view, const Aabb& objectBounds);
+	void invalidate() { valid = false; }
+
+	// since the cache was created, for the stats line
+	unsigned long long hitCount() const { return hits; }
+	unsigned long long lookupCount() const { return lookups; }
+
+private:
+	bool valid = false;
+	glm::mat4 projection = glm::mat4(1.0f);
+	glm::mat4 view = glm::mat4(1.0f);
+	unsigned long long hits = 0;
+	unsigned long long lookups = 0;
+};
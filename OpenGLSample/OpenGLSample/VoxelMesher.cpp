@@ -0,0 +1,318 @@
+#include "VoxelMesher.h"
+
+#include "NormalMatrix.h"
+
+namespace
+{
+	const int N = VoxelMesher::CHUNK_SIZE;
+
+	int floorDiv(int value, int divisor)
+	{
+		return (value >= 0 ? value : value - (divisor - 1)) / divisor;
+	}
+
+	// texture coordinates laid out like the faces of ShapeGenerator::makeCube(),
+	// from a point relative to the centre of the quad's first cell; with GL_REPEAT
+	// a merged face then looks exactly like the cube faces it replaces
+	glm::vec2 faceTexCoord(int axis, const glm::vec3& p)
+	{
+		if (axis == 0)
+			return glm::vec2(p.y + 0.5f, 0.5f - p.z);
+		if (axis == 1)
+			return glm::vec2(p.x + 0.5f, 0.5f - p.z);
+		return glm::vec2(p.x + 0.5f, p.y + 0.5f);
+	}
+}
+
+unsigned int VoxelMesher::addVolume(const glm::mat4& transform)
+{
+	Volume volume;
+	volume.transform = transform;
+	volume.normal = normalMatrix(transform);
+	glm::vec3 a = glm::vec3(transform[0]);
+	glm::vec3 b = glm::vec3(transform[1]);
+	glm::vec3 c = glm::vec3(transform[2]);
+	volume.mirrored = glm::dot(a, glm::cross(b, c)) < 0.0f;
+	volumes.push_back(volume);
+	return (unsigned int)volumes.size() - 1;
+}
+
+// 21 bits per chunk coordinate, biased so negative coordinates pack too
+uint64_t VoxelMesher::chunkKey(const glm::ivec3& chunk)
+{
+	const uint64_t BIAS = 1u << 20;
+	const uint64_t MASK = (1u << 21) - 1;
+	return (((uint64_t)chunk.x + BIAS) & MASK) << 42
+		| (((uint64_t)chunk.y + BIAS) & MASK) << 21
+		| (((uint64_t)chunk.z + BIAS) & MASK);
+}
+
+glm::ivec3 VoxelMesher::chunkOf(const glm::ivec3& cell)
+{
+	return glm::ivec3(floorDiv(cell.x, N), floorDiv(cell.y, N), floorDiv(cell.z, N));
+}
+
+// index of a cell given in chunk-local coordinates
+int VoxelMesher::cellIndex(const glm::ivec3& cell)
+{
+	return (cell.z * N + cell.y) * N + cell.x;
+}
+
+void VoxelMesher::markDirty(Volume& volume, const glm::ivec3& chunk)
+{
+	auto found = volume.chunks.find(chunkKey(chunk));
+	if (found != volume.chunks.end())
+		found->second.dirty = true;
+}
+
+void VoxelMesher::setVoxel(unsigned int volumeIndex, const glm::ivec3& cell, uint8_t material)
+{
+	Volume& volume = volumes[volumeIndex];
+	glm::ivec3 chunkCoord = chunkOf(cell);
+	glm::ivec3 local = cell - chunkCoord * N;
+	uint64_t key = chunkKey(chunkCoord);
+
+	auto found = volume.chunks.find(key);
+	if (found == volume.chunks.end())
+	{
+		if (material == EMPTY)
+			return;
+		found = volume.chunks.emplace(key, Chunk()).first;
+		found->second.coord = chunkCoord;
+	}
+	Chunk& chunk = found->second;
+	uint8_t& current = chunk.cells[cellIndex(local)];
+	if (current == material)
+		return;
+
+	if (current == EMPTY)
+	{
+		chunk.solid++;
+		numCubes++;
+	}
+	else if (material == EMPTY)
+	{
+		chunk.solid--;
+		numCubes--;
+	}
+	current = material;
+	chunk.dirty = true;
+
+	// a cell on the chunk border also hides or exposes a face of the neighbour
+	for (int axis = 0; axis < 3; axis++)
+	{
+		glm::ivec3 step(0);
+		step[axis] = 1;
+		if (local[axis] == 0)
+			markDirty(volume, chunkCoord - step);
+		else if (local[axis] == N - 1)
+			markDirty(volume, chunkCoord + step);
+	}
+}
+
+uint8_t VoxelMesher::voxel(unsigned int volumeIndex, const glm::ivec3& cell) const
+{
+	const Volume& volume = volumes[volumeIndex];
+	glm::ivec3 chunkCoord = chunkOf(cell);
+	auto found = volume.chunks.find(chunkKey(chunkCoord));
+	if (found == volume.chunks.end())
+		return EMPTY;
+	return found->second.cells[cellIndex(cell - chunkCoord * N)];
+}
+
+bool VoxelMesher::update()
+{
+	numChunksMeshed = 0;
+	for (Volume& volume : volumes)
+	{
+		for (auto it = volume.chunks.begin(); it != volume.chunks.end();)
+		{
+			Chunk& chunk = it->second;
+			if (chunk.solid == 0)
+			{
+				numChunksMeshed += chunk.dirty ? 1 : 0;
+				it = volume.chunks.erase(it);
+				continue;
+			}
+			if (chunk.dirty)
+			{
+				meshChunk(volume, chunk);
+				chunk.dirty = false;
+				numChunksMeshed++;
+			}
+			++it;
+		}
+	}
+	return numChunksMeshed > 0;
+}
+
+// Greedy meshing, one pass per face direction and slice: build a mask of the
+// visible faces in the slice (a solid cell whose neighbour that way is empty),
+// then repeatedly take the first face left in the mask, grow it along u while the
+// material matches, grow that row along v while every cell of it matches, emit
+// the rectangle and clear it from the mask.
+void VoxelMesher::meshChunk(const Volume& volume, Chunk& chunk) const
+{
+	chunk.quads.clear();
+	glm::ivec3 origin = chunk.coord * N;
+	uint8_t mask[N * N];
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		int u = (axis + 1) % 3;
+		int v = (axis + 2) % 3;
+		for (int direction = 0; direction < 2; direction++)
+		{
+			bool positive = direction == 1;
+			glm::ivec3 step(0);
+			step[axis] = positive ? 1 : -1;
+			auto found = volume.chunks.find(chunkKey(chunk.coord + step));
+			const Chunk* next = found != volume.chunks.end() ? &found->second : nullptr;
+
+			for (int slice = 0; slice < N; slice++)
+			{
+				glm::ivec3 p(0);
+				p[axis] = slice;
+				for (p[v] = 0; p[v] < N; p[v]++)
+				{
+					for (p[u] = 0; p[u] < N; p[u]++)
+					{
+						uint8_t material = chunk.cells[cellIndex(p)];
+						uint8_t neighbour = EMPTY;
+						if (material != EMPTY)
+						{
+							glm::ivec3 q = p + step;
+							if (q[axis] >= 0 && q[axis] < N)
+								neighbour = chunk.cells[cellIndex(q)];
+							else if (next != nullptr)
+							{
+								q[axis] = positive ? 0 : N - 1;
+								neighbour = next->cells[cellIndex(q)];
+							}
+						}
+						mask[p[v] * N + p[u]] = neighbour == EMPTY ? material : EMPTY;
+					}
+				}
+
+				for (int b = 0; b < N; b++)
+				{
+					for (int a = 0; a < N;)
+					{
+						uint8_t material = mask[b * N + a];
+						if (material == EMPTY)
+						{
+							a++;
+							continue;
+						}
+						int width = 1;
+						while (a + width < N && mask[b * N + a + width] == material)
+							width++;
+						int height = 1;
+						for (; b + height < N; height++)
+						{
+							bool rowMatches = true;
+							for (int k = 0; k < width && rowMatches; k++)
+								rowMatches = mask[(b + height) * N + a + k] == material;
+							if (!rowMatches)
+								break;
+						}
+						for (int row = 0; row < height; row++)
+							for (int k = 0; k < width; k++)
+								mask[(b + row) * N + a + k] = EMPTY;
+
+						Quad quad;
+						quad.cell = origin;
+						quad.cell[axis] += slice;
+						quad.cell[u] += a;
+						quad.cell[v] += b;
+						quad.axis = (uint8_t)axis;
+						quad.positive = positive;
+						quad.material = material;
+						quad.width = (uint16_t)width;
+						quad.height = (uint16_t)height;
+						chunk.quads.push_back(quad);
+						a += width;
+					}
+				}
+			}
+		}
+	}
+}
+
+unsigned int VoxelMesher::triangleCount() const
+{
+	unsigned int quads = 0;
+	for (const Volume& volume : volumes)
+		for (const auto& entry : volume.chunks)
+			quads += (unsigned int)entry.second.quads.size();
+	return quads * 2;
+}
+
+ShapeData VoxelMesher::buildMesh(uint8_t material) const
+{
+	// past 16384 quads the mesh needs 32-bit indices, which the geometry buffer
+	// picks on its own
+	unsigned int numQuads = 0;
+	for (const Volume& volume : volumes)
+		for (const auto& entry : volume.chunks)
+			for (const Quad& quad : entry.second.quads)
+				numQuads += quad.material == material ? 1 : 0;
+
+	ShapeData ret;
+	ret.numVertices = numQuads * 4;
+	ret.vertices = new Vertex[ret.numVertices];
+	ret.numIndices = numQuads * 6;
+	ret.indices = new GLuint[ret.numIndices];
+
+	unsigned int written = 0;
+	for (const Volume& volume : volumes)
+	{
+		for (const auto& entry : volume.chunks)
+		{
+			for (const Quad& quad : entry.second.quads)
+			{
+				if (quad.material != material || written == numQuads)
+					continue;
+				int u = (quad.axis + 1) % 3;
+				int v = (quad.axis + 2) % 3;
+
+				// the cube at cell spans cell - 0.5 to cell + 0.5
+				glm::vec3 corner = glm::vec3(quad.cell) - glm::vec3(0.5f);
+				if (quad.positive)
+					corner[quad.axis] += 1.0f;
+				glm::vec3 du(0.0f), dv(0.0f), normal(0.0f);
+				du[u] = (float)quad.width;
+				dv[v] = (float)quad.height;
+				normal[quad.axis] = quad.positive ? 1.0f : -1.0f;
+
+				const glm::vec3 corners[4] = { corner, corner + du, corner + du + dv, corner + dv };
+				glm::vec3 worldNormal = glm::normalize(volume.normal * normal);
+				Vertex* vertex = ret.vertices + written * 4;
+				for (int k = 0; k < 4; k++)
+				{
+					vertex[k].position = glm::vec3(volume.transform * glm::vec4(corners[k], 1.0f));
+					vertex[k].color = glm::vec3(1.0f);
+					vertex[k].normal = worldNormal;
+					vertex[k].texCoord = faceTexCoord(quad.axis, corners[k] - glm::vec3(quad.cell));
+				}
+
+				// u x v points along +axis, so the corners run counter-clockwise
+				// seen from the positive side
+				GLuint base = written * 4;
+				GLuint* index = ret.indices + written * 6;
+				if (quad.positive != volume.mirrored)
+				{
+					index[0] = base; index[1] = base + 1; index[2] = base + 2;
+					index[3] = base + 2; index[4] = base + 3; index[5] = base;
+				}
+				else
+				{
+					index[0] = base; index[1] = base + 3; index[2] = base + 2;
+					index[3] = base + 2; index[4] = base + 1; index[5] = base;
+				}
+				written++;
+			}
+		}
+	}
+	return ret;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "ShapeData.h"
+
+// Turns stacks of unit cubes into merged meshes. Cubes live in volumes: integer
+// lattices placed in the world by a transform, so each position array with its
+// model matrix becomes one volume. Faces between two solid cells are dropped and
+// the remaining coplanar faces of one material are merged greedily into as few
+// quads as possible.
+//
+// Each volume is split into chunks of CHUNK_SIZE^3 cells that are meshed on their
+// own. setVoxel() only marks the chunk (and a neighbour, for a border cell) dirty,
+// so update() after adding or removing a cube re-meshes just those chunks.
+class VoxelMesher
+{
+public:
+	static const int CHUNK_SIZE = 16;
+	static const uint8_t EMPTY = 0;
+
+	// a lattice whose cell (x, y, z) is the unit cube centred at (x, y, z) before
+	// transform is applied, the same convention as the cube positions arrays
+	unsigned int addVolume(const glm::mat4& transform);
+
+	// material 1-255 fills the cell, EMPTY clears it
+	void setVoxel(unsigned int volume, const glm::ivec3& cell, uint8_t material);
+	uint8_t voxel(unsigned int volume, const glm::ivec3& cell) const;
+
+	// re-mesh every dirty chunk; returns false when nothing had changed
+	bool update();
+
+	// every quad of one material over all volumes, in world space, with texture
+	// coordinates that repeat once per cube. The caller owns the result.
+	ShapeData buildMesh(uint8_t material) const;
+
+	unsigned int cubeCount() const { return numCubes; }
+	unsigned int triangleCount() const;                 // of the merged meshes
+	unsigned int chunksMeshed() const { return numChunksMeshed; } // by the last update()
+
+private:
+	// one merged face in lattice space: a w x h rectangle in the plane facing
+	// along +/- axis, starting at cell
+	struct Quad
+	{
+		glm::ivec3 cell;    // lowest cell of the rectangle
+		uint8_t axis;
+		bool positive;
+		uint8_t material;
+		uint16_t width, height; // along (axis + 1) % 3 and (axis + 2) % 3
+	};
+
+	struct Chunk
+	{
+		glm::ivec3 coord;
+		uint8_t cells[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE] = {};
+		unsigned int solid = 0;
+		bool dirty = true;
+		std::vector<Quad> quads;
+	};
+
+	struct Volume
+	{
+		glm::mat4 transform;
+		glm::mat3 normal;
+		bool mirrored;      // negative determinant: flip the winding
+		std::unordered_map<uint64_t, Chunk> chunks;
+	};
+
+	static uint64_t chunkKey(const glm::ivec3& chunk);
+	static glm::ivec3 chunkOf(const glm::ivec3& cell);
+	static int cellIndex(const glm::ivec3& cell);
+
+	void markDirty(Volume& volume, const glm::ivec3& chunk);
+	void meshChunk(const Volume& volume, Chunk& chunk) const;
+
+	std::vector<Volume> volumes;
+	unsigned int numCubes = 0;
+	unsigned int numChunksMeshed = 0;
+};
@@ -5,7 +5,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "MeshFile.h"
 #include "shader.h"
+#include "VertexFormat.h"
 
 #include <string>
 #include <vector>
@@ -37,21 +39,67 @@ public:
 	vector<unsigned int> indices;
 	vector<Texture>      textures;
 	unsigned int VAO;
+	bool compact;
+	// what Draw() draws; indices stays empty for a mesh loaded from a file
+	GLsizei indexCount;
+	GLenum indexType;
+	// the box the compact positions are quantized in
+	PositionQuantization quantization;
 
 	// constructor
-	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool compact = false)
 	{
 		this->vertices = vertices;
 		this->indices = indices;
 		this->textures = textures;
+		this->compact = compact;
+		this->indexCount = (GLsizei)this->indices.size();
+		this->indexType = GL_UNSIGNED_INT;
 
 		// now that we have all the required data, set the vertex buffers and its attribute pointers.
 		setupMesh();
 	}
 
+	// a compiled mesh, uploaded straight from the file's mapping; the file can be
+	// closed once this returns
+	Mesh(const MeshFile& file, vector<Texture> textures)
+	{
+		this->textures = textures;
+		this->compact = true;
+		this->indexCount = (GLsizei)file.indexCount();
+		this->indexType = file.indexType();
+		this->quantization = file.quantization();
+
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &VBO);
+		glGenBuffers(1, &EBO);
+		glBindVertexArray(VAO);
+		file.upload(VBO, EBO);
+		setupCompactAttributes();
+		glBindVertexArray(0);
+	}
+
+	// maps the stored positions to model space: the quantization box when the
+	// mesh is compact, identity otherwise. Draw() sets it as the
+	// positionTransform uniform, which shaderfiles/mesh.vs applies before model.
+	glm::mat4 positionTransform() const
+	{
+		glm::mat4 transform(1.0f);
+		if (!compact)
+			return transform;
+		transform[0][0] = quantization.scale.x;
+		transform[1][1] = quantization.scale.y;
+		transform[2][2] = quantization.scale.z;
+		transform[3] = glm::vec4(quantization.offset, 1.0f);
+		return transform;
+	}
+
 	// render the mesh
 	void Draw(Shader &shader)
 	{
+		shader.setBool("octahedralNormals", compact);
+		shader.setMat4("positionTransform", positionTransform());
+
 		// bind appropriate textures
 		unsigned int diffuseNr = 1;
 		unsigned int specularNr = 1;
@@ -73,14 +121,14 @@ public:
 				number = std::to_string(heightNr++); // transfer unsigned int to stream
 
 			// now set the sampler to the correct texture unit
-			glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
+			shader.setInt(name + number, i);
 			// and finally bind the texture
 			glBindTexture(GL_TEXTURE_2D, textures[i].id);
 		}
 
 		// draw mesh
 		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+		glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
 		glBindVertexArray(0);
 
 		// always good practice to set everything back to defaults once configured.
@@ -100,6 +148,15 @@ private:
 		glGenBuffers(1, &EBO);
 
 		glBindVertexArray(VAO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+		if (compact)
+		{
+			setupCompactMesh();
+			glBindVertexArray(0);
+			return;
+		}
+
 		// load data into vertex buffers
 		glBindBuffer(GL_ARRAY_BUFFER, VBO);
 		// A great thing about structs is that their memory layout is sequential for all its items.
@@ -107,9 +164,6 @@ private:
 		// again translates to 3/2 floats which translates to a byte array.
 		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
 		// set the vertex attribute pointers
 		// vertex Positions
 		glEnableVertexAttribArray(0);
@@ -129,5 +183,51 @@ private:
 
 		glBindVertexArray(0);
 	}
+
+	// packs the vertices into CompactMeshVertex and points attributes 0-3 at them
+	void setupCompactMesh()
+	{
+		glm::vec3 min(0.0f), max(0.0f);
+		if (!vertices.empty())
+			min = max = vertices[0].Position;
+		for (const Vertex& vertex : vertices)
+		{
+			min = glm::min(min, vertex.Position);
+			max = glm::max(max, vertex.Position);
+		}
+		quantization = PositionQuantization::fromBounds(min, max);
+
+		vector<CompactMeshVertex> packed(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			const Vertex& vertex = vertices[i];
+			quantization.encode(vertex.Position, packed[i].Position);
+			glm::vec2 normal = VertexFormat::encodeOctahedral(vertex.Normal);
+			packed[i].Normal[0] = VertexFormat::packSnorm16(normal.x);
+			packed[i].Normal[1] = VertexFormat::packSnorm16(normal.y);
+			packed[i].TexCoords[0] = VertexFormat::packHalf(vertex.TexCoords.x);
+			packed[i].TexCoords[1] = VertexFormat::packHalf(vertex.TexCoords.y);
+			float handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+			packed[i].Tangent = VertexFormat::packTangent(vertex.Tangent, handedness);
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(CompactMeshVertex), packed.data(), GL_STATIC_DRAW);
+		setupCompactAttributes();
+	}
+
+	// attributes 0-3 from the CompactMeshVertex in GL_ARRAY_BUFFER; the
+	// bitangent (4) is left disabled since mesh.vs rebuilds it
+	void setupCompactAttributes()
+	{
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactMeshVertex), (void*)offsetof(CompactMeshVertex, Position));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(CompactMeshVertex), (void*)offsetof(CompactMeshVertex, Normal));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactMeshVertex), (void*)offsetof(CompactMeshVertex, TexCoords));
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(CompactMeshVertex), (void*)offsetof(CompactMeshVertex, Tangent));
+	}
 };
 #endif
\ No newline at end of file
@@ -7,6 +7,27 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+#include "RenderStats.h"
+
+// FNV-1a hash of a uniform name. It is constexpr so names written as string
+// literals are hashed by the compiler and never at draw time.
+constexpr uint32_t uniformHash(const char* name, uint32_t hash = 2166136261u)
+{
+	return *name ? uniformHash(name + 1, (hash ^ (uint8_t)*name) * 16777619u) : hash;
+}
+
+// A uniform name resolved to its hash at compile time. The type parameter is the
+// C++ type the uniform is set with, so Shader::set() only accepts matching values.
+template <typename T>
+struct Uniform
+{
+	uint32_t hash;
+	constexpr explicit Uniform(const char* name) : hash(uniformHash(name)) {}
+};
 
 class Shader
 {
@@ -88,6 +109,7 @@ public:
 			glAttachShader(ID, geometry);
 		glLinkProgram(ID);
 		checkCompileErrors(ID, "PROGRAM");
+		reflectUniforms();
 		// delete the shaders as they're linked into our program now and no longer necessery
 		glDeleteShader(vertex);
 		glDeleteShader(fragment);
@@ -102,65 +124,180 @@ public:
 		glUseProgram(ID);
 	}
 	// utility uniform functions
+	// every setter goes through the reflected uniform table and skips the upload
+	// when the value already matches what the program holds
 	// ------------------------------------------------------------------------
 	void setBool(const std::string &name, bool value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		setInt(name, (int)value);
 	}
 	// ------------------------------------------------------------------------
 	void setInt(const std::string &name, int value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		upload(find(name), value);
 	}
 	// ------------------------------------------------------------------------
 	void setFloat(const std::string &name, float value) const
 	{
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		upload(find(name), value);
 	}
 	// ------------------------------------------------------------------------
 	void setVec2(const std::string &name, const glm::vec2 &value) const
 	{
-		glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		upload(find(name), value);
 	}
 	void setVec2(const std::string &name, float x, float y) const
 	{
-		glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+		upload(find(name), glm::vec2(x, y));
 	}
 	// ------------------------------------------------------------------------
 	void setVec3(const std::string &name, const glm::vec3 &value) const
 	{
-		glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		upload(find(name), value);
 	}
 	void setVec3(const std::string &name, float x, float y, float z) const
 	{
-		glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+		upload(find(name), glm::vec3(x, y, z));
 	}
 	// ------------------------------------------------------------------------
 	void setVec4(const std::string &name, const glm::vec4 &value) const
 	{
-		glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		upload(find(name), value);
 	}
 	void setVec4(const std::string &name, float x, float y, float z, float w)
 	{
-		glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+		upload(find(name), glm::vec4(x, y, z, w));
 	}
 	// ------------------------------------------------------------------------
 	void setMat2(const std::string &name, const glm::mat2 &mat) const
 	{
-		glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		upload(find(name), mat);
 	}
 	// ------------------------------------------------------------------------
 	void setMat3(const std::string &name, const glm::mat3 &mat) const
 	{
-		glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		upload(find(name), mat);
 	}
 	// ------------------------------------------------------------------------
 	void setMat4(const std::string &name, const glm::mat4 &mat) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		upload(find(name), mat);
+	}
+	// ------------------------------------------------------------------------
+	// typed handle version, e.g. set(Uniform<glm::mat4>("model"), model)
+	template <typename T>
+	void set(Uniform<T> uniform, const T &value) const
+	{
+		upload(find(uniform.hash), value);
+	}
+
+	// true if the linked program has an active uniform with this name
+	bool hasUniform(const std::string &name) const
+	{
+		return uniforms.count(uniformHash(name.c_str())) != 0;
 	}
 
 private:
+	// one active uniform of the linked program, plus a copy of the last value sent to it
+	struct UniformSlot
+	{
+		GLint location;
+		GLenum type;
+		bool hasValue;
+		unsigned char value[sizeof(float) * 16];
+	};
+
+	// the keys are already hashes, so the table uses them as-is
+	struct IdentityHash
+	{
+		size_t operator()(uint32_t hash) const { return hash; }
+	};
+
+	mutable std::unordered_map<uint32_t, UniformSlot, IdentityHash> uniforms;
+
+	// read every active uniform once after linking. Arrays of basic types are
+	// registered per element ("weights[2]") and under their bare name as well.
+	// ------------------------------------------------------------------------
+	void reflectUniforms()
+	{
+		GLint count = 0, maxLength = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		std::string name(maxLength > 0 ? maxLength : 1, '\0');
+		for (GLint i = 0; i < count; i++)
+		{
+			GLsizei length = 0;
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, &name[0]);
+			std::string uniformName(name.c_str(), length);
+			// uniforms inside a uniform block have no location of their own
+			GLint location = glGetUniformLocation(ID, uniformName.c_str());
+			if (location < 0)
+				continue;
+			addUniform(uniformName, location, type);
+			size_t bracket = uniformName.rfind("[0]");
+			if (bracket != std::string::npos && bracket + 3 == uniformName.size())
+			{
+				std::string base = uniformName.substr(0, bracket);
+				addUniform(base, location, type);
+				for (GLint element = 1; element < size; element++)
+				{
+					std::string elementName = base + "[" + std::to_string(element) + "]";
+					addUniform(elementName, glGetUniformLocation(ID, elementName.c_str()), type);
+				}
+			}
+		}
+	}
+
+	void addUniform(const std::string &name, GLint location, GLenum type)
+	{
+		UniformSlot slot = {};
+		slot.location = location;
+		slot.type = type;
+		if (!uniforms.emplace(uniformHash(name.c_str()), slot).second)
+			std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION: " << name << std::endl;
+	}
+
+	// a missing uniform returns null, which upload() ignores the same way GL ignores location -1
+	// ------------------------------------------------------------------------
+	UniformSlot* find(uint32_t hash) const
+	{
+		renderStats().uniformLookups++;
+		auto it = uniforms.find(hash);
+		return it == uniforms.end() ? nullptr : &it->second;
+	}
+	UniformSlot* find(const std::string &name) const
+	{
+		return find(uniformHash(name.c_str()));
+	}
+
+	template <typename T>
+	void upload(UniformSlot* slot, const T &value) const
+	{
+		static_assert(sizeof(T) <= sizeof(slot->value), "uniform value too large for its shadow copy");
+		if (slot == nullptr)
+			return;
+		if (slot->hasValue && memcmp(slot->value, &value, sizeof(T)) == 0)
+		{
+			renderStats().uniformUploadsSkipped++;
+			return;
+		}
+		memcpy(slot->value, &value, sizeof(T));
+		slot->hasValue = true;
+		send(slot->location, value);
+		renderStats().uniformUploads++;
+	}
+
+	static void send(GLint location, int value) { glUniform1i(location, value); }
+	static void send(GLint location, float value) { glUniform1f(location, value); }
+	static void send(GLint location, const glm::vec2 &value) { glUniform2fv(location, 1, &value[0]); }
+	static void send(GLint location, const glm::vec3 &value) { glUniform3fv(location, 1, &value[0]); }
+	static void send(GLint location, const glm::vec4 &value) { glUniform4fv(location, 1, &value[0]); }
+	static void send(GLint location, const glm::mat2 &mat) { glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]); }
+	static void send(GLint location, const glm::mat3 &mat) { glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]); }
+	static void send(GLint location, const glm::mat4 &mat) { glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]); }
+
 	// utility function for checking shader compilation/linking errors.
 	// ------------------------------------------------------------------------
 	void checkCompileErrors(GLuint shader, std::string type)
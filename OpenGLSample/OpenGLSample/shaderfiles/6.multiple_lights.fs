@@ -7,6 +7,8 @@ struct Material {
     float shininess;
 }; 
 
+// the light structs follow the std140 layout: each vec3 is paired with a float
+// so the C++ mirrors in LightBuffer.h match byte for byte
 struct DirLight {
     vec3 direction;
 	
@@ -17,41 +19,43 @@ struct DirLight {
 
 struct PointLight {
     vec3 position;
-    
     float constant;
-    float linear;
-    float quadratic;
-	
     vec3 ambient;
+    float linear;
     vec3 diffuse;
+    float quadratic;
     vec3 specular;
 };
 
 struct SpotLight {
     vec3 position;
-    vec3 direction;
     float cutOff;
+    vec3 direction;
     float outerCutOff;
-  
-    float constant;
-    float linear;
-    float quadratic;
-  
     vec3 ambient;
+    float constant;
     vec3 diffuse;
+    float linear;
     vec3 specular;       
+    float quadratic;
 };
 
-#define NR_POINT_LIGHTS 4
+// must match LightBuffer::MAX_POINT_LIGHTS
+#define MAX_POINT_LIGHTS 128
+
+// shared by every program through uniform buffer binding point 0
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    SpotLight spotLight;
+    int numPointLights;
+    PointLight pointLights[MAX_POINT_LIGHTS];
+};
 
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 
 uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
 uniform Material material;
 
 // function prototypes
@@ -74,7 +78,7 @@ void main()
     // phase 1: directional lighting
     vec3 result = CalcDirLight(dirLight, norm, viewDir);
     // phase 2: point lights
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
+    for(int i = 0; i < numPointLights; i++)
         result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);    
     // phase 3: spot light
     result += CalcSpotLight(spotLight, norm, FragPos, viewDir);    
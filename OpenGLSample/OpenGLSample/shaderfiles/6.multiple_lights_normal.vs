@@ -0,0 +1,36 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+uniform mat4 model; // world matrix, after the shape's position box for compact vertices
+uniform mat3 normalMatrix; // inverse transpose of the world matrix, computed on the CPU
+uniform mat4 view;
+uniform mat4 projection;
+
+// with GeometryBuffer's compact layout the normal arrives as two octahedral
+// components, z reading as 0; the folded lower half is unfolded here
+uniform bool octahedralNormals;
+
+vec3 decodeNormal(vec3 n)
+{
+    if (!octahedralNormals)
+        return n;
+    vec3 v = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+    if (v.z < 0.0)
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
+
+void main()
+{
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = normalMatrix * decodeNormal(aNormal);
+    TexCoords = aTexCoords;
+    
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
\ No newline at end of file
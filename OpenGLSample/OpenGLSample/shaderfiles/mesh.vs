@@ -0,0 +1,47 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec4 aTangent;
+layout (location = 4) in vec3 aBitangent;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+out mat3 TBN; // tangent space to world space, for normal maps
+
+uniform mat4 positionTransform; // Mesh::positionTransform(), identity unless compact
+uniform mat4 model;
+uniform mat3 normalMatrix; // inverse transpose of model, computed on the CPU
+uniform mat4 view;
+uniform mat4 projection;
+
+// a compact Mesh (CompactMeshVertex) sends the normal as two octahedral
+// components, z reading as 0, and the tangent as 10-10-10-2 with the
+// bitangent's handedness in w instead of a bitangent of its own
+uniform bool octahedralNormals;
+
+vec3 decodeNormal(vec3 n)
+{
+    if (!octahedralNormals)
+        return n;
+    vec3 v = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));
+    if (v.z < 0.0)
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
+
+void main()
+{
+    FragPos = vec3(model * positionTransform * vec4(aPos, 1.0));
+    TexCoords = aTexCoords;
+
+    vec3 N = decodeNormal(aNormal);
+    vec3 T = normalize(aTangent.xyz);
+    vec3 B = octahedralNormals ? cross(N, T) * aTangent.w : aBitangent;
+    // directions are not quantized, so positionTransform does not apply to them
+    Normal = normalize(normalMatrix * N);
+    TBN = mat3(normalize(mat3(model) * T), normalize(mat3(model) * B), Normal);
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
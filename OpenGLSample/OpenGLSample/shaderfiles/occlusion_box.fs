@@ -0,0 +1,8 @@
+#version 330 core
+out vec4 FragColor;
+
+// color writes are off while the boxes are drawn; only the sample count matters
+void main()
+{
+    FragColor = vec4(1.0);
+}